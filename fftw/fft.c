@@ -3,86 +3,98 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <fftw3.h>
 
 #include "fft.h"
+#include "metrics.h"
+#include "trace.h"
 
-static fft_t fft_C[2];
+// batches the channelizer may fill ahead of the FFT
+#define FFT_PIPE_DEPTH 4
+
+static pipe_t fft_pipe; // channelizer -> FFT, one consumer
+static fftwf_plan plan;
+static float complex *fft_out;
+static int filling = 0;
+static metric_t *fft_batch_us;
 
 extern int running;
-extern unsigned channels;
 
-static void _init_fft(fft_t *f, unsigned channels, unsigned batch_size) {
+void init_fft(unsigned channels, unsigned batch_size) {
     int ch = channels;
-    f->in  = malloc(sizeof(float complex) * channels * batch_size);
-    f->out = malloc(sizeof(float complex) * channels * batch_size);
-    f->plan = fftwf_plan_many_dft(1, &ch, batch_size,
-                                  (fftwf_complex *)f->in,  NULL, 1, channels,
-                                  (fftwf_complex *)f->out, NULL, 1, channels,
-                                  FFTW_BACKWARD, FFTW_ESTIMATE);
-    f->buffer_state = BUFFER_STATE_READY;
-    pthread_cond_init(&f->buf_cond, NULL);
-    pthread_mutex_init(&f->mutex, NULL);
+    float complex *in;
+
+    if (pipe_init(&fft_pipe, FFT_PIPE_DEPTH, sizeof(float complex) * channels * batch_size, 1) != 0)
+        abort();
+    fft_out = fftwf_malloc(sizeof(float complex) * channels * batch_size);
+    memset(fft_out, 0, sizeof(float complex) * channels * batch_size);
+
+    // plan on the first slot. every slot is aligned the same, so the plan
+    // runs on any of them with fftwf_execute_dft. acquire hands back the
+    // same slot until it is published
+    in = pipe_acquire(&fft_pipe);
+    plan = fftwf_plan_many_dft(1, &ch, batch_size,
+                               (fftwf_complex *)in,      NULL, 1, channels,
+                               (fftwf_complex *)fft_out, NULL, 1, channels,
+                               FFTW_BACKWARD, FFTW_ESTIMATE);
+
+    fft_batch_us = metric_register("fft_batch_us", "FFT time per batch, microseconds",
+            METRIC_HISTOGRAM, NULL, NULL, 1);
 }
 
-void init_fft(unsigned channels, unsigned batch_size) {
-    unsigned i;
-    for (i = 0; i < 2; ++i)
-        _init_fft(&fft_C[i], channels, batch_size);
+static unsigned long now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000000lu + (unsigned long)now.tv_nsec / 1000lu;
 }
 
 void agc_submit(float complex *);
+void agc_end_of_stream(void);
 void *fft_thread_main(void *arg) {
-    unsigned i;
-
-    while (running) {
-        for (i = 0; i < 2; ++i) {
-            fft_t *f = &fft_C[i];
-            pthread_mutex_lock(&f->mutex);
-            while (running && f->buffer_state != BUFFER_STATE_EXECUTING)
-                pthread_cond_wait(&f->buf_cond, &f->mutex);
-            pthread_mutex_unlock(&f->mutex);
-            if (!running)
-                pthread_exit(NULL);
-
-            fftwf_execute(f->plan);
-            agc_submit(f->out);
-
-            pthread_mutex_lock(&f->mutex);
-            f->buffer_state = BUFFER_STATE_READY;
-            pthread_cond_signal(&f->buf_cond);
-            pthread_mutex_unlock(&f->mutex);
-        }
+    float complex *in;
+
+    while ((in = pipe_next(&fft_pipe, 0)) != NULL) {
+        unsigned long start = now_us();
+        TRACE_BEGIN(fft);
+        fftwf_execute_dft(plan, (fftwf_complex *)in, (fftwf_complex *)fft_out);
+        TRACE_END(fft, "fft");
+        metric_observe(fft_batch_us, 0, now_us() - start);
+        // the channelizer can refill it while the AGC stage takes the output
+        pipe_release(&fft_pipe, 0);
+        agc_submit(fft_out);
     }
-    return NULL;
-}
 
-static void _submit_fft(fft_t *f) {
-    pthread_mutex_lock(&f->mutex);
-    f->buffer_state = BUFFER_STATE_EXECUTING;
-    pthread_cond_signal(&f->buf_cond);
-    pthread_mutex_unlock(&f->mutex);
+    if (running)
+        agc_end_of_stream();
+    return NULL;
 }
 
 float complex *get_next_buffer(void) {
-    static unsigned cur_fft = 1;
-    fft_t *f = &fft_C[cur_fft];
-    if (f->buffer_state == BUFFER_STATE_FILLING)
-        _submit_fft(f);
-
-    cur_fft = 1 - cur_fft;
-    f = &fft_C[cur_fft];
-
-    pthread_mutex_lock(&f->mutex);
-    while (running && f->buffer_state != BUFFER_STATE_READY)
-        pthread_cond_wait(&f->buf_cond, &f->mutex);
-    if (!running) {
-        pthread_mutex_unlock(&f->mutex);
+    float complex *in;
+
+    if (filling)
+        pipe_publish(&fft_pipe);
+    filling = 1;
+
+    in = pipe_acquire(&fft_pipe);
+    if (in == NULL)
         pthread_exit(NULL);
-    }
-    f->buffer_state = BUFFER_STATE_FILLING;
-    pthread_mutex_unlock(&f->mutex);
+    return in;
+}
+
+void fft_finish(void) {
+    pipe_finish(&fft_pipe);
+}
+
+// wake anyone waiting on a buffer once running has been cleared
+void fft_shutdown(void) {
+    pipe_shutdown(&fft_pipe);
+}
 
-    return f->in;
+void fft_get_stats(pipe_stats_t *stats) {
+    pipe_get_stats(&fft_pipe, stats);
 }
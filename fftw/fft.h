@@ -5,25 +5,13 @@
 #pragma once
 
 #include <complex.h>
-#include <pthread.h>
 
-#include <fftw3.h>
-
-typedef struct _fft_t {
-    fftwf_plan plan;
-    float complex *in;
-    float complex *out;
-    enum buffer_state_t {
-        BUFFER_STATE_READY,
-        BUFFER_STATE_FILLING,
-        BUFFER_STATE_EXECUTING,
-        BUFFER_STATE_DONE,
-        BUFFER_STATE_EMPTYING,
-    } buffer_state;
-    pthread_cond_t buf_cond;
-    pthread_mutex_t mutex;
-} fft_t;
+#include "pipeline.h"
 
 void init_fft(unsigned channels, unsigned batch_size);
 float complex *get_next_buffer(void);
+// end of stream: the buffer from the last get_next_buffer() is not used
+void fft_finish(void);
+void fft_shutdown(void);
+void fft_get_stats(pipe_stats_t *stats);
 void *fft_thread_main(void *);
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "burst_archive.h"
+
+// bursts are a few KB each, so a large stdio buffer turns thousands of
+// them into a single write
+#define BURST_ARCHIVE_BUFFER_SIZE (4 << 20)
+
+struct _burst_archive_t {
+    FILE *out;
+    char *buf;
+    uint64_t offset;
+    burst_archive_entry_t *index;
+    size_t count;
+    size_t index_size;
+};
+
+struct _burst_archive_reader_t {
+    const uint8_t *map;
+    size_t size;
+    float samp_rate;
+    const burst_archive_entry_t *index;
+    burst_archive_entry_t *rebuilt; // owned, only when the index was missing
+    size_t count;
+};
+
+static size_t record_size(uint32_t len) {
+    return sizeof(burst_archive_entry_t) + (size_t)len * (sizeof(float complex) + sizeof(float));
+}
+
+burst_archive_t *burst_archive_open(const char *path, float samp_rate) {
+    burst_archive_t *a = calloc(1, sizeof(*a));
+    burst_archive_header_t h = {
+        .magic = BURST_ARCHIVE_MAGIC,
+        .version = BURST_ARCHIVE_VERSION,
+        .entry_size = sizeof(burst_archive_entry_t),
+        .samp_rate = samp_rate,
+    };
+
+    if (a == NULL)
+        return NULL;
+    a->out = fopen(path, "wb");
+    if (a->out == NULL) {
+        free(a);
+        return NULL;
+    }
+    a->buf = malloc(BURST_ARCHIVE_BUFFER_SIZE);
+    if (a->buf != NULL)
+        setvbuf(a->out, a->buf, _IOFBF, BURST_ARCHIVE_BUFFER_SIZE);
+
+    if (fwrite(&h, sizeof(h), 1, a->out) != 1 || fflush(a->out) != 0) {
+        fclose(a->out);
+        free(a->buf);
+        free(a);
+        return NULL;
+    }
+    a->offset = sizeof(h);
+    return a;
+}
+
+int burst_archive_append(burst_archive_t *a, burst_archive_entry_t *e, const float complex *iq, const float *demod) {
+    if (a->count == a->index_size) {
+        size_t new_size = a->index_size ? a->index_size * 2 : 4096;
+        burst_archive_entry_t *index = realloc(a->index, new_size * sizeof(*index));
+        if (index == NULL)
+            return -1;
+        a->index = index;
+        a->index_size = new_size;
+    }
+
+    e->offset = a->offset;
+    if (fwrite(e, sizeof(*e), 1, a->out) != 1 ||
+            fwrite(iq, sizeof(float complex), e->len, a->out) != e->len ||
+            fwrite(demod, sizeof(float), e->len, a->out) != e->len)
+        return -1;
+
+    a->index[a->count++] = *e;
+    a->offset += record_size(e->len);
+    return 0;
+}
+
+void burst_archive_close(burst_archive_t *a) {
+    burst_archive_trailer_t t = {
+        .index_offset = a->offset,
+        .count = a->count,
+        .magic = BURST_ARCHIVE_INDEX_MAGIC,
+    };
+
+    if (fwrite(a->index, sizeof(*a->index), a->count, a->out) != a->count ||
+            fwrite(&t, sizeof(t), 1, a->out) != 1)
+        fprintf(stderr, "WARNING: unable to write burst archive index\n");
+    fclose(a->out);
+    free(a->buf);
+    free(a->index);
+    free(a);
+}
+
+// no index: walk the records and keep every complete one
+static int rebuild_index(burst_archive_reader_t *r) {
+    uint64_t off = sizeof(burst_archive_header_t);
+    size_t size = 0;
+    burst_archive_entry_t e;
+
+    while (off + sizeof(e) <= r->size) {
+        memcpy(&e, r->map + off, sizeof(e));
+        if (e.offset != off || off + record_size(e.len) > r->size)
+            break;
+        if (r->count == size) {
+            burst_archive_entry_t *rebuilt;
+            size = size ? size * 2 : 4096;
+            rebuilt = realloc(r->rebuilt, size * sizeof(*rebuilt));
+            if (rebuilt == NULL)
+                return -1;
+            r->rebuilt = rebuilt;
+        }
+        r->rebuilt[r->count++] = e;
+        off += record_size(e.len);
+    }
+    r->index = r->rebuilt;
+    return 0;
+}
+
+// the trailer may be damaged or made up: only trust an index whose entries
+// lie end to end over the records, as rebuild_index() would find them
+static int index_valid(const burst_archive_reader_t *r, const burst_archive_trailer_t *t) {
+    uint64_t off = sizeof(burst_archive_header_t), end = r->size - sizeof(*t);
+    const burst_archive_entry_t *index;
+    uint64_t i;
+
+    if (t->index_offset < off || t->index_offset > end ||
+            t->count > (end - t->index_offset) / sizeof(burst_archive_entry_t) ||
+            t->index_offset + t->count * sizeof(burst_archive_entry_t) != end)
+        return 0;
+
+    index = (const burst_archive_entry_t *)(r->map + t->index_offset);
+    for (i = 0; i < t->count; ++i) {
+        if (index[i].offset != off || record_size(index[i].len) > t->index_offset - off)
+            return 0;
+        off += record_size(index[i].len);
+    }
+    return off == t->index_offset;
+}
+
+burst_archive_reader_t *burst_archive_map(const char *path) {
+    burst_archive_reader_t *r;
+    burst_archive_header_t h;
+    burst_archive_trailer_t t;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(h)) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, BURST_ARCHIVE_MAGIC, sizeof(h.magic)) != 0 ||
+            h.version != BURST_ARCHIVE_VERSION || h.entry_size != sizeof(burst_archive_entry_t)) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    r->map = map;
+    r->size = st.st_size;
+    r->samp_rate = h.samp_rate;
+
+    if (r->size >= sizeof(h) + sizeof(t)) {
+        memcpy(&t, r->map + r->size - sizeof(t), sizeof(t));
+        if (memcmp(t.magic, BURST_ARCHIVE_INDEX_MAGIC, sizeof(t.magic)) == 0 && index_valid(r, &t)) {
+            r->index = (const burst_archive_entry_t *)(r->map + t.index_offset);
+            r->count = t.count;
+            return r;
+        }
+    }
+
+    if (rebuild_index(r) != 0) {
+        burst_archive_unmap(r);
+        return NULL;
+    }
+    return r;
+}
+
+void burst_archive_unmap(burst_archive_reader_t *r) {
+    munmap((void *)r->map, r->size);
+    free(r->rebuilt);
+    free(r);
+}
+
+size_t burst_archive_count(burst_archive_reader_t *r) {
+    return r->count;
+}
+
+float burst_archive_samp_rate(burst_archive_reader_t *r) {
+    return r->samp_rate;
+}
+
+const burst_archive_entry_t *burst_archive_entry(burst_archive_reader_t *r, size_t i) {
+    return i < r->count ? &r->index[i] : NULL;
+}
+
+const float complex *burst_archive_iq(burst_archive_reader_t *r, size_t i) {
+    if (i >= r->count)
+        return NULL;
+    return (const float complex *)(r->map + r->index[i].offset + sizeof(burst_archive_entry_t));
+}
+
+const float *burst_archive_demod(burst_archive_reader_t *r, size_t i) {
+    if (i >= r->count)
+        return NULL;
+    return (const float *)(r->map + r->index[i].offset + sizeof(burst_archive_entry_t) + r->index[i].len * sizeof(float complex));
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __BURST_ARCHIVE_H__
+#define __BURST_ARCHIVE_H__
+
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// single append-only file holding every burst:
+//
+//   header | record 0 | record 1 | ... | index | trailer
+//
+// a record is an entry followed by len complex IQ samples and len demod
+// samples. the index is a copy of all entries, written on close. if the
+// writer dies before that, the reader rebuilds the index by walking the
+// records.
+
+#define BURST_ARCHIVE_MAGIC "ICE9BRST"
+#define BURST_ARCHIVE_INDEX_MAGIC "ICE9BIDX"
+#define BURST_ARCHIVE_VERSION 1
+
+typedef struct __attribute__((packed)) _burst_archive_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    float samp_rate;        // per channel, Hz
+    uint32_t reserved[3];
+} burst_archive_header_t;
+
+typedef struct __attribute__((packed)) _burst_archive_entry_t {
+    uint64_t offset;        // of this record's entry in the file
+    int64_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t freq;          // MHz
+    uint32_t num;           // per-channel burst number
+    uint32_t len;           // samples
+    float rssi_db;
+    float noise_db;
+    float cfo;              // demodulator units, fsk_hz() converts
+    float deviation;
+    uint32_t silence;
+    uint32_t lap;           // 0xffffffff if none
+    uint32_t aa;            // 0xffffffff if none
+    uint32_t reserved;
+} burst_archive_entry_t;
+
+typedef struct __attribute__((packed)) _burst_archive_trailer_t {
+    uint64_t index_offset;
+    uint64_t count;
+    char magic[8];
+} burst_archive_trailer_t;
+
+typedef struct _burst_archive_t burst_archive_t;
+typedef struct _burst_archive_reader_t burst_archive_reader_t;
+
+// writer, not thread safe
+burst_archive_t *burst_archive_open(const char *path, float samp_rate);
+int burst_archive_append(burst_archive_t *a, burst_archive_entry_t *e, const float complex *iq, const float *demod);
+void burst_archive_close(burst_archive_t *a);
+
+// random-access reader backed by mmap
+burst_archive_reader_t *burst_archive_map(const char *path);
+void burst_archive_unmap(burst_archive_reader_t *r);
+size_t burst_archive_count(burst_archive_reader_t *r);
+float burst_archive_samp_rate(burst_archive_reader_t *r);
+const burst_archive_entry_t *burst_archive_entry(burst_archive_reader_t *r, size_t i);
+const float complex *burst_archive_iq(burst_archive_reader_t *r, size_t i);
+const float *burst_archive_demod(burst_archive_reader_t *r, size_t i);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// sleep/wake on a counter, for the slow path of the lock-free rings. a
+// waiter reads the counter, rechecks its condition, then sleeps until the
+// counter moves. a futex on Linux, a condition variable elsewhere.
+typedef struct _futex_t {
+    uint32_t word;
+#ifndef __linux__
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+} futex_t;
+
+static inline void futex_init(futex_t *f) {
+    f->word = 0;
+#ifndef __linux__
+    pthread_mutex_init(&f->mutex, NULL);
+    pthread_cond_init(&f->cond, NULL);
+#endif
+}
+
+static inline void futex_destroy(futex_t *f) {
+#ifndef __linux__
+    pthread_mutex_destroy(&f->mutex);
+    pthread_cond_destroy(&f->cond);
+#else
+    (void)f;
+#endif
+}
+
+static inline uint32_t futex_value(futex_t *f) {
+    return __atomic_load_n(&f->word, __ATOMIC_ACQUIRE);
+}
+
+// sleep while the counter is still val. may return spuriously
+static inline void futex_wait(futex_t *f, uint32_t val) {
+#ifdef __linux__
+    syscall(SYS_futex, &f->word, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&f->mutex);
+    while (__atomic_load_n(&f->word, __ATOMIC_ACQUIRE) == val)
+        pthread_cond_wait(&f->cond, &f->mutex);
+    pthread_mutex_unlock(&f->mutex);
+#endif
+}
+
+// move the counter and wake every waiter
+static inline void futex_wake(futex_t *f) {
+    __atomic_add_fetch(&f->word, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+    syscall(SYS_futex, &f->word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&f->mutex);
+    pthread_cond_broadcast(&f->cond);
+    pthread_mutex_unlock(&f->mutex);
+#endif
+}
+
+#endif
@@ -5,6 +5,7 @@
 #define _GNU_SOURCE
 #include <complex.h>
 #include <err.h>
+#include <errno.h>
 #include <limits.h>
 #include <locale.h>
 #include <math.h>
@@ -15,27 +16,33 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 #include <liquid/liquid.h>
 
 #include "bluetooth.h"
 #include "btbb/btbb.h"
+#include "burst_archive.h"
 #include "burst_catcher.h"
+#include "convert.h"
 #include "fft.h"
 #include "fsk.h"
+#include "metrics.h"
+#include "mpsc_ring.h"
 #include "pcap.h"
+#include "pipeline.h"
+#include "placement.h"
+#include "realtime.h"
 #include "sdr.h"
+#include "spsc_ring.h"
+#include "synth.h"
+#include "trace.h"
 
 #include "pfbch2.h"
 
-#define C_FEK_BLOCKING_QUEUE_IMPLEMENTATION
-#define C_FEK_FAIR_LOCK_IMPLEMENTATION
-#include "blocking_queue.h"
-
-// only needed on macOS
-#include "pthread_barrier.h"
-
 #include "options.h"
 
 sniffer_config_t config;
@@ -48,10 +55,12 @@ int live_ch[40] = {
     -1, -1, -1, -1, -1, -1, -1, -1,
 };
 unsigned first_live = UINT_MAX, last_live = 0;
-char *base_name = NULL;
+burst_archive_t *burst_archive = NULL;
 
 volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t trace_requested = 0;
 pid_t self_pid;
+static pthread_t main_thread;
 
 unsigned sps(void) { return (unsigned)(config.samp_rate / config.channels / 1e6f * 2.0f); }
 
@@ -64,37 +73,83 @@ const unsigned m = 4; // magical polyphase filter bank number (filter half-lengt
 typedef struct _agc_buffer_t {
     float complex buffer[AGC_BUFFER_SIZE];
 } agc_buffer_t;
-agc_buffer_t *agc_live = NULL, *agc_dead = NULL;
-unsigned agc_live_size = 0, agc_dead_size = 0;
-agc_buffer_t *agc_buffers;
-unsigned live_buf = 0;
+
+// FFT output, transposed to one agc_buffer_t per live channel. every AGC
+// thread is a consumer and takes its own channel out of each slot
+#define AGC_PIPE_DEPTH 4
+pipe_t agc_pipe;
 
 #ifdef USE_FFTW
 pthread_t fft_thread;
 #else
+// GPU output on its way to the dispatcher, which feeds agc_pipe
+#define DISPATCH_PIPE_DEPTH 4
+pipe_t dispatch_pipe;
 pthread_t agc_dispatcher;
 #endif
-pthread_mutex_t agc_dispatch_mutex;
-pthread_cond_t fft_done_cond;
-pthread_cond_t dispatch_done_cond;
 pthread_t *agc_threads;
-pthread_mutex_t agc_buf_mutex;
-pthread_cond_t agc_buf_ready, agc_buf_done;
-pthread_barrier_local_t agc_barrier;
-unsigned long agc_start, agc_end;
+unsigned long agc_busy[40]; // per AGC thread, us spent on buffers since the last stats
+unsigned agc_remaining = 0; // AGC threads yet to reach end of stream
 
 static burst_catcher_t *catcher = NULL;
 static pfbch2_t magic;
 
 #define SAMPLES_QUEUE_SIZE 16384
-Blocking_Queue samples_queue;
+spsc_ring_t samples_queue; // one producer (SDR or spewer), one consumer
 pthread_t channelizer;
 
 #define BURST_QUEUE_SIZE 64
-Blocking_Queue bursts;
+#define BURST_BATCH_SIZE 16
+mpsc_ring_t bursts; // of burst_t *, from every AGC thread to the burst processor
 pthread_t burst_processor;
 
+static placement_t placement; // --cpus
+
+// the pipeline's side of the metrics registry, see init_metrics. series
+// per channel are indexed from first_live
+static struct {
+    metric_t *samples_in;
+    metric_t *samples_dropped;  // by drop_reason_t
+    metric_t *channelizer_us;
+    metric_t *fft_batches;
+    metric_t *agc_buffer_us;    // per channel
+    metric_t *bursts;           // per channel
+    metric_t *bursts_dropped;
+    metric_t *burst_us;
+    metric_t *ble_packets;      // per channel
+    metric_t *br_packets;       // per channel
+    // sampled by update_metrics
+    metric_t *samples_queued;
+    metric_t *sample_pool_in_use;
+    metric_t *pipe_in_flight;   // by pipe_names
+    metric_t *pipe_producer_waits;
+    metric_t *pipe_consumer_waits;
+    metric_t *bursts_queued;
+    metric_t *pcap_packets;
+    metric_t *pcap_bytes;
+    metric_t *pcap_dropped;     // newest, oldest
+    metric_t *channelizer_realtime;
+    metric_t *agc_realtime;
+} metrics;
+
+// end of stream tokens, passed down the queues after the last real entry
+static sample_buf_t samples_eos;
+static burst_t bursts_eos;
+
+#define PCAP_RING_SIZE 4096
+#define METRICS_INTERVAL_MS 1000
+
+// file input: queue depth, and how many buffers ahead of it to read
+#define SPEWER_QUEUE_SIZE 16
+#define SAMPLES_READAHEAD 16
 pthread_t spewer;
+static void *input_map = NULL;
+static size_t input_map_len = 0;
+
+// --synth: the generated input, and how much of it was found. only the
+// burst processor counts, main() reads them once it has been joined
+static synth_t synth;
+static unsigned long synth_detected[SYNTH_TYPES], synth_other = 0;
 
 // special case for all channels
 void pfbch_execute_block_96(int8_t *samples, float complex *buf, unsigned buf_pos) {
@@ -115,11 +170,22 @@ void pfbch_execute_block(int8_t *samples, float complex *buf, unsigned buf_pos)
         buf[config.channels * buf_pos + i] = out[2*i] / 32768.f + out[2*i + 1] / 32768.f * I;
 }
 
+unsigned long samples_dropped = 0, bursts_dropped = 0;
+
+void drop_samples(unsigned num, drop_reason_t why) {
+    if (config.verbose)
+        printf("WARNING: dropped samples on the floor. try fewer channels or a bigger buffer.\n");
+    __atomic_add_fetch(&samples_dropped, num, __ATOMIC_RELAXED);
+    metric_add(metrics.samples_dropped, why, num);
+}
+
 void push_samples(sample_buf_t *buf) {
-    if (blocking_queue_add(&samples_queue, buf) == BQ_FULL) {
-        if (config.verbose)
-            printf("WARNING: dropped samples on the floor. try fewer channels or a bigger buffer.\n");
-        free(buf);
+    unsigned num = buf->num;
+
+    clock_gettime(CLOCK_REALTIME, &buf->timestamp);
+    if (spsc_ring_push(&samples_queue, buf) != 0) {
+        sample_buf_free(buf);
+        drop_samples(num, DROP_QUEUE_FULL);
     }
 }
 
@@ -129,25 +195,40 @@ static inline unsigned long now_us(void) {
     return (unsigned long)now.tv_sec * 1000000lu + (unsigned long)now.tv_nsec / 1000lu;
 }
 
-unsigned long ch_sum = 0;
+static int timespec_cmp(const struct timespec *a, const struct timespec *b) {
+    if (a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static struct timespec timespec_add(struct timespec t, double sec) {
+    long long ns = (long long)t.tv_nsec + (long long)(sec * 1e9);
+    t.tv_sec += ns / 1000000000ll;
+    t.tv_nsec = ns % 1000000000ll;
+    if (t.tv_nsec < 0) {
+        t.tv_nsec += 1000000000l;
+        --t.tv_sec;
+    }
+    return t;
+}
 
-static void *fft;
-static float complex *fft_out;
+unsigned long ch_sum = 0;
 static unsigned long ch_start = 0;
 
+#ifndef USE_FFTW
+// called as each GPU batch completes: copy it out so the GPU can have the
+// buffer straight back
 void fft_done(void *f, void *out) {
-    pthread_mutex_lock(&agc_dispatch_mutex);
-    while (running && fft_out != NULL)
-        pthread_cond_wait(&dispatch_done_cond, &agc_dispatch_mutex);
-    if (!running) {
-        pthread_mutex_unlock(&agc_dispatch_mutex);
-        return;
+    float complex *slot = pipe_acquire(&dispatch_pipe);
+    if (slot != NULL) {
+        memcpy(slot, out, BATCH_SIZE * config.channels * sizeof(float complex));
+        pipe_publish(&dispatch_pipe);
     }
-    fft = f;
-    fft_out = out;
-    pthread_cond_signal(&fft_done_cond);
-    pthread_mutex_unlock(&agc_dispatch_mutex);
+    release_buffer(f);
 }
+#endif
 
 static double _convert_stats(double in, char *prefix_out) {
     if (in < 1e3) {
@@ -166,42 +247,50 @@ static double _convert_stats(double in, char *prefix_out) {
     return in / 1e9;
 }
 
+static void print_pipe_stats(const char *name, pipe_stats_t *ps) {
+    printf("%s pipe %u/%u deep at most; producer stalled %lu times, consumers idle %lu times\n",
+            name, ps->high_water, ps->depth, ps->producer_waits, ps->consumer_waits);
+}
+
+// FFT stage output: hand one batch to the AGC threads
 void agc_submit(float complex *fft_out) {
     const unsigned avg_count = 100;
-    static unsigned long sum = 0;
     static unsigned sum_count = 0;
-    unsigned i, j;
+    agc_buffer_t *agc_in;
+    unsigned active, i, j;
 
-    for (i = 0; i < config.channels; ++i)
+    metric_inc(metrics.fft_batches, 0);
+    if (first_live > last_live)
+        return;
+    active = last_live - first_live + 1;
+
+    TRACE_BEGIN(submit);
+    agc_in = pipe_acquire(&agc_pipe);
+    if (agc_in == NULL)
+        pthread_exit(NULL);
+    for (i = 0; i < active; ++i) {
+        unsigned ch = live_ch[first_live + i];
         for (j = 0; j < BATCH_SIZE; ++j)
-            agc_live[i].buffer[j] = fft_out[j * config.channels + i] / (float)config.channels;
+            agc_in[i].buffer[j] = fft_out[j * config.channels + ch] / (float)config.channels;
+    }
+    pipe_publish(&agc_pipe);
+    TRACE_END(submit, "agc_submit");
 
     if (config.stats) {
         unsigned long now = now_us();
         ch_sum += now - ch_start;
         ch_start = now;
-    }
-
-    pthread_mutex_lock(&agc_buf_mutex);
-    while (running && agc_dead != NULL)
-        pthread_cond_wait(&agc_buf_done, &agc_buf_mutex);
-    if (!running) {
-        pthread_mutex_unlock(&agc_buf_mutex);
-        pthread_exit(NULL);
-    }
 
-    agc_dead = agc_live;
-    agc_dead_size = BATCH_SIZE; //agc_live_size;
-    live_buf = 1 - live_buf;
-    agc_live = &agc_buffers[config.channels * live_buf];
-    agc_live_size = 0;
-    pthread_cond_broadcast(&agc_buf_ready);
-    pthread_mutex_unlock(&agc_buf_mutex);
-
-    if (config.stats) {
-        sum += agc_end - agc_start;
         if (++sum_count == avg_count) {
-            double eff_samp_rate = (last_live - first_live + 1) * AGC_BUFFER_SIZE * avg_count * 2e6 / sum;
+            // the AGC stage keeps up as long as its slowest thread does
+            unsigned long sum = 1;
+            pipe_stats_t pipe_ps;
+            for (i = first_live; i <= last_live; ++i) {
+                unsigned long busy = __atomic_exchange_n(&agc_busy[i], 0, __ATOMIC_RELAXED);
+                if (busy > sum)
+                    sum = busy;
+            }
+            double eff_samp_rate = active * AGC_BUFFER_SIZE * avg_count * 2e6 / sum;
             double rel_rate = eff_samp_rate / ((config.channels-2) * 2e6);
             double ch_samp_rate = AGC_BUFFER_SIZE * config.channels / 2 * avg_count * 1e6 / ch_sum;
             double ch_rel_rate = ch_samp_rate / config.samp_rate;
@@ -213,64 +302,139 @@ void agc_submit(float complex *fft_out) {
                 printf("AGC is too slow, use fewer channels\n");
             if (ch_rel_rate < 0.99)
                 printf("Channelizer too slow, use fewer channels\n");
-            sum_count = sum = ch_sum = 0;
+#ifdef USE_FFTW
+            fft_get_stats(&pipe_ps);
+            print_pipe_stats("fft", &pipe_ps);
+#else
+            pipe_get_stats(&dispatch_pipe, &pipe_ps);
+            print_pipe_stats("dispatch", &pipe_ps);
+#endif
+            pipe_get_stats(&agc_pipe, &pipe_ps);
+            print_pipe_stats("agc", &pipe_ps);
+            if (config.pcap) {
+                pcap_stats_t ps;
+                pcap_get_stats(config.pcap, &ps);
+                printf("pcap %lu packets, %lu bytes; dropped %lu newest, %lu oldest; blocked %lu times; lost %lu bytes\n",
+                        ps.packets, ps.bytes, ps.dropped_newest, ps.dropped_oldest, ps.blocked, ps.lost_bytes);
+            }
+            if (config.live) {
+                sample_pool_stats_t sp;
+                sample_pool_get_stats(&sp);
+                printf("sample pool %u/%u in use, high water %u; exhausted %lu times; oversized %lu times%s\n",
+                        sp.in_use, sp.count, sp.high_water, sp.exhausted, sp.oversized, sp.hugepages ? "; huge pages" : "");
+            }
+            sum_count = ch_sum = 0;
         }
-        agc_start = now_us();
     }
 }
 
+static void put_bursts_eos(void) {
+    burst_t *eos = &bursts_eos;
+    mpsc_ring_put(&bursts, &eos);
+}
+
+// the last batch has been handed to the AGC threads, they pass the token
+// on once they have finished with it
+void agc_end_of_stream(void) {
+    pipe_finish(&agc_pipe);
+
+    // nobody downstream to pass it on
+    if (agc_remaining == 0)
+        put_bursts_eos();
+}
+
 #ifndef USE_FFTW
 void *agc_dispatcher_thread(void *arg) {
-    static float complex my_fft[96 * BATCH_SIZE];
+    float complex *fft_out;
 
-    while (running) {
-        pthread_mutex_lock(&agc_dispatch_mutex);
-        while (running && fft_out == NULL)
-            pthread_cond_wait(&fft_done_cond, &agc_dispatch_mutex);
-        if (!running) {
-            pthread_mutex_unlock(&agc_dispatch_mutex);
-            pthread_exit(NULL);
-        }
-        memcpy(my_fft, fft_out, BATCH_SIZE * config.channels * sizeof(float complex));
-        release_buffer(fft);
-        fft_out = NULL;
-        pthread_cond_signal(&dispatch_done_cond);
-        pthread_mutex_unlock(&agc_dispatch_mutex);
-
-        agc_submit(my_fft);
+    while ((fft_out = pipe_next(&dispatch_pipe, 0)) != NULL) {
+        agc_submit(fft_out);
+        pipe_release(&dispatch_pipe, 0);
     }
+
+    if (running)
+        agc_end_of_stream();
     return NULL;
 }
 #endif
 
+// write to the SigMF dump, noting any samples lost since the last buffer
+static void dump_samples(sample_buf_t *samples) {
+    static unsigned long dumped_drops = 0;
+    unsigned long dropped = __atomic_load_n(&samples_dropped, __ATOMIC_RELAXED);
+
+    if (dropped != dumped_drops) {
+        sigmf_dropped(config.dump, dropped - dumped_drops);
+        dumped_drops = dropped;
+    }
+    (void)!sigmf_write(config.dump, samples->samples, samples->num, samples->sample_size, &samples->timestamp);
+}
+
+// everything read has made it through the pipeline, wake main() to shut
+// it down
+static void end_of_stream(void) {
+    running = 0;
+    pthread_kill(main_thread, SIGUSR1);
+}
+
 void *dump_thread(void *arg) {
     sample_buf_t *samples = NULL;
     while (running) {
-        if (blocking_queue_take(&samples_queue, &samples) != 0)
+        if (spsc_ring_take(&samples_queue, (void **)&samples) != 0)
+            return NULL;
+        if (samples == &samples_eos) {
+            end_of_stream();
             return NULL;
-        if (config.dump_file) {
-            (void)!fwrite(samples->samples, 1, samples->num * samples->sample_size, config.dump_file);
         }
-        free(samples);
+        metric_add(metrics.samples_in, 0, samples->num);
+        if (config.dump) {
+            dump_samples(samples);
+        }
+        sample_buf_free(samples);
     }
     return NULL;
 }
 
+// end of input: pad out and submit the partial batch, then tell the next
+// stage there are no more. the token follows the last batch down the pipe
+static void channelizer_end_of_stream(float complex *fft_in, unsigned fft_in_pos) {
+    if (fft_in_pos > 0) {
+        memset(&fft_in[config.channels * fft_in_pos], 0, sizeof(float complex) * config.channels * (BATCH_SIZE - fft_in_pos));
+        get_next_buffer();
+    }
+#ifdef USE_FFTW
+    fft_finish();
+#else
+    // the GPU hands batches on as they complete, wait for the last one
+    fft_drain();
+    pipe_finish(&dispatch_pipe);
+#endif
+}
+
 void *channelizer_thread(void *arg) {
     unsigned i;
     sample_buf_t *samples = NULL;
     float complex *fft_in = get_next_buffer();
     unsigned fft_in_pos = 0;
+    unsigned long start;
 
     while (running) {
         // get next samples
-        if (blocking_queue_take(&samples_queue, &samples) != 0)
+        if (spsc_ring_take(&samples_queue, (void **)&samples) != 0)
             return NULL;
 
-        if (config.dump_file) {
-            (void)!fwrite(samples->samples, 1, samples->num * samples->sample_size, config.dump_file);
+        if (samples == &samples_eos) {
+            channelizer_end_of_stream(fft_in, fft_in_pos);
+            return NULL;
+        }
+        metric_add(metrics.samples_in, 0, samples->num);
+        start = now_us();
+
+        if (config.dump) {
+            dump_samples(samples);
         }
 
+        TRACE_BEGIN(channelize);
         if (config.channels == 96) {
             for (i = 0; running && i + config.channels / 2 <= samples->num; i += config.channels / 2) {
                 pfbch_execute_block_96(&samples->samples[2*i], fft_in, fft_in_pos);
@@ -290,186 +454,450 @@ void *channelizer_thread(void *arg) {
             }
         }
 
-        free(samples);
+        TRACE_END(channelize, "pfbch2_execute");
+        metric_observe(metrics.channelizer_us, 0, now_us() - start);
+        sample_buf_free(samples);
     }
     return NULL;
 }
 
+// queue a caught burst for the burst processor, returns the burst_t to
+// use for the next one. live input can't wait, so bursts are dropped if
+// the processor falls behind. a recording has all the time in the world.
+static burst_t *agc_queue_burst(burst_t *burst) {
+    unsigned ch = (burst->freq - 2402) / 2 - first_live;
+    int r, full = 0;
+
+    if (burst->len < 132) { // FIXME
+        burst_destroy(burst);
+        memset(burst, 0, sizeof(*burst));
+        return burst;
+    }
+
+    if (config.live || config.replay > 0.0f) {
+        full = mpsc_ring_push(&bursts, &burst) != 0;
+        r = full ? -1 : 0;
+    } else {
+        r = mpsc_ring_put(&bursts, &burst);
+    }
+    if (r != 0) {
+        if (full) {
+            __atomic_add_fetch(&bursts_dropped, 1, __ATOMIC_RELAXED);
+            metric_inc(metrics.bursts_dropped, 0);
+            if (config.verbose)
+                printf("WARNING: dropped burst on the floor. try fewer channels.\n");
+        }
+        burst_destroy(burst);
+        memset(burst, 0, sizeof(*burst));
+        return burst;
+    }
+    metric_inc(metrics.bursts, ch);
+    return calloc(1, sizeof(*burst));
+}
+
 void *agc_thread(void *id_ptr) {
     unsigned id = (uintptr_t)id_ptr;
+    unsigned me = id - first_live; // consumer, and our buffer in each slot
     unsigned i;
+    agc_buffer_t *agc_in;
     burst_t *burst = calloc(1, sizeof(*burst));
 
-    while (running) {
-        pthread_mutex_lock(&agc_buf_mutex);
-        while (running && agc_dead == NULL)
-            pthread_cond_wait(&agc_buf_ready, &agc_buf_mutex);
-        pthread_mutex_unlock(&agc_buf_mutex);
-        if (!running)
-            goto out;
-
-        for (i = 0; i < agc_dead_size; ++i) {
-            if (burst_catcher_execute(&catcher[id], &agc_dead[live_ch[id]].buffer[i], burst)) {
-                if (burst->len < 132) { // FIXME
-                    burst_destroy(burst);
-                    memset(burst, 0, sizeof(*burst));
-                } else {
-                    if (blocking_queue_add(&bursts, burst) == BQ_FULL) {
-                        if (config.verbose)
-                            printf("WARNING: dropped burst on the floor. try fewer channels.\n");
-                        burst_destroy(burst);
-                        memset(burst, 0, sizeof(*burst));
-                    } else {
-                        burst = calloc(1, sizeof(*burst));
-                    }
-                }
-            }
-        }
+    while ((agc_in = pipe_next(&agc_pipe, me)) != NULL) {
+        unsigned long start = now_us(), busy;
 
-        if (!running)
-            goto out;
-
-        if (pthread_barrier_local_wait(&agc_barrier) == 1) {
-            // we're the lucky thread!
-            if (config.stats)
-                agc_end = now_us();
-            pthread_mutex_lock(&agc_buf_mutex);
-            agc_dead = NULL;
-            agc_dead_size = 0;
-            pthread_cond_signal(&agc_buf_done);
-            pthread_mutex_unlock(&agc_buf_mutex);
+        TRACE_BEGIN(agc);
+        for (i = 0; i < BATCH_SIZE; ++i) {
+            if (burst_catcher_execute(&catcher[id], &agc_in[me].buffer[i], burst))
+                burst = agc_queue_burst(burst);
         }
-        if (!running)
-            goto out;
-        pthread_barrier_local_wait(&agc_barrier);
+        pipe_release(&agc_pipe, me);
+        TRACE_END(agc, "agc");
+
+        busy = now_us() - start;
+        metric_observe(metrics.agc_buffer_us, me, busy);
+        if (config.stats)
+            __atomic_add_fetch(&agc_busy[id], busy, __ATOMIC_RELAXED);
+    }
+
+    if (running) {
+        if (burst_catcher_flush(&catcher[id], burst))
+            burst = agc_queue_burst(burst);
+        // last one out passes the token on
+        if (__atomic_sub_fetch(&agc_remaining, 1, __ATOMIC_ACQ_REL) == 0)
+            put_bursts_eos();
     }
-out:
     free(burst);
     return NULL;
 }
 
-int queue_empty(volatile Blocking_Queue *q) {
-    return q->queue_size == 0;
+static void sleep_until(const struct timespec *deadline) {
+#ifdef __APPLE__
+    // no clock_nanosleep
+    struct timespec now, left;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left.tv_sec = deadline->tv_sec - now.tv_sec;
+    left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (left.tv_nsec < 0) {
+        left.tv_nsec += 1000000000l;
+        --left.tv_sec;
+    }
+    if (left.tv_sec >= 0)
+        nanosleep(&left, NULL);
+#else
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR)
+        ;
+#endif
+}
+
+// --replay: hold each buffer back until its last sample would have come
+// off the SDR. deadlines are absolute so oversleeping doesn't accumulate.
+static void replay_wait(unsigned num) {
+    static struct timespec start;
+    static double elapsed = 0.0; // seconds of input so far
+    struct timespec deadline;
+
+    if (elapsed == 0.0)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    elapsed += num / (config.samp_rate * config.replay);
+    deadline = timespec_add(start, elapsed);
+    sleep_until(&deadline);
+}
+
+// queue one spewer buffer of input. ci8 goes to the channelizer as it is,
+// other formats are converted into a buffer of their own. view says the
+// ci8 input may be referenced in place rather than copied.
+static int spew_samples(int8_t *in, int view) {
+    unsigned num = config.channels * AGC_BUFFER_SIZE;
+    sample_buf_t *samples;
+
+    if (config.in_format == SAMPLE_FORMAT_CI8 && view) {
+        samples = sample_buf_view(in);
+    } else {
+        samples = sample_buf_alloc(sizeof(int8_t) * 2 * num);
+        convert_to_ci8(config.in_format, in, samples->samples, num);
+    }
+    samples->num = num;
+    samples->sample_size = 2;
+    samples->timestamp = (struct timespec){ 0, 0 };
+    if (config.replay > 0.0f) {
+        // from here on it's treated just like SDR input
+        replay_wait(num);
+        push_samples(samples);
+        return 0;
+    }
+    if (spsc_ring_put(&samples_queue, samples) != 0) {
+        sample_buf_free(samples);
+        return -1;
+    }
+    return 0;
+}
+
+// regular files are mapped and handed to the channelizer as zero-copy
+// views. returns 0 at end of file, -1 if the file can't be mapped.
+static int spew_mapped(FILE *in_file) {
+    size_t chunk = sample_format_size(config.in_format) * config.channels * AGC_BUFFER_SIZE;
+    size_t off, end, ahead = chunk * (SPEWER_QUEUE_SIZE + SAMPLES_READAHEAD);
+    struct stat st;
+    int fd = fileno(in_file);
+    off_t start = config.in_offset;
+    void *map;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= start)
+        return -1;
+    end = st.st_size;
+    if (config.in_length > 0 && start + config.in_length < st.st_size)
+        end = start + config.in_length;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    // unmapped in deinit_threads, once nothing can hold a view any more
+    input_map = map;
+    input_map_len = st.st_size;
+
+    for (off = start; running && off + chunk <= end; off += chunk) {
+        size_t next = (off + ahead) & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+
+        // keep the kernel reading a few chunks ahead of the channelizer
+        if (next < end)
+            madvise((uint8_t *)map + next, next + chunk <= end ? chunk : end - next, MADV_WILLNEED);
+
+        if (spew_samples((int8_t *)map + off, 1) != 0)
+            break;
+    }
+    return 0;
+}
+
+// --synth: the stream is already in memory, and goes out as views the same
+// way a mapped file does
+static void spew_synth(void) {
+    size_t chunk = 2 * config.channels * AGC_BUFFER_SIZE, off;
+
+    for (off = 0; running && off + chunk <= 2 * synth.num; off += chunk)
+        if (spew_samples(synth.samples + off, 1) != 0)
+            break;
 }
 
 void *spewer_thread(void *in_ptr) {
-    size_t r;
     FILE *in_file = (FILE *)in_ptr;
 
-    sample_buf_t *samples = malloc(sizeof(*samples) + sizeof(int8_t) * 2 * config.channels * AGC_BUFFER_SIZE);
-    while (running && (r = fread(&samples->samples, sizeof(int8_t) * 2 * config.channels * AGC_BUFFER_SIZE, 1, in_file)) > 0) {
-        samples->num = config.channels * AGC_BUFFER_SIZE;
-        if (blocking_queue_put(&samples_queue, samples) != 0) {
-            free(samples);
-            return NULL;
+    if (config.synth) {
+        spew_synth();
+    } else if (spew_mapped(in_file) != 0) {
+        // pipes and the like: copy through a buffer
+        size_t chunk = sample_format_size(config.in_format) * config.channels * AGC_BUFFER_SIZE;
+        off_t left = config.in_length > 0 ? config.in_length : -1;
+        int8_t *buf = malloc(chunk);
+        if (config.in_offset > 0)
+            fseeko(in_file, config.in_offset, SEEK_SET);
+        while (running && (left < 0 || left >= (off_t)chunk) && fread(buf, chunk, 1, in_file) > 0) {
+            if (left > 0)
+                left -= chunk;
+            if (spew_samples(buf, 0) != 0)
+                break;
         }
-        samples = malloc(sizeof(*samples) + sizeof(int8_t) * 2 * config.channels * AGC_BUFFER_SIZE);
+        free(buf);
     }
-    free(samples);
 
-    while (running && !queue_empty(&samples_queue))
-        ;
-    running = 0;
-    kill(self_pid, SIGINT);
+    // everything queued before it gets processed, then the pipeline winds
+    // itself down
+    if (running)
+        spsc_ring_put(&samples_queue, &samples_eos);
 
     return NULL;
 }
 
+static void process_burst(fsk_demod_t *fsk, burst_t *burst) {
+    unsigned ch = (burst->freq - 2402) / 2 - first_live;
+
+    // another shard owns this one
+    if (config.sharded && (timespec_cmp(&burst->timestamp, &config.shard_start) < 0 ||
+                           timespec_cmp(&burst->timestamp, &config.shard_end) >= 0)) {
+        burst_destroy(burst);
+        free(burst);
+        return;
+    }
+
+    TRACE_BEGIN(demod);
+    fsk_demod(fsk, burst->burst, burst->len, burst->freq, &burst->packet);
+    TRACE_END(demod, "fsk_demod");
+
+    if (burst->packet.demod != NULL && burst->packet.bits != NULL) {
+        uint32_t lap = 0xffffffff, aa = 0xffffffff;
+        bluetooth_detect(burst->packet.bits, burst->packet.bits_len, burst->freq, burst->rssi_db, burst->noise_db, fsk_hz(burst->packet.cfo), fsk_hz(burst->packet.deviation), burst->timestamp, &lap, &aa);
+        if (aa != 0xffffffff)
+            metric_inc(metrics.ble_packets, ch);
+        if (lap != 0xffffffff)
+            metric_inc(metrics.br_packets, ch);
+        if (config.synth) {
+            if (aa == SYNTH_BLE_AA)
+                ++synth_detected[SYNTH_BLE];
+            else if (lap == SYNTH_BR_LAP)
+                ++synth_detected[SYNTH_BR];
+            else if (aa != 0xffffffff || lap != 0xffffffff)
+                ++synth_other;
+        }
+
+        if (config.verbose) {
+            printf("burst %4u-%04u, %d samps, rssi %f dB, noise %f dB ", burst->freq, burst->num, burst->len, burst->rssi_db, burst->noise_db);
+            printf("cfo %f deviation %f ", burst->packet.cfo, burst->packet.deviation);
+            if (lap != 0xffffffff)
+                printf("lap %06x", lap);
+            if (aa != 0xffffffff)
+                printf("aa %08x", aa);
+            printf("\n");
+        }
+
+        if (burst_archive != NULL) {
+            burst_archive_entry_t e = {
+                .ts_sec = burst->timestamp.tv_sec,
+                .ts_nsec = burst->timestamp.tv_nsec,
+                .freq = burst->freq,
+                .num = burst->num,
+                .len = burst->len,
+                .rssi_db = burst->rssi_db,
+                .noise_db = burst->noise_db,
+                .cfo = burst->packet.cfo,
+                .deviation = burst->packet.deviation,
+                .silence = burst->packet.silence,
+                .lap = lap,
+                .aa = aa,
+            };
+            if (burst_archive_append(burst_archive, &e, burst->burst, burst->packet.demod) != 0)
+                err(1, "Unable to write burst archive %s", config.burst_path);
+        }
+    }
+    burst_destroy(burst);
+    free(burst);
+}
+
+// takes whatever the AGC threads have queued in one go
 void *burst_processor_thread(void *arg) {
     fsk_demod_t fsk;
-    burst_t *burst;
+    burst_t *batch[BURST_BATCH_SIZE];
+    int i, n;
 
     fsk_demod_init(&fsk);
 
     while (running) {
-        if (blocking_queue_take(&bursts, &burst) != 0)
-            goto out;
-
-        fsk_demod(&fsk, burst->burst, burst->len, burst->freq, &burst->packet);
-
-        if (burst->packet.demod != NULL && burst->packet.bits != NULL) {
-            uint32_t lap = 0xffffffff, aa = 0xffffffff;
-            bluetooth_detect(burst->packet.bits, burst->packet.bits_len, burst->freq, burst->rssi_db, burst->noise_db, burst->timestamp, &lap, &aa);
-
-            if (config.verbose) {
-                printf("burst %4u-%04u, %d samps, rssi %f dB, noise %f dB ", burst->freq, burst->num, burst->len, burst->rssi_db, burst->noise_db);
-                printf("cfo %f deviation %f ", burst->packet.cfo, burst->packet.deviation);
-                if (lap != 0xffffffff)
-                    printf("lap %06x", lap);
-                if (aa != 0xffffffff)
-                    printf("aa %08x", aa);
-                printf("\n");
-            }
+        if ((n = mpsc_ring_take(&bursts, batch, BURST_BATCH_SIZE)) < 0)
+            break;
 
-            if (base_name != NULL) {
-                char *filename;
-                FILE *out;
-
-                /* burst */
-                (void)!asprintf(&filename, "%s-%04u-%04u.fc32", base_name, burst->freq, burst->num);
-                out = fopen(filename, "w");
-                if (out == NULL)
-                    err(1, "Unable to create file %s", filename);
-                free(filename);
-                fwrite(burst->burst, sizeof(float complex), burst->len, out);
-                fclose(out);
-
-                /* demoded samples */
-                (void)!asprintf(&filename, "%s-%04u-%04u.f32", base_name, burst->freq, burst->num);
-                out = fopen(filename, "w");
-                if (out == NULL)
-                    err(1, "Unable to create file %s", filename);
-                free(filename);
-                fwrite(burst->packet.demod, sizeof(float), burst->len, out);
-                fclose(out);
-
-                /* cfo / maybe other metadata? */
-                (void)!asprintf(&filename, "%s-%04u-%04u.txt", base_name, burst->freq, burst->num);
-                out = fopen(filename, "w");
-                if (out == NULL)
-                    err(1, "Unable to create file %s", filename);
-                free(filename);
-                fprintf(out, "cfo=%f\n", burst->packet.cfo);
-                fprintf(out, "silence=%u\n", burst->packet.silence);
-                if (lap != 0xffffffff)
-                    fprintf(out, "lap=%06x\n", lap);
-                if (aa != 0xffffffff)
-                    fprintf(out, "aa=%08x\n", aa);
-                fclose(out);
+        for (i = 0; running && i < n; ++i) {
+            if (batch[i] == &bursts_eos) {
+                end_of_stream();
+                goto out;
             }
+            unsigned long start = now_us();
+            process_burst(&fsk, batch[i]);
+            metric_observe(metrics.burst_us, 0, now_us() - start);
         }
-        burst_destroy(burst);
-        free(burst);
     }
 out:
     fsk_demod_destroy(&fsk);
     return NULL;
 }
 
+static void init_metrics(void) {
+    static const char *const drop_reasons[DROP_REASONS] = { "pool_exhausted", "queue_full" };
+#ifdef USE_FFTW
+    static const char *const pipe_names[] = { "fft", "agc" };
+#else
+    static const char *const pipe_names[] = { "dispatch", "agc" };
+#endif
+    static const char *const pcap_policies[] = { "newest", "oldest" };
+    unsigned num_pipes = first_live <= last_live ? 2 : 1;
+
+    metrics.samples_in = metric_register("samples_in", "samples taken in by the channelizer", METRIC_COUNTER, NULL, NULL, 1);
+    metrics.samples_dropped = metric_register("samples_dropped", "samples lost before the channelizer", METRIC_COUNTER, "reason", drop_reasons, DROP_REASONS);
+    metrics.samples_queued = metric_register("samples_queued", "sample buffers waiting for the channelizer", METRIC_GAUGE, NULL, NULL, 1);
+    if (config.live)
+        metrics.sample_pool_in_use = metric_register("sample_pool_in_use", "SDR sample buffers in use", METRIC_GAUGE, NULL, NULL, 1);
+    if (config.pcap) {
+        metrics.pcap_packets = metric_register("pcap_packets", "packets written", METRIC_COUNTER, NULL, NULL, 1);
+        metrics.pcap_bytes = metric_register("pcap_bytes", "bytes written", METRIC_COUNTER, NULL, NULL, 1);
+        metrics.pcap_dropped = metric_register("pcap_dropped", "packets dropped by --pcap-policy", METRIC_COUNTER, "policy", pcap_policies, 2);
+    }
+    if (config.dump_only)
+        return;
+
+    metrics.channelizer_us = metric_register("channelizer_us", "channelizer time per sample buffer, microseconds", METRIC_HISTOGRAM, NULL, NULL, 1);
+    metrics.fft_batches = metric_register("fft_batches", "FFT batches handed to the AGC", METRIC_COUNTER, NULL, NULL, 1);
+    metrics.pipe_in_flight = metric_register("pipe_in_flight", "buffers between stages", METRIC_GAUGE, "pipe", pipe_names, num_pipes);
+    metrics.pipe_producer_waits = metric_register("pipe_producer_waits", "times a stage waited on the one after it", METRIC_COUNTER, "pipe", pipe_names, num_pipes);
+    metrics.pipe_consumer_waits = metric_register("pipe_consumer_waits", "times a stage waited on the one before it", METRIC_COUNTER, "pipe", pipe_names, num_pipes);
+    metrics.bursts_queued = metric_register("bursts_queued", "bursts waiting for the burst processor", METRIC_GAUGE, NULL, NULL, 1);
+    metrics.bursts_dropped = metric_register("bursts_dropped", "bursts lost because the burst processor fell behind", METRIC_COUNTER, NULL, NULL, 1);
+    metrics.burst_us = metric_register("burst_us", "demodulation and decoding time per burst, microseconds", METRIC_HISTOGRAM, NULL, NULL, 1);
+    metrics.channelizer_realtime = metric_register("channelizer_realtime", "channelizer speed over real time since the last snapshot, below 1 is falling behind", METRIC_GAUGE, NULL, NULL, 1);
+    if (first_live > last_live)
+        return;
+
+    metrics.agc_realtime = metric_register("agc_realtime", "slowest AGC thread's speed over real time since the last snapshot, below 1 is falling behind", METRIC_GAUGE, NULL, NULL, 1);
+
+    metrics.agc_buffer_us = metric_register_channels("agc_buffer_us", "AGC time per buffer, microseconds", METRIC_HISTOGRAM, 2402 + first_live * 2, last_live - first_live + 1);
+    metrics.bursts = metric_register_channels("bursts", "bursts caught", METRIC_COUNTER, 2402 + first_live * 2, last_live - first_live + 1);
+    metrics.ble_packets = metric_register_channels("ble_packets", "BLE packets decoded", METRIC_COUNTER, 2402 + first_live * 2, last_live - first_live + 1);
+    metrics.br_packets = metric_register_channels("br_packets", "BR packets decoded", METRIC_COUNTER, 2402 + first_live * 2, last_live - first_live + 1);
+}
+
+// --stats' realtime percentages, over the time since the last call
+static void update_realtime_metrics(void) {
+    static uint64_t last_in = 0, last_ch_us = 0;
+    static uint64_t last_agc_count[40], last_agc_us[40];
+    uint64_t in, count, sum, buckets[METRIC_HIST_BUCKETS];
+    double slowest = -1.0;
+    unsigned i;
+
+    in = metric_count(metrics.samples_in, 0);
+    metric_histogram(metrics.channelizer_us, 0, &count, &sum, buckets);
+    if (sum > last_ch_us)
+        metric_set(metrics.channelizer_realtime, 0, (in - last_in) / config.samp_rate / ((sum - last_ch_us) / 1e6));
+    last_in = in;
+    last_ch_us = sum;
+
+    if (metrics.agc_realtime == NULL)
+        return;
+    // every channel runs at 2 Msps
+    for (i = 0; i < metrics.agc_buffer_us->num_series; ++i) {
+        metric_histogram(metrics.agc_buffer_us, i, &count, &sum, buckets);
+        if (sum > last_agc_us[i]) {
+            double rate = (count - last_agc_count[i]) * AGC_BUFFER_SIZE / 2e6 / ((sum - last_agc_us[i]) / 1e6);
+            if (slowest < 0.0 || rate < slowest)
+                slowest = rate;
+        }
+        last_agc_count[i] = count;
+        last_agc_us[i] = sum;
+    }
+    if (slowest >= 0.0)
+        metric_set(metrics.agc_realtime, 0, slowest);
+}
+
+// from the exporter thread, before each snapshot
+static void update_metrics(void) {
+    pipe_stats_t ps[2];
+    unsigned i;
+
+    metric_set(metrics.samples_queued, 0, spsc_ring_size(&samples_queue));
+    if (metrics.sample_pool_in_use != NULL) {
+        sample_pool_stats_t sp;
+        sample_pool_get_stats(&sp);
+        metric_set(metrics.sample_pool_in_use, 0, sp.in_use);
+    }
+    if (metrics.pcap_packets != NULL) {
+        pcap_stats_t pc;
+        pcap_get_stats(config.pcap, &pc);
+        metric_set_count(metrics.pcap_packets, 0, pc.packets);
+        metric_set_count(metrics.pcap_bytes, 0, pc.bytes);
+        metric_set_count(metrics.pcap_dropped, 0, pc.dropped_newest);
+        metric_set_count(metrics.pcap_dropped, 1, pc.dropped_oldest);
+    }
+    if (config.dump_only)
+        return;
+
+#ifdef USE_FFTW
+    fft_get_stats(&ps[0]);
+#else
+    pipe_get_stats(&dispatch_pipe, &ps[0]);
+#endif
+    if (metrics.pipe_in_flight->num_series > 1)
+        pipe_get_stats(&agc_pipe, &ps[1]);
+    for (i = 0; i < metrics.pipe_in_flight->num_series; ++i) {
+        metric_set(metrics.pipe_in_flight, i, ps[i].in_flight);
+        metric_set_count(metrics.pipe_producer_waits, i, ps[i].producer_waits);
+        metric_set_count(metrics.pipe_consumer_waits, i, ps[i].consumer_waits);
+    }
+    metric_set(metrics.bursts_queued, 0, mpsc_ring_size(&bursts));
+    update_realtime_metrics();
+}
+
 void init_threads(int launch_spewer) {
     uintptr_t i;
     unsigned active_channels = 0;
 
-    blocking_queue_init(&samples_queue, launch_spewer ? 16 : SAMPLES_QUEUE_SIZE);
+    spsc_ring_init(&samples_queue, launch_spewer && config.replay == 0.0f ? SPEWER_QUEUE_SIZE : SAMPLES_QUEUE_SIZE);
 
     if (config.dump_only) {
         pthread_create(&channelizer, NULL, dump_thread, NULL);
 #ifdef __linux__
         pthread_setname_np(channelizer, "dumper");
 #endif
+        placement_pin(&placement, channelizer, "dumper");
+        if (config.rt_priority)
+            rt_set_thread(channelizer, config.rt_priority - 1, "dumper");
     } else {
-        pthread_mutex_init(&agc_dispatch_mutex, NULL);
-        pthread_mutex_init(&agc_buf_mutex, NULL);
-        pthread_cond_init(&fft_done_cond, NULL);
-        pthread_cond_init(&dispatch_done_cond, NULL);
-        pthread_cond_init(&agc_buf_ready, NULL);
-        pthread_cond_init(&agc_buf_done, NULL);
         for (i = 0; i < 40; ++i)
             if (live_ch[i] >= 0)
                 ++active_channels;
-        pthread_barrier_local_init(&agc_barrier, NULL, active_channels);
+        if (active_channels > 0)
+            pipe_init(&agc_pipe, AGC_PIPE_DEPTH, active_channels * sizeof(agc_buffer_t), active_channels);
+        agc_remaining = active_channels;
+#ifndef USE_FFTW
+        pipe_init(&dispatch_pipe, DISPATCH_PIPE_DEPTH, BATCH_SIZE * config.channels * sizeof(float complex), 1);
+#endif
 
-        blocking_queue_init(&bursts, BURST_QUEUE_SIZE);
+        mpsc_ring_init(&bursts, BURST_QUEUE_SIZE, sizeof(burst_t *));
         agc_threads = calloc(40, sizeof(*agc_threads));
         pthread_create(&channelizer, NULL, channelizer_thread, NULL);
 #ifdef USE_FFTW
@@ -484,21 +912,31 @@ void init_threads(int launch_spewer) {
 #else
         pthread_setname_np(agc_dispatcher, "agc-dispatcher");
 #endif
+#endif
+        placement_pin(&placement, channelizer, "channelizer");
+        if (config.rt_priority)
+            rt_set_thread(channelizer, config.rt_priority - 1, "channelizer");
+#ifdef USE_FFTW
+        placement_pin(&placement, fft_thread, "fft");
+#else
+        placement_pin(&placement, agc_dispatcher, "agc-dispatcher");
 #endif
         if (first_live <= last_live) {
             for (i = first_live; i <= last_live; ++i) {
-                pthread_create(&agc_threads[i], NULL, agc_thread, (void *)i);
-#ifdef __linux__
                 char name[32];
+                pthread_create(&agc_threads[i], NULL, agc_thread, (void *)i);
                 snprintf(name, sizeof(name), "agc-%04lu", 2402+i*2);
+#ifdef __linux__
                 pthread_setname_np(agc_threads[i], name);
 #endif
+                placement_pin(&placement, agc_threads[i], name);
             }
         }
         pthread_create(&burst_processor, NULL, burst_processor_thread, NULL);
 #ifdef __linux__
         pthread_setname_np(burst_processor, "burst_processor");
 #endif
+        placement_pin(&placement, burst_processor, "burst_processor");
     }
 
     if (launch_spewer) {
@@ -506,32 +944,53 @@ void init_threads(int launch_spewer) {
 #ifdef __linux__
         pthread_setname_np(spewer, "spewer");
 #endif
+        placement_pin(&placement, spewer, "spewer");
+        if (config.rt_priority)
+            rt_set_thread(spewer, config.rt_priority, "spewer");
     }
+
+    placement_print(&placement, stderr);
+
+    // the rings, pipes and thread stacks all exist now, and the SDR has
+    // set up its sample pool. with a finite RLIMIT_MEMLOCK nothing mapped
+    // after this is locked, so it has to come last, before sdr_start()
+    if (config.rt_priority)
+        rt_lock_memory();
 }
 
 void deinit_threads(int join_spewer) {
     uintptr_t i;
     running = 0;
 
-    blocking_queue_close(&samples_queue);
+    spsc_ring_close(&samples_queue);
 
     if (join_spewer)
         pthread_join(spewer, NULL);
 
+    // the channelizer may be waiting on any stage downstream of it
+    if (!config.dump_only) {
+        fft_shutdown();
+#ifndef USE_FFTW
+        pipe_shutdown(&dispatch_pipe);
+#endif
+        pipe_shutdown(&agc_pipe);
+    }
+
     pthread_join(channelizer, NULL);
 
+    if (input_map != NULL) {
+        munmap(input_map, input_map_len);
+        input_map = NULL;
+    }
+
     if (!config.dump_only) {
-        pthread_mutex_lock(&agc_buf_mutex);
-        pthread_cond_broadcast(&agc_buf_ready);
-        pthread_cond_signal(&agc_buf_done);
-        pthread_mutex_unlock(&agc_buf_mutex);
-        pthread_barrier_local_shutdown(&agc_barrier);
+        // AGC threads may be blocked handing a burst over
+        mpsc_ring_close(&bursts);
         if (first_live <= last_live) {
             for (i = first_live; i <= last_live; ++i)
                 pthread_join(agc_threads[i], NULL);
         }
 
-        blocking_queue_close(&bursts);
         pthread_join(burst_processor, NULL);
     }
 }
@@ -540,14 +999,149 @@ void sig(int signo) {
     running = 0;
 }
 
+// only here to interrupt sigsuspend in main()
+static void wake(int signo) {
+}
+
+// SIGUSR2: main() writes out the trace
+static void request_trace(int signo) {
+    trace_requested = 1;
+}
+
+static void synth_report(double elapsed) {
+    double seconds = synth.num / config.samp_rate;
+
+    printf("synth: %.2f s of input in %.2f s, %.1f Msamples/s, %.2fx real time\n",
+            seconds, elapsed, synth.num / elapsed / 1e6, seconds / elapsed);
+    if (!config.dump_only)
+        printf("synth: found %lu of %u BLE and %lu of %u BR/EDR packets, %lu others\n",
+                synth_detected[SYNTH_BLE], synth.injected[SYNTH_BLE],
+                synth_detected[SYNTH_BR], synth.injected[SYNTH_BR], synth_other);
+    printf("synth: dropped %lu samples, %lu bursts\n", samples_dropped, bursts_dropped);
+}
+
+static void write_trace(void) {
+    if (trace_dump(config.trace_path) != 0)
+        warn("Unable to write trace %s", config.trace_path);
+}
+
+// --jobs: split the recording into config.jobs shards, each decoded by a
+// child process. shards overlap by more than the longest burst so every
+// burst is seen whole by the shard it starts in, and the AGC has settled
+// by the time a shard's own range begins. children return from here with
+// config narrowed to their shard, the parent merges their output and exits.
+static void run_shards(void) {
+    unsigned bps = sample_format_size(config.in_format);
+    size_t chunk = bps * config.channels * AGC_BUFFER_SIZE; // one spewer buffer, in bytes
+    size_t overlap = (bps * MAX_BURST_SIZE * config.channels / 2 + chunk - 1) / chunk + 2;
+    size_t num_chunks, per_shard;
+    unsigned jobs = config.jobs, k, failed = 0;
+    char **spools;
+    pid_t *pids;
+    struct stat st;
+    int status;
+
+    if (fstat(fileno(config.in), &st) != 0 || !S_ISREG(st.st_mode))
+        errx(1, "--jobs requires a regular file");
+    num_chunks = st.st_size / chunk;
+    if (jobs > num_chunks / (2 * overlap))
+        jobs = num_chunks / (2 * overlap);
+    if (jobs < 2) {
+        // too short to be worth splitting
+        config.jobs = 0;
+        return;
+    }
+    per_shard = (num_chunks + jobs - 1) / jobs;
+
+    spools = calloc(jobs, sizeof(*spools));
+    pids = calloc(jobs, sizeof(*pids));
+    fflush(stdout);
+
+    for (k = 0; k < jobs; ++k) {
+        size_t own_start = k * per_shard;
+        size_t own_end = own_start + per_shard < num_chunks ? own_start + per_shard : num_chunks;
+        size_t read_start = own_start > overlap ? own_start - overlap : 0;
+        size_t read_end = own_end + overlap < num_chunks ? own_end + overlap : num_chunks;
+
+        if (config.pcap) {
+            const char *tmpdir = getenv("TMPDIR");
+            int fd;
+            if (asprintf(&spools[k], "%s/ice9-shard-XXXXXX", tmpdir ? tmpdir : "/tmp") < 0 ||
+                    (fd = mkstemp(spools[k])) < 0)
+                err(1, "Unable to create shard spool");
+            close(fd);
+        }
+
+        pids[k] = fork();
+        if (pids[k] < 0)
+            err(1, "fork");
+        if (pids[k] > 0)
+            continue;
+
+        // child: the parent's pcap is left alone, packets go to the spool
+        self_pid = getpid();
+        config.jobs = 0;
+        config.pcap = NULL;
+        if (spools[k] != NULL) {
+            config.pcap = pcap_open(spools[k], PCAP_FORMAT_SPOOL);
+            if (config.pcap == NULL)
+                err(1, "Unable to open shard spool %s", spools[k]);
+        }
+        fclose(config.in);
+        config.in = fopen(config.in_path, "r");
+        if (config.in == NULL)
+            err(1, "Unable to open %s", config.in_path);
+
+        config.in_offset = read_start * chunk;
+        config.in_length = (read_end - read_start) * chunk;
+        config.sharded = 1;
+        config.shard_start = (struct timespec){ LONG_MIN, 0 };
+        config.shard_end = (struct timespec){ LONG_MAX, 0 };
+        // a little past either end: a burst on the seam may be started a
+        // sample apart by each side, pcap_merge keeps one of the two
+        if (k > 0)
+            config.shard_start = timespec_add(config.in_epoch, own_start * chunk / bps / config.samp_rate - PCAP_MERGE_WINDOW_NS / 1e9);
+        if (k < jobs - 1)
+            config.shard_end = timespec_add(config.in_epoch, own_end * chunk / bps / config.samp_rate + PCAP_MERGE_WINDOW_NS / 1e9);
+        free(spools);
+        free(pids);
+        return;
+    }
+
+    for (k = 0; k < jobs; ++k) {
+        if (waitpid(pids[k], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ++failed;
+    }
+
+    if (config.pcap && pcap_merge(config.pcap, spools, jobs) != 0)
+        warnx("Unable to merge shard output");
+    for (k = 0; k < jobs; ++k) {
+        if (spools[k] != NULL)
+            unlink(spools[k]);
+        free(spools[k]);
+    }
+    free(spools);
+    free(pids);
+    config_free(&config);
+
+    if (failed)
+        errx(1, "%u of %u shards failed", failed, jobs);
+    exit(0);
+}
+
 int main(int argc, char **argv) {
     unsigned i;
     sdr_dev_t *sdr = NULL;
 
+    sigset_t wait_signals, orig_mask;
+
     signal(SIGINT, sig);
     signal(SIGTERM, sig);
     signal(SIGPIPE, sig);
+    signal(SIGUSR1, wake);
+    signal(SIGUSR2, request_trace);
     self_pid = getpid();
+    main_thread = pthread_self();
 
     // enables , separator in printf
     setlocale(LC_NUMERIC, "");
@@ -558,13 +1152,47 @@ int main(int argc, char **argv) {
         return opt_res < 0 ? 1 : 0;
     }
 
+    if (config.jobs > 1)
+        run_shards();
+
+    // every thread started from here on inherits the mask, so these are
+    // only ever taken by main() and only while it waits in sigsuspend
+    sigemptyset(&wait_signals);
+    sigaddset(&wait_signals, SIGINT);
+    sigaddset(&wait_signals, SIGTERM);
+    sigaddset(&wait_signals, SIGUSR1);
+    sigaddset(&wait_signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &wait_signals, &orig_mask);
+
+    // before anything big is allocated, so it lands on the right node
+    if (placement_init(&placement, config.placement, config.cpus, config.num_cpus) != 0)
+        errx(1, "Unable to place threads, --cpus must name cpus this process may run on");
+    placement_bind(&placement);
+
     if (config.dump_path) {
-        config.dump_file = fopen(config.dump_path, "wb");
-        if (config.dump_file == NULL) {
+        config.dump = sigmf_open(config.dump_path, config.samp_rate, config.center_freq * 1e6);
+        if (config.dump == NULL) {
             err(1, "Unable to open dump file %s", config.dump_path);
         }
     }
 
+    if (config.pcap && pcap_start_writer(config.pcap, config.pcap_policy, PCAP_RING_SIZE) != 0)
+        errx(1, "Unable to start pcap writer");
+
+    if (config.burst_path) {
+        burst_archive = burst_archive_open(config.burst_path, sps() * 1e6f);
+        if (burst_archive == NULL)
+            err(1, "Unable to create burst archive %s", config.burst_path);
+    }
+
+    if (config.synth) {
+        // a whole number of spewer buffers
+        size_t chunk = config.channels * AGC_BUFFER_SIZE;
+        size_t num = ((size_t)(config.synth->seconds * config.samp_rate) + chunk - 1) / chunk * chunk;
+        if (synth_render(&synth, config.synth, config.channels, config.center_freq, num) != 0)
+            errx(1, "Unable to generate %.1f seconds of input", config.synth->seconds);
+    }
+
     if (config.live) {
         sdr = sdr_open_device(&config);
         if (sdr == NULL)
@@ -580,9 +1208,6 @@ int main(int argc, char **argv) {
         init_fft(config.channels, BATCH_SIZE);
         free(h);
 
-        agc_buffers = malloc(2 * config.channels * sizeof(*agc_buffers));
-        agc_live = &agc_buffers[config.channels * live_buf];
-
         catcher = calloc(40, sizeof(burst_catcher_t));
         for (i = 0; i < config.channels; ++i) {
             unsigned freq = config.center_freq + (i < config.channels / 2 ? i : -config.channels + i);
@@ -594,13 +1219,28 @@ int main(int argc, char **argv) {
             }
         }
         if (first_live <= last_live) {
-            for (i = first_live; i <= last_live; ++i)
+            // bursts from a recording with a known start time are timed by
+            // where they are in it, as are shards so they agree at the seams.
+            // anything else keeps the wall clock
+            struct timespec epoch = timespec_add(config.in_epoch, config.in_offset / sample_format_size(config.in_format) / config.samp_rate);
+            for (i = first_live; i <= last_live; ++i) {
                 burst_catcher_create(&catcher[i], 2402 + i * 2);
+                if (!config.live && (config.in_epoch_known || config.sharded))
+                    burst_catcher_set_clock(&catcher[i], epoch, sps() * 1e6f);
+            }
         }
     }
 
+    init_metrics();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     init_threads(!config.live);
 
+    if ((config.metrics_path || config.metrics_socket_path || config.metrics_port) &&
+            metrics_start_exporter(config.metrics_path, config.metrics_socket_path, config.metrics_port, METRICS_INTERVAL_MS, update_metrics) != 0)
+        err(1, "Unable to start metrics");
+
     if (config.live && sdr != NULL) {
         sdr_start(sdr);
     }
@@ -608,7 +1248,12 @@ int main(int argc, char **argv) {
     while (running) {
         if (config.live && sdr != NULL && !sdr_is_streaming(sdr))
             break;
-        pause();
+        sigsuspend(&orig_mask);
+        if (trace_requested) {
+            trace_requested = 0;
+            if (config.trace_path)
+                write_trace();
+        }
     }
     running = 0;
 
@@ -617,11 +1262,33 @@ int main(int argc, char **argv) {
     }
 
     deinit_threads(!config.live);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // last line has the totals
+    metrics_stop_exporter();
+    if (config.trace_path)
+        write_trace();
+
+    if (config.synth) {
+        synth_report(end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+        synth_free(&synth);
+    } else if (config.replay > 0.0f) {
+        printf("replay: dropped %lu samples, %lu bursts\n", samples_dropped, bursts_dropped);
+    }
+
+    if (burst_archive != NULL) {
+        burst_archive_close(burst_archive);
+        burst_archive = NULL;
+    }
 
     if (config.live && sdr != NULL) {
         sdr_close(sdr);
         sdr = NULL;
     }
+    sample_pool_destroy();
+    placement_free(&placement);
+    metrics_free();
+    trace_free();
 
     config_free(&config);
 
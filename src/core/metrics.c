@@ -0,0 +1,563 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#include "metrics.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE on the socket instead
+#endif
+
+static metric_t registry[METRICS_MAX];
+static unsigned num_metrics = 0;
+
+// per-thread blocks, kept until metrics_free so nothing counted by a
+// thread that has exited is lost. the lock is only taken by a thread's
+// first update and by readers
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t **blocks = NULL;
+static unsigned num_blocks = 0;
+static unsigned block_words = 0;
+
+__thread uint64_t *metric_block = NULL;
+__thread unsigned metric_block_generation = 0;
+unsigned metric_generation = 1; // bumped by metrics_free, stale blocks are dropped
+
+metric_t *metric_register(const char *name, const char *help, metric_type_t type,
+        const char *label, const char *const *label_values, unsigned num_series) {
+    metric_t *m;
+    unsigned i;
+
+    // blocks handed out already have their size
+    if (num_metrics == METRICS_MAX || num_series == 0 || num_blocks > 0)
+        return NULL;
+    m = &registry[num_metrics];
+    memset(m, 0, sizeof(*m));
+    m->series = calloc(num_series, sizeof(*m->series));
+    if (m->series == NULL)
+        return NULL;
+
+    m->name = name;
+    m->help = help;
+    m->type = type;
+    m->num_series = num_series;
+    if (type != METRIC_GAUGE) {
+        m->width = type == METRIC_HISTOGRAM ? 2 + METRIC_HIST_BUCKETS : 1;
+        m->offset = block_words;
+        block_words += m->width * num_series;
+    }
+    if (label != NULL) {
+        m->label = label;
+        m->label_values = calloc(num_series, sizeof(*m->label_values));
+        for (i = 0; i < num_series; ++i)
+            m->label_values[i] = strdup(label_values[i]);
+    }
+    ++num_metrics;
+    return m;
+}
+
+metric_t *metric_register_channels(const char *name, const char *help, metric_type_t type,
+        unsigned first_freq, unsigned num_channels) {
+    char (*freqs)[8] = calloc(num_channels, sizeof(*freqs));
+    const char **values = calloc(num_channels, sizeof(*values));
+    metric_t *m;
+    unsigned i;
+
+    for (i = 0; i < num_channels; ++i) {
+        snprintf(freqs[i], sizeof(freqs[i]), "%u", first_freq + 2 * i);
+        values[i] = freqs[i];
+    }
+    m = metric_register(name, help, type, "channel", values, num_channels);
+    free(values);
+    free(freqs);
+    return m;
+}
+
+metric_t *metric_find(const char *name) {
+    unsigned i;
+    for (i = 0; i < num_metrics; ++i)
+        if (strcmp(registry[i].name, name) == 0)
+            return &registry[i];
+    return NULL;
+}
+
+unsigned metrics_count(void) {
+    return num_metrics;
+}
+
+metric_t *metric_get(unsigned i) {
+    return i < num_metrics ? &registry[i] : NULL;
+}
+
+uint64_t *metric_new_block(void) {
+    size_t bytes = ((block_words ? block_words : 1) * sizeof(uint64_t) + METRIC_CACHE_LINE - 1) & ~(size_t)(METRIC_CACHE_LINE - 1);
+    uint64_t **grown;
+    uint64_t *b;
+
+    // a line of its own, whatever the allocator does
+    if (posix_memalign((void **)&b, METRIC_CACHE_LINE, bytes) != 0)
+        abort();
+    memset(b, 0, bytes);
+
+    pthread_mutex_lock(&blocks_lock);
+    grown = realloc(blocks, (num_blocks + 1) * sizeof(*blocks));
+    if (grown == NULL)
+        abort();
+    blocks = grown;
+    blocks[num_blocks++] = b;
+    metric_block = b;
+    metric_block_generation = metric_generation;
+    pthread_mutex_unlock(&blocks_lock);
+    return b;
+}
+
+void metrics_free(void) {
+    unsigned i, j;
+
+    pthread_mutex_lock(&blocks_lock);
+    for (i = 0; i < num_blocks; ++i)
+        free(blocks[i]);
+    free(blocks);
+    blocks = NULL;
+    num_blocks = 0;
+    block_words = 0;
+    __atomic_add_fetch(&metric_generation, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&blocks_lock);
+
+    for (i = 0; i < num_metrics; ++i) {
+        metric_t *m = &registry[i];
+        if (m->label_values != NULL)
+            for (j = 0; j < m->num_series; ++j)
+                free(m->label_values[j]);
+        free(m->label_values);
+        free(m->series);
+    }
+    num_metrics = 0;
+}
+
+uint64_t metric_count(metric_t *m, unsigned series) {
+    uint64_t total = __atomic_load_n(&m->series[series].count, __ATOMIC_RELAXED);
+    unsigned i;
+
+    pthread_mutex_lock(&blocks_lock);
+    for (i = 0; i < num_blocks; ++i)
+        total += __atomic_load_n(&blocks[i][m->offset + series * m->width], __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&blocks_lock);
+    return total;
+}
+
+void metric_histogram(metric_t *m, unsigned series, uint64_t *count, uint64_t *sum, uint64_t *buckets) {
+    unsigned i, b;
+
+    *count = *sum = 0;
+    memset(buckets, 0, METRIC_HIST_BUCKETS * sizeof(*buckets));
+    pthread_mutex_lock(&blocks_lock);
+    for (i = 0; i < num_blocks; ++i) {
+        uint64_t *w = &blocks[i][m->offset + series * m->width];
+        *count += __atomic_load_n(&w[0], __ATOMIC_RELAXED);
+        *sum += __atomic_load_n(&w[1], __ATOMIC_RELAXED);
+        for (b = 0; b < METRIC_HIST_BUCKETS; ++b)
+            buckets[b] += __atomic_load_n(&w[2 + b], __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+// main() takes LC_NUMERIC from the environment for -s, but JSON and the
+// Prometheus format want a '.' whatever the locale. the writers switch the
+// calling thread to C numerics for the duration
+static pthread_once_t c_numeric_once = PTHREAD_ONCE_INIT;
+static locale_t c_numeric = (locale_t)0;
+
+static void c_numeric_init(void) {
+    c_numeric = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+static locale_t use_c_numeric(void) {
+    pthread_once(&c_numeric_once, c_numeric_init);
+    return c_numeric != (locale_t)0 ? uselocale(c_numeric) : (locale_t)0;
+}
+
+static void restore_numeric(locale_t old) {
+    if (old != (locale_t)0)
+        uselocale(old);
+}
+
+static void write_series(FILE *out, metric_t *m, unsigned i) {
+    uint64_t count, sum, buckets[METRIC_HIST_BUCKETS];
+    unsigned b, last = 0;
+
+    switch (m->type) {
+        case METRIC_COUNTER:
+            fprintf(out, "%llu", (unsigned long long)metric_count(m, i));
+            break;
+        case METRIC_GAUGE:
+            fprintf(out, "%g", metric_gauge(m, i));
+            break;
+        case METRIC_HISTOGRAM:
+            metric_histogram(m, i, &count, &sum, buckets);
+            fprintf(out, "{\"count\":%llu,\"sum\":%llu,\"buckets\":[", (unsigned long long)count, (unsigned long long)sum);
+            for (b = 0; b < METRIC_HIST_BUCKETS; ++b)
+                if (buckets[b] != 0)
+                    last = b + 1;
+            for (b = 0; b < last; ++b)
+                fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)buckets[b]);
+            fprintf(out, "]}");
+            break;
+    }
+}
+
+void metrics_write_json(FILE *out) {
+    locale_t old = use_c_numeric();
+    struct timespec now;
+    unsigned i, j;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    fprintf(out, "{\"time\":%ld.%03ld", (long)now.tv_sec, now.tv_nsec / 1000000l);
+    for (i = 0; i < num_metrics; ++i) {
+        metric_t *m = &registry[i];
+        fprintf(out, ",\"%s\":", m->name);
+        if (m->label == NULL) {
+            write_series(out, m, 0);
+            continue;
+        }
+        fprintf(out, "{");
+        for (j = 0; j < m->num_series; ++j) {
+            fprintf(out, "%s\"%s\":", j ? "," : "", m->label_values[j]);
+            write_series(out, m, j);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}\n");
+    fflush(out);
+    restore_numeric(old);
+}
+
+// {label="value" or {label="value", for a histogram's le to follow
+static void prometheus_labels(FILE *out, metric_t *m, unsigned i, int more) {
+    if (m->label != NULL)
+        fprintf(out, "{%s=\"%s\"%s", m->label, m->label_values[i], more ? "," : "}");
+    else if (more)
+        fprintf(out, "{");
+}
+
+void metrics_write_prometheus(FILE *out) {
+    static const char *const types[] = { "counter", "gauge", "histogram" };
+    locale_t old = use_c_numeric();
+    uint64_t count, sum, buckets[METRIC_HIST_BUCKETS];
+    unsigned i, j, b;
+
+    for (i = 0; i < num_metrics; ++i) {
+        metric_t *m = &registry[i];
+        const char *suffix = m->type == METRIC_COUNTER ? "_total" : "";
+
+        fprintf(out, "# HELP ice9_%s%s %s\n", m->name, suffix, m->help);
+        fprintf(out, "# TYPE ice9_%s%s %s\n", m->name, suffix, types[m->type]);
+        for (j = 0; j < m->num_series; ++j) {
+            switch (m->type) {
+                case METRIC_COUNTER:
+                    fprintf(out, "ice9_%s_total", m->name);
+                    prometheus_labels(out, m, j, 0);
+                    fprintf(out, " %llu\n", (unsigned long long)metric_count(m, j));
+                    break;
+                case METRIC_GAUGE:
+                    fprintf(out, "ice9_%s", m->name);
+                    prometheus_labels(out, m, j, 0);
+                    fprintf(out, " %g\n", metric_gauge(m, j));
+                    break;
+                case METRIC_HISTOGRAM:
+                    // ours count below 2^b, Prometheus buckets are cumulative
+                    // and inclusive
+                    metric_histogram(m, j, &count, &sum, buckets);
+                    for (b = 0; b < METRIC_HIST_BUCKETS; ++b) {
+                        if (b > 0)
+                            buckets[b] += buckets[b - 1];
+                        fprintf(out, "ice9_%s_bucket", m->name);
+                        prometheus_labels(out, m, j, 1);
+                        if (b < METRIC_HIST_BUCKETS - 1)
+                            fprintf(out, "le=\"%llu\"} %llu\n", (1ull << b) - 1, (unsigned long long)buckets[b]);
+                        else
+                            fprintf(out, "le=\"+Inf\"} %llu\n", (unsigned long long)buckets[b]);
+                    }
+                    // the threads may have moved on while we added up, keep
+                    // +Inf and count the same
+                    count = buckets[METRIC_HIST_BUCKETS - 1];
+                    fprintf(out, "ice9_%s_sum", m->name);
+                    prometheus_labels(out, m, j, 0);
+                    fprintf(out, " %llu\n", (unsigned long long)sum);
+                    fprintf(out, "ice9_%s_count", m->name);
+                    prometheus_labels(out, m, j, 0);
+                    fprintf(out, " %llu\n", (unsigned long long)count);
+                    break;
+            }
+        }
+    }
+    fflush(out);
+    restore_numeric(old);
+}
+
+// exporter thread: a line to the file every interval, one to anyone who
+// connects to the socket, a page to each scrape. it sleeps in poll() so it
+// costs nothing between
+static struct {
+    pthread_t thread;
+    FILE *out;
+    int close_out;
+    int listen_fd;
+    char *socket_path;
+    int http_fd;
+    int stop_pipe[2];
+    unsigned interval_ms;
+    void (*update)(void);
+} exporter = { .listen_fd = -1, .http_fd = -1, .stop_pipe = { -1, -1 } };
+
+static void snapshot(FILE *out) {
+    if (exporter.update != NULL)
+        exporter.update();
+    metrics_write_json(out);
+}
+
+// a client that hangs up early must not raise SIGPIPE, main() takes that
+// as a signal to stop
+static void send_all(int fd, const char *buf, size_t len) {
+    size_t off = 0;
+
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    while (off < len) {
+        ssize_t r = send(fd, buf + off, len - off, MSG_NOSIGNAL);
+        if (r <= 0)
+            break;
+        off += r;
+    }
+}
+
+static void serve_client(int fd) {
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&buf, &len);
+
+    if (f != NULL) {
+        snapshot(f);
+        fclose(f);
+        send_all(fd, buf, len);
+        free(buf);
+    }
+    close(fd);
+}
+
+// just enough HTTP for a scraper: GET /metrics, one request per connection
+static void serve_http(int fd) {
+    struct timeval timeout = { 1, 0 };
+    char req[1024], *buf = NULL;
+    size_t len = 0;
+    ssize_t n, got = 0;
+    FILE *f;
+
+    // a client that never sends its request can't hold the thread up
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (got < (ssize_t)sizeof(req) - 1 && (n = recv(fd, req + got, sizeof(req) - 1 - got, 0)) > 0) {
+        got += n;
+        req[got] = '\0';
+        if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)
+            break;
+    }
+    req[got] = '\0';
+
+    if (strncmp(req, "GET /metrics ", 13) != 0 && strncmp(req, "GET / ", 6) != 0) {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        close(fd);
+        return;
+    }
+
+    f = open_memstream(&buf, &len);
+    if (f != NULL) {
+        char head[160];
+        if (exporter.update != NULL)
+            exporter.update();
+        metrics_write_prometheus(f);
+        fclose(f);
+        snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+        send_all(fd, head, strlen(head));
+        send_all(fd, buf, len);
+        free(buf);
+    }
+    close(fd);
+}
+
+static unsigned long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000lu + (unsigned long)now.tv_nsec / 1000000lu;
+}
+
+static void *exporter_thread(void *arg) {
+    unsigned long next = now_ms() + exporter.interval_ms;
+
+    for (;;) {
+        struct pollfd fds[3] = {
+            { .fd = exporter.stop_pipe[0], .events = POLLIN },
+            { .fd = exporter.listen_fd, .events = POLLIN }, // ignored while -1
+            { .fd = exporter.http_fd, .events = POLLIN },
+        };
+        unsigned long now = now_ms();
+        int timeout = -1;
+
+        if (exporter.out != NULL)
+            timeout = next > now ? (int)(next - now) : 0;
+        if (poll(fds, 3, timeout) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents)
+            break;
+        if (fds[1].revents & POLLIN) {
+            int fd = accept(exporter.listen_fd, NULL, NULL);
+            if (fd >= 0)
+                serve_client(fd);
+        }
+        if (fds[2].revents & POLLIN) {
+            int fd = accept(exporter.http_fd, NULL, NULL);
+            if (fd >= 0)
+                serve_http(fd);
+        }
+        if (exporter.out != NULL && now_ms() >= next) {
+            snapshot(exporter.out);
+            next += exporter.interval_ms;
+        }
+    }
+    return NULL;
+}
+
+static int open_socket(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    // a stale socket from a run that didn't get to clean up, but nothing
+    // else of that name
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// loopback only: the metrics are for a scraper on the same host (or one
+// tunnelled in), not for the network
+static int open_http(unsigned port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    int fd, one = 1;
+
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+int metrics_start_exporter(const char *json_path, const char *socket_path, unsigned port,
+        unsigned interval_ms, void (*update)(void)) {
+    exporter.interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    exporter.update = update;
+
+    if (json_path != NULL) {
+        if (strcmp(json_path, "-") == 0) {
+            exporter.out = stdout;
+        } else {
+            exporter.out = fopen(json_path, "a");
+            exporter.close_out = 1;
+        }
+        if (exporter.out == NULL)
+            return -1;
+    }
+    if (socket_path != NULL) {
+        exporter.listen_fd = open_socket(socket_path);
+        if (exporter.listen_fd < 0)
+            goto fail;
+        exporter.socket_path = strdup(socket_path);
+    }
+    if (port != 0) {
+        exporter.http_fd = open_http(port);
+        if (exporter.http_fd < 0)
+            goto fail;
+    }
+
+    if (pipe(exporter.stop_pipe) != 0)
+        goto fail;
+    if (pthread_create(&exporter.thread, NULL, exporter_thread, NULL) != 0)
+        goto fail;
+#ifdef __linux__
+    pthread_setname_np(exporter.thread, "metrics");
+#endif
+    return 0;
+
+fail:
+    metrics_stop_exporter();
+    return -1;
+}
+
+void metrics_stop_exporter(void) {
+    if (exporter.stop_pipe[1] >= 0) {
+        (void)!write(exporter.stop_pipe[1], "", 1);
+        pthread_join(exporter.thread, NULL);
+        close(exporter.stop_pipe[0]);
+        close(exporter.stop_pipe[1]);
+        // the totals at the end of the run
+        if (exporter.out != NULL)
+            snapshot(exporter.out);
+    }
+    if (exporter.listen_fd >= 0) {
+        close(exporter.listen_fd);
+        unlink(exporter.socket_path);
+    }
+    if (exporter.http_fd >= 0)
+        close(exporter.http_fd);
+    if (exporter.close_out && exporter.out != NULL)
+        fclose(exporter.out);
+    free(exporter.socket_path);
+    memset(&exporter, 0, sizeof(exporter));
+    exporter.listen_fd = exporter.http_fd = -1;
+    exporter.stop_pipe[0] = exporter.stop_pipe[1] = -1;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICS_MAX 64
+// bucket i counts observations below 2^i (microseconds, for the timings),
+// the last one everything else
+#define METRIC_HIST_BUCKETS 24
+#define METRIC_CACHE_LINE 64
+
+// registry of the pipeline's counters, gauges and histograms
+//
+// a metric has one series, or one per value of its label (a channel, a
+// drop reason). counters and histograms are per thread: the first update
+// from a thread gives it a block of its own with room for every series,
+// after that an update is a plain add to memory no other thread writes.
+// readers sum the blocks. gauges, and counters that mirror a total kept
+// elsewhere, have one shared value instead.
+//
+// metrics are registered once at startup, before any thread updates them.
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_t;
+
+typedef struct _metric_series_t {
+    union {
+        uint64_t count; // metric_set_count
+        double gauge;
+    };
+} metric_series_t;
+
+typedef struct _metric_t {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+    const char *label;          // NULL for a single series
+    char **label_values;        // num_series of them
+    unsigned num_series;
+    metric_series_t *series;    // shared values
+    unsigned offset;            // into each thread's block, in words
+    unsigned width;             // words per series: 1, or count, sum and buckets
+} metric_t;
+
+// label and label_values may be NULL for a single series. label values
+// are copied. returns NULL if the registry is full or already in use
+metric_t *metric_register(const char *name, const char *help, metric_type_t type,
+        const char *label, const char *const *label_values, unsigned num_series);
+// registers a metric with one series per 2 MHz channel, labelled with its
+// frequency in MHz
+metric_t *metric_register_channels(const char *name, const char *help, metric_type_t type,
+        unsigned first_freq, unsigned num_channels);
+metric_t *metric_find(const char *name);
+unsigned metrics_count(void);
+metric_t *metric_get(unsigned i);
+// every thread that updated a metric must be done with it
+void metrics_free(void);
+
+// this thread's block. the slow path allocates it
+extern __thread uint64_t *metric_block;
+extern __thread unsigned metric_block_generation;
+extern unsigned metric_generation;
+uint64_t *metric_new_block(void);
+
+static inline uint64_t *metric_words(metric_t *m, unsigned series) {
+    uint64_t *b = metric_block;
+    if (__builtin_expect(b == NULL || metric_block_generation != __atomic_load_n(&metric_generation, __ATOMIC_RELAXED), 0))
+        b = metric_new_block();
+    return b + m->offset + series * m->width;
+}
+
+// only this thread writes the word, the atomics just keep readers from
+// seeing it torn
+static inline void metric_local_add(uint64_t *w, uint64_t n) {
+    __atomic_store_n(w, __atomic_load_n(w, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline void metric_add(metric_t *m, unsigned series, uint64_t n) {
+    metric_local_add(metric_words(m, series), n);
+}
+
+static inline void metric_inc(metric_t *m, unsigned series) {
+    metric_add(m, series, 1);
+}
+
+static inline void metric_observe(metric_t *m, unsigned series, uint64_t v) {
+    uint64_t *w = metric_words(m, series);
+    unsigned b = v == 0 ? 0 : 64 - __builtin_clzll(v);
+    if (b >= METRIC_HIST_BUCKETS)
+        b = METRIC_HIST_BUCKETS - 1;
+    metric_local_add(&w[0], 1);
+    metric_local_add(&w[1], v);
+    metric_local_add(&w[2 + b], 1);
+}
+
+// counters that mirror a total kept elsewhere
+static inline void metric_set_count(metric_t *m, unsigned series, uint64_t n) {
+    __atomic_store_n(&m->series[series].count, n, __ATOMIC_RELAXED);
+}
+
+static inline void metric_set(metric_t *m, unsigned series, double v) {
+    __atomic_store(&m->series[series].gauge, &v, __ATOMIC_RELAXED);
+}
+
+static inline double metric_gauge(metric_t *m, unsigned series) {
+    double v;
+    __atomic_load(&m->series[series].gauge, &v, __ATOMIC_RELAXED);
+    return v;
+}
+
+// totals over every thread
+uint64_t metric_count(metric_t *m, unsigned series);
+// buckets has METRIC_HIST_BUCKETS entries, not cumulative
+void metric_histogram(metric_t *m, unsigned series, uint64_t *count, uint64_t *sum, uint64_t *buckets);
+
+// one JSON object on one line: {"time":<unix seconds>,"<name>":value, ...}.
+// labelled metrics are objects keyed by label value, histograms
+// {"count":n,"sum":s,"buckets":[...]} with trailing empty buckets left off
+void metrics_write_json(FILE *out);
+// Prometheus text format, names prefixed ice9_
+void metrics_write_prometheus(FILE *out);
+
+// --metrics / --metrics-socket / --metrics-port: a thread appends a JSON
+// line to json_path ("-" for stdout) every interval_ms, answers every
+// connection to the Unix socket at socket_path with one, and serves
+// Prometheus scrapes over HTTP on 127.0.0.1:port. any of them may be off
+// (NULL, or port 0). update is called first each time, to refresh gauges
+// that are sampled rather than counted. returns -1 if the file or either
+// socket can't be opened
+int metrics_start_exporter(const char *json_path, const char *socket_path, unsigned port,
+        unsigned interval_ms, void (*update)(void));
+// writes a final line and stops
+void metrics_stop_exporter(void);
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpsc_ring.h"
+
+// each cell is a sequence number followed by the element. the sequence
+// tells a thread whether the cell is free for the lap it wants to write
+// (seq == pos) or holds data for the lap it wants to read (seq == pos + 1).
+static inline size_t *cell_seq(mpsc_ring_t *r, size_t pos) {
+    return (size_t *)(r->cells + (pos & r->mask) * r->stride);
+}
+
+static inline void *cell_data(mpsc_ring_t *r, size_t pos) {
+    return r->cells + (pos & r->mask) * r->stride + sizeof(size_t);
+}
+
+int mpsc_ring_init(mpsc_ring_t *r, unsigned capacity, size_t elem_size) {
+    size_t i, n = 2;
+
+    memset(r, 0, sizeof(*r));
+    while (n < capacity)
+        n <<= 1;
+
+    r->mask = n - 1;
+    r->elem_size = elem_size;
+    r->stride = (sizeof(size_t) + elem_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    if (posix_memalign((void **)&r->cells, MPSC_RING_CACHE_LINE, n * r->stride) != 0)
+        return -1;
+
+    for (i = 0; i < n; ++i)
+        *cell_seq(r, i) = i;
+
+    futex_init(&r->not_empty);
+    futex_init(&r->not_full);
+    return 0;
+}
+
+void mpsc_ring_destroy(mpsc_ring_t *r) {
+    futex_destroy(&r->not_empty);
+    futex_destroy(&r->not_full);
+    free(r->cells);
+    r->cells = NULL;
+}
+
+int mpsc_ring_push(mpsc_ring_t *r, const void *elem) {
+    size_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+    for (;;) {
+        size_t seq = __atomic_load_n(cell_seq(r, pos), __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1; // full
+        } else {
+            pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(cell_data(r, pos), elem, r->elem_size);
+    // seq_cst against mpsc_ring_take: either it sees the element or we see
+    // it waiting
+    __atomic_store_n(cell_seq(r, pos), pos + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->consumer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&r->consumer_waiting, 0, __ATOMIC_SEQ_CST))
+        futex_wake(&r->not_empty);
+    return 0;
+}
+
+int mpsc_ring_pop(mpsc_ring_t *r, void *elem_out) {
+    return mpsc_ring_pop_batch(r, elem_out, 1) == 1 ? 0 : -1;
+}
+
+// claims the run of full cells at the tail with a single CAS
+size_t mpsc_ring_pop_batch(mpsc_ring_t *r, void *elems_out, size_t max) {
+    size_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED), n, i;
+
+    for (;;) {
+        for (n = 0; n < max; ++n)
+            if (__atomic_load_n(cell_seq(r, pos + n), __ATOMIC_ACQUIRE) != pos + n + 1)
+                break;
+        if (n > 0) {
+            if (__atomic_compare_exchange_n(&r->tail, &pos, pos + n, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if ((intptr_t)__atomic_load_n(cell_seq(r, pos), __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1) < 0) {
+            return 0; // empty
+        } else {
+            pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        memcpy((uint8_t *)elems_out + i * r->elem_size, cell_data(r, pos + i), r->elem_size);
+        __atomic_store_n(cell_seq(r, pos + i), pos + i + r->mask + 1, __ATOMIC_SEQ_CST);
+    }
+    if (__atomic_load_n(&r->producers_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&r->producers_waiting, 0, __ATOMIC_SEQ_CST))
+        futex_wake(&r->not_full);
+    return n;
+}
+
+static int ring_full(mpsc_ring_t *r) {
+    size_t pos = __atomic_load_n(&r->head, __ATOMIC_SEQ_CST);
+    return (intptr_t)__atomic_load_n(cell_seq(r, pos), __ATOMIC_SEQ_CST) - (intptr_t)pos < 0;
+}
+
+static int ring_empty(mpsc_ring_t *r) {
+    size_t pos = __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST);
+    return (intptr_t)__atomic_load_n(cell_seq(r, pos), __ATOMIC_SEQ_CST) - (intptr_t)(pos + 1) < 0;
+}
+
+int mpsc_ring_put(mpsc_ring_t *r, const void *elem) {
+    for (;;) {
+        uint32_t seq;
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            return -1;
+        if (mpsc_ring_push(r, elem) == 0)
+            return 0;
+
+        seq = futex_value(&r->not_full);
+        __atomic_store_n(&r->producers_waiting, 1, __ATOMIC_SEQ_CST);
+        // room may have been made before the flag was visible
+        if (ring_full(r) && !__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            futex_wait(&r->not_full, seq);
+    }
+}
+
+int mpsc_ring_take(mpsc_ring_t *r, void *elems_out, size_t max) {
+    for (;;) {
+        uint32_t seq;
+        size_t n;
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            return -1;
+        if ((n = mpsc_ring_pop_batch(r, elems_out, max)) > 0)
+            return n;
+
+        seq = futex_value(&r->not_empty);
+        __atomic_store_n(&r->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (ring_empty(r) && !__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            futex_wait(&r->not_empty, seq);
+        __atomic_store_n(&r->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void mpsc_ring_close(mpsc_ring_t *r) {
+    __atomic_store_n(&r->closed, 1, __ATOMIC_RELEASE);
+    futex_wake(&r->not_empty);
+    futex_wake(&r->not_full);
+}
+
+size_t mpsc_ring_size(mpsc_ring_t *r) {
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    return head >= tail ? head - tail : 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __MPSC_RING_H__
+#define __MPSC_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "futex.h"
+
+#define MPSC_RING_CACHE_LINE 64
+
+// bounded lock-free queue of fixed-size elements (D. Vyukov's design)
+//
+// any number of threads may push concurrently. pop is safe to call from
+// producers as well as the consumer, which is what lets a producer facing
+// a full ring evict the oldest element without taking a lock.
+//
+// put and take block when the ring is full / empty. the sleeping side is
+// woken by the first push / pop after it starts waiting, nobody pays for
+// it otherwise.
+typedef struct _mpsc_ring_t {
+    size_t head __attribute__((aligned(MPSC_RING_CACHE_LINE))); // next slot to push
+    size_t tail __attribute__((aligned(MPSC_RING_CACHE_LINE))); // next slot to pop
+    futex_t not_empty __attribute__((aligned(MPSC_RING_CACHE_LINE)));
+    futex_t not_full;
+    int consumer_waiting;
+    int producers_waiting;
+    int closed;
+    size_t mask __attribute__((aligned(MPSC_RING_CACHE_LINE)));
+    size_t elem_size;
+    size_t stride;
+    uint8_t *cells;
+} mpsc_ring_t;
+
+// capacity is rounded up to a power of two
+int mpsc_ring_init(mpsc_ring_t *r, unsigned capacity, size_t elem_size);
+void mpsc_ring_destroy(mpsc_ring_t *r);
+
+// return 0 on success, -1 if the ring is full / empty
+int mpsc_ring_push(mpsc_ring_t *r, const void *elem);
+int mpsc_ring_pop(mpsc_ring_t *r, void *elem_out);
+// pops up to max elements into the array elems_out, returns how many
+size_t mpsc_ring_pop_batch(mpsc_ring_t *r, void *elems_out, size_t max);
+
+// block while full / empty. put returns 0 on success, take returns how
+// many elements it popped (at least one). both return -1 once the ring is
+// closed
+int mpsc_ring_put(mpsc_ring_t *r, const void *elem);
+int mpsc_ring_take(mpsc_ring_t *r, void *elems_out, size_t max);
+
+// wakes and fails any blocked or future put / take
+void mpsc_ring_close(mpsc_ring_t *r);
+
+// approximate number of queued elements
+size_t mpsc_ring_size(mpsc_ring_t *r);
+
+#endif
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -19,6 +20,7 @@
 #endif
 
 #include "options.h"
+#include "realtime.h"
 #include "hackrf.h"
 #include "bladerf.h"
 #include "usrp.h"
@@ -28,6 +30,8 @@ void usage(int exitcode);
 void config_init(sniffer_config_t *cfg) {
     memset(cfg, 0, sizeof(*cfg));
     cfg->bladerf_num = -1;
+    cfg->pcap_policy = PCAP_POLICY_BLOCK;
+    cfg->pcap_format = PCAP_FORMAT_PCAP;
 }
 
 void config_free(sniffer_config_t *cfg) {
@@ -43,17 +47,49 @@ void config_free(sniffer_config_t *cfg) {
         pcap_close(cfg->pcap);
         cfg->pcap = NULL;
     }
+    if (cfg->pcap_path) {
+        free(cfg->pcap_path);
+        cfg->pcap_path = NULL;
+    }
     if (cfg->in && cfg->in != stdin) {
         fclose(cfg->in);
         cfg->in = NULL;
     }
+    if (cfg->in_path) {
+        free(cfg->in_path);
+        cfg->in_path = NULL;
+    }
+    if (cfg->synth) {
+        free(cfg->synth);
+        cfg->synth = NULL;
+    }
+    if (cfg->burst_path) {
+        free(cfg->burst_path);
+        cfg->burst_path = NULL;
+    }
     if (cfg->dump_path) {
         free(cfg->dump_path);
         cfg->dump_path = NULL;
     }
-    if (cfg->dump_file) {
-        fclose(cfg->dump_file);
-        cfg->dump_file = NULL;
+    if (cfg->dump) {
+        sigmf_close(cfg->dump);
+        cfg->dump = NULL;
+    }
+    if (cfg->cpus) {
+        free(cfg->cpus);
+        cfg->cpus = NULL;
+    }
+    if (cfg->metrics_path) {
+        free(cfg->metrics_path);
+        cfg->metrics_path = NULL;
+    }
+    if (cfg->metrics_socket_path) {
+        free(cfg->metrics_socket_path);
+        cfg->metrics_socket_path = NULL;
+    }
+    if (cfg->trace_path) {
+        free(cfg->trace_path);
+        cfg->trace_path = NULL;
     }
 }
 
@@ -125,11 +161,29 @@ static void _print_config(void) {
         printf("value {arg=0}{value=%d}{display=%d}{default=falses}\n", i, i);
     printf("value {arg=0}{value=96}{display=96}{default=true}\n");
     printf("arg {number=1}{call=--center-freq}{display=Center Frequency}{tooltip=Center frequency to capture on}{type=integer}{range=2400,2480}{default=2441}\n");
+    printf("arg {number=2}{call=--metrics-port}{display=Metrics Port}{tooltip=Serve Prometheus metrics on this localhost port, 0 for off}{type=unsigned}{range=0,65535}{default=0}\n");
+}
+
+// --format names, plus the little-endian SigMF spellings
+static int parse_sample_format(const char *name, sample_format_t *out) {
+    if (strcmp(name, "ci8") == 0 || strcmp(name, "ci8_le") == 0)
+        *out = SAMPLE_FORMAT_CI8;
+    else if (strcmp(name, "ci16") == 0 || strcmp(name, "ci16_le") == 0)
+        *out = SAMPLE_FORMAT_CI16;
+    else if (strcmp(name, "cf32") == 0 || strcmp(name, "cf32_le") == 0)
+        *out = SAMPLE_FORMAT_CF32;
+    else
+        return -1;
+    return 0;
 }
 
 int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
     int do_interfaces = 0, do_dlts = 0, do_config = 0, do_capture = 0, do_install = 0;
-    int ch;
+    int ch, rotate;
+    struct stat st;
+    sigmf_info_t in_sigmf;
+    int in_is_sigmf = 1, have_format = 0;
+    char *in_data_path = NULL;
 
     optind = 1; // Reset getopt state for re-entrancy
     config_init(cfg);
@@ -155,6 +209,23 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
         { "install",                no_argument,            NULL,          'I' },
         { "dump",                   required_argument,      NULL,          'd' },
         { "dump-only",              no_argument,            NULL,           4 },
+        { "pcap-policy",            required_argument,      NULL,           5 },
+        { "pcapng",                 no_argument,            NULL,           6 },
+        { "rotate-size",            required_argument,      NULL,           7 },
+        { "rotate-time",            required_argument,      NULL,           8 },
+        { "rotate-packets",         required_argument,      NULL,           9 },
+        { "rotate-files",           required_argument,      NULL,          10 },
+        { "bursts",                 required_argument,      NULL,          11 },
+        { "jobs",                   required_argument,      NULL,          12 },
+        { "format",                 required_argument,      NULL,          13 },
+        { "replay",                 optional_argument,      NULL,          14 },
+        { "cpus",                   required_argument,      NULL,          15 },
+        { "rt",                     optional_argument,      NULL,          16 },
+        { "metrics",                required_argument,      NULL,          17 },
+        { "metrics-socket",         required_argument,      NULL,          18 },
+        { "metrics-port",           required_argument,      NULL,          19 },
+        { "trace",                  required_argument,      NULL,          20 },
+        { "synth",                  optional_argument,      NULL,          21 },
         { NULL,                     0,                      NULL,           0 }
     };
 
@@ -205,14 +276,23 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
                 break;
 
             case 'w':
-                if ((cfg->pcap = pcap_open(optarg)) == NULL) {
-                    fprintf(stderr, "Unable to create PCAP %s\n", optarg);
-                    return -1;
-                }
+                free(cfg->pcap_path);
+                cfg->pcap_path = strdup(optarg);
                 break;
 
             case 'f':
-                cfg->in = fopen(optarg, "r");
+                free(in_data_path);
+                in_data_path = NULL;
+                in_is_sigmf = sigmf_read(optarg, &in_sigmf, &in_data_path);
+                if (in_is_sigmf < 0) {
+                    fprintf(stderr, "Can't parse SigMF metadata for %s\n", optarg);
+                    return -1;
+                }
+                if (cfg->in && cfg->in != stdin)
+                    fclose(cfg->in);
+                free(cfg->in_path);
+                cfg->in_path = strdup(in_is_sigmf == 0 ? in_data_path : optarg);
+                cfg->in = fopen(cfg->in_path, "r");
                 if (cfg->in == NULL) {
                     fprintf(stderr, "Can't open input file\n");
                     return -1;
@@ -252,6 +332,130 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
                 cfg->dump_only = 1;
                 break;
 
+            case 5:
+                if (strcmp(optarg, "block") == 0) {
+                    cfg->pcap_policy = PCAP_POLICY_BLOCK;
+                } else if (strcmp(optarg, "drop-newest") == 0) {
+                    cfg->pcap_policy = PCAP_POLICY_DROP_NEWEST;
+                } else if (strcmp(optarg, "drop-oldest") == 0) {
+                    cfg->pcap_policy = PCAP_POLICY_DROP_OLDEST;
+                } else {
+                    fprintf(stderr, "invalid pcap policy, must be block, drop-newest, or drop-oldest\n");
+                    return -1;
+                }
+                break;
+
+            case 6:
+                cfg->pcap_format = PCAP_FORMAT_PCAPNG;
+                break;
+
+            case 7:
+                cfg->pcap_rotate.max_bytes = strtoul(optarg, NULL, 10) * 1000000lu;
+                break;
+
+            case 8:
+                cfg->pcap_rotate.max_seconds = strtoul(optarg, NULL, 10);
+                break;
+
+            case 9:
+                cfg->pcap_rotate.max_packets = strtoul(optarg, NULL, 10);
+                break;
+
+            case 10:
+                cfg->pcap_rotate.max_files = strtoul(optarg, NULL, 10);
+                break;
+
+            case 11:
+                free(cfg->burst_path);
+                cfg->burst_path = strdup(optarg);
+                break;
+
+            case 12:
+                cfg->jobs = strtoul(optarg, NULL, 10);
+                break;
+
+            case 13:
+                if (parse_sample_format(optarg, &cfg->in_format) != 0) {
+                    fprintf(stderr, "invalid format, must be ci8, ci16, or cf32\n");
+                    return -1;
+                }
+                have_format = 1;
+                break;
+
+            case 14:
+                cfg->replay = optarg ? strtof(optarg, NULL) : 1.0f;
+                if (cfg->replay <= 0.0f) {
+                    fprintf(stderr, "invalid replay speed, must be greater than 0\n");
+                    return -1;
+                }
+                break;
+
+            case 15:
+                free(cfg->cpus);
+                cfg->cpus = NULL;
+                cfg->num_cpus = 0;
+                if (strcmp(optarg, "auto") == 0) {
+                    cfg->placement = PLACEMENT_AUTO;
+                } else {
+                    unsigned *cpus = malloc(sizeof(*cpus) * PLACEMENT_MAX_CPUS);
+                    int num = cpus ? parse_cpu_list(optarg, cpus, PLACEMENT_MAX_CPUS) : -1;
+                    if (num < 0) {
+                        free(cpus);
+                        fprintf(stderr, "invalid cpus, must be auto or a list like 0-3,8\n");
+                        return -1;
+                    }
+                    cfg->placement = PLACEMENT_LIST;
+                    cfg->cpus = cpus;
+                    cfg->num_cpus = num;
+                }
+                break;
+
+            case 16:
+                cfg->rt_priority = optarg ? atoi(optarg) : RT_DEFAULT_PRIORITY;
+                // the channelizer runs one below
+                if (cfg->rt_priority < 2 || cfg->rt_priority > 99) {
+                    fprintf(stderr, "invalid realtime priority, must be between 2 and 99\n");
+                    return -1;
+                }
+                break;
+
+            case 17:
+                free(cfg->metrics_path);
+                cfg->metrics_path = strdup(optarg);
+                break;
+
+            case 18:
+                free(cfg->metrics_socket_path);
+                cfg->metrics_socket_path = strdup(optarg);
+                break;
+
+            case 19:
+                cfg->metrics_port = strtoul(optarg, NULL, 10);
+                if (cfg->metrics_port > 65535) {
+                    fprintf(stderr, "invalid metrics port, must be between 0 (off) and 65535\n");
+                    return -1;
+                }
+                break;
+
+            case 20:
+#ifdef USE_TRACE
+                free(cfg->trace_path);
+                cfg->trace_path = strdup(optarg);
+#else
+                fprintf(stderr, "tracing not compiled in, build with -DENABLE_TRACE=ON\n");
+                return -1;
+#endif
+                break;
+
+            case 21:
+                if (cfg->synth == NULL) {
+                    cfg->synth = malloc(sizeof(*cfg->synth));
+                    synth_defaults(cfg->synth);
+                }
+                if (optarg && synth_parse(cfg->synth, optarg) != 0)
+                    return -1;
+                break;
+
             case '?':
             case 'h':
             default:
@@ -260,13 +464,41 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
         }
     }
 
+    free(in_data_path);
+
     if (do_install) {
         install();
         return 1;
     }
 
+    // a SigMF recording describes itself, command line arguments win
+    if (in_is_sigmf == 0) {
+        unsigned channels = (unsigned)(in_sigmf.sample_rate / 1e6 + 0.5);
+        sample_format_t format;
+        if (parse_sample_format(in_sigmf.datatype, &format) != 0) {
+            fprintf(stderr, "unsupported SigMF datatype %s, must be ci8, ci16_le, or cf32_le\n", in_sigmf.datatype);
+            return -1;
+        }
+        if (!have_format)
+            cfg->in_format = format;
+        else if (cfg->in_format != format)
+            fprintf(stderr, "WARNING: SigMF datatype is %s, reading it as --format says\n", in_sigmf.datatype);
+        if (cfg->center_freq == 0)
+            cfg->center_freq = (unsigned)(in_sigmf.frequency / 1e6 + 0.5);
+        cfg->in_epoch = in_sigmf.datetime;
+        cfg->in_epoch_known = in_sigmf.datetime.tv_sec != 0;
+        if (cfg->channels == 0)
+            cfg->channels = channels;
+        else if (cfg->channels != channels)
+            fprintf(stderr, "WARNING: SigMF sample rate is %.0f, but using %u channels\n", in_sigmf.sample_rate, cfg->channels);
+    }
+
     int sum = do_interfaces + do_dlts + do_config + do_capture;
-    if (cfg->in == NULL) {
+    if (cfg->synth != NULL && (cfg->in != NULL || sum != 0)) {
+        fprintf(stderr, "--synth is the input, it cannot be combined with -f or -l\n");
+        return -1;
+    }
+    if (cfg->in == NULL && cfg->synth == NULL) {
         if (sum == 0) {
             usage(0);
             return 1;
@@ -297,10 +529,46 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
         fprintf(stderr, "--dump-only requires --dump <file>\n");
         return -1;
     }
-    if (cfg->dump_only && cfg->pcap != NULL) {
+    if (cfg->dump_only && cfg->pcap_path != NULL) {
         fprintf(stderr, "cannot write PCAP and raw dump at the same time\n");
         return -1;
     }
+    if (cfg->dump_only && cfg->burst_path != NULL) {
+        fprintf(stderr, "cannot write bursts and raw dump at the same time\n");
+        return -1;
+    }
+    if (have_format && (cfg->in == NULL || do_capture)) {
+        fprintf(stderr, "--format only applies to -f <file>\n");
+        return -1;
+    }
+    if (cfg->replay > 0.0f && ((cfg->in == NULL && cfg->synth == NULL) || do_capture)) {
+        fprintf(stderr, "--replay requires -f <file> or --synth\n");
+        return -1;
+    }
+    if (cfg->replay > 0.0f && cfg->jobs > 1) {
+        fprintf(stderr, "--replay cannot be combined with --jobs\n");
+        return -1;
+    }
+    if (cfg->jobs > 1 && (cfg->in == NULL || do_capture)) {
+        fprintf(stderr, "--jobs requires -f <file>\n");
+        return -1;
+    }
+    if (cfg->jobs > 1 && (cfg->dump_path != NULL || cfg->burst_path != NULL)) {
+        fprintf(stderr, "--jobs cannot be combined with --dump or --bursts\n");
+        return -1;
+    }
+    if (cfg->jobs > 1 && cfg->placement != PLACEMENT_NONE) {
+        fprintf(stderr, "--cpus cannot be combined with --jobs\n");
+        return -1;
+    }
+    if (cfg->jobs > 1 && (cfg->metrics_path != NULL || cfg->metrics_socket_path != NULL || cfg->metrics_port != 0)) {
+        fprintf(stderr, "--metrics cannot be combined with --jobs\n");
+        return -1;
+    }
+    if (cfg->jobs > 1 && cfg->trace_path != NULL) {
+        fprintf(stderr, "--trace cannot be combined with --jobs\n");
+        return -1;
+    }
 
     if (cfg->center_freq == 0) {
         fprintf(stderr, "center freq is required\n");
@@ -318,5 +586,39 @@ int parse_options(int argc, char **argv, sniffer_config_t *cfg) {
     if (do_capture)
         cfg->live = 1;
 
+    // without a recorded start time, the run's own start stands in for it
+    // wherever sample times are needed, such as shard boundaries
+    if (!cfg->live && !cfg->in_epoch_known)
+        clock_gettime(CLOCK_REALTIME, &cfg->in_epoch);
+
+    rotate = cfg->pcap_rotate.max_bytes > 0 || cfg->pcap_rotate.max_seconds > 0 || cfg->pcap_rotate.max_packets > 0;
+    if (cfg->pcap_rotate.max_files > 0 && !rotate) {
+        fprintf(stderr, "--rotate-files requires --rotate-size, --rotate-time, or --rotate-packets\n");
+        return -1;
+    }
+    if (rotate && cfg->pcap_path == NULL) {
+        fprintf(stderr, "rotation requires -w <file>\n");
+        return -1;
+    }
+
+    if (cfg->pcap_path) {
+        size_t len = strlen(cfg->pcap_path);
+        if (len >= 7 && strcmp(cfg->pcap_path + len - 7, ".pcapng") == 0)
+            cfg->pcap_format = PCAP_FORMAT_PCAPNG;
+        if (rotate) {
+            if (stat(cfg->pcap_path, &st) == 0 && S_ISFIFO(st.st_mode)) {
+                fprintf(stderr, "cannot rotate a FIFO\n");
+                return -1;
+            }
+            cfg->pcap = pcap_open_rotating(cfg->pcap_path, cfg->pcap_format, &cfg->pcap_rotate);
+        } else {
+            cfg->pcap = pcap_open(cfg->pcap_path, cfg->pcap_format);
+        }
+        if (cfg->pcap == NULL) {
+            fprintf(stderr, "Unable to create PCAP %s\n", cfg->pcap_path);
+            return -1;
+        }
+    }
+
     return 0;
 }
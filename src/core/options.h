@@ -7,11 +7,23 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
 
+#include "convert.h"
 #include "pcap.h"
+#include "placement.h"
+#include "sigmf.h"
+#include "synth.h"
 
 typedef struct {
     FILE *in;
+    char *in_path;
+    sample_format_t in_format;
+    float replay;               // --replay: play the file at this many times real time, 0 if off
+    struct timespec in_epoch;   // time of the first sample in the file, or of the start of the run
+    int in_epoch_known;         // in_epoch came from the recording's metadata
+    synth_params_t *synth;      // --synth: generate the input instead, NULL if off
     char *serial;
     char *usrp_serial;
     int bladerf_num;
@@ -19,14 +31,42 @@ typedef struct {
     float samp_rate;
     unsigned channels;
     unsigned center_freq;
+    char *pcap_path;
     pcap_t *pcap;
+    pcap_policy_t pcap_policy;
+    pcap_format_t pcap_format;
+    pcap_rotate_t pcap_rotate;
     int live;
     int verbose;
     int stats;
 
+    char *burst_path;
+
+    // --jobs: split file input across processes. each child decodes bytes
+    // [in_offset, in_offset + in_length) of the file but only keeps bursts
+    // that start in [shard_start, shard_end)
+    unsigned jobs;
+    off_t in_offset, in_length;
+    int sharded;
+    struct timespec shard_start, shard_end;
+
     char *dump_path;
-    FILE *dump_file;
+    sigmf_writer_t *dump;
     int dump_only;
+
+    // --cpus: pin the pipeline threads, to cpus[0..num_cpus) in turn or
+    // wherever the topology suggests
+    placement_mode_t placement;
+    unsigned *cpus;
+    unsigned num_cpus;
+
+    int rt_priority; // --rt: SCHED_FIFO priority of the ingest path, 0 if off
+
+    char *metrics_path;        // --metrics: JSON lines to this file, "-" for stdout
+    char *metrics_socket_path; // --metrics-socket: JSON to whoever connects
+    unsigned metrics_port;     // --metrics-port: Prometheus on 127.0.0.1, 0 if off
+
+    char *trace_path; // --trace: Chrome trace JSON, on SIGUSR2 and at exit
 } sniffer_config_t;
 
 extern sniffer_config_t config;
@@ -2,13 +2,86 @@
  * Copyright (c) 2022 ICE9 Consulting LLC
  */
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include "mpsc_ring.h"
 #include "pcap.h"
 
+// records are assembled here and handed to the kernel in large writes
+#define PCAP_BUFFER_SIZE (1 << 20)
+#define PCAP_BUFFER_ALIGN 4096
+
+// a file is flushed at least this often while packets are arriving
+#define PCAP_FLUSH_INTERVAL_US 100000lu
+
+// largest LE packet: AA + header + 255 byte PDU + CRC
+#define PCAP_MAX_PACKET (4 + 2 + 255 + 3)
+
+// one pcapng interface per link type per MHz, IDBs are written lazily
+#define PCAPNG_NUM_FREQS 80
+
+enum { RECORD_BLE, RECORD_BREDR, RECORD_NUM_TYPES };
+
+// packet as handed from the burst processor to the writer thread
+typedef struct _pcap_record_t {
+    struct timespec timestamp;
+    unsigned freq;
+    uint8_t type;
+    int8_t rssi_db;
+    int8_t noise_db;
+    uint16_t len;
+    uint32_t lap;
+    float cfo;          // Hz
+    float deviation;    // Hz
+    uint8_t data[PCAP_MAX_PACKET];
+} pcap_record_t;
+
 struct _pcap_t {
-    FILE *f;
+    // ring first: it is cache-line aligned
+    mpsc_ring_t ring;
+
+    int fd;
+    int is_fifo;
+    int write_failed;           // fd was closed after a write error
+    pcap_format_t format;
+
+    // rotation, only used when rotating is set
+    int rotating;
+    pcap_rotate_t rotate;
+    char *path;
+    unsigned long file_index;
+    unsigned long file_bytes;   // appended to the current file, including header
+    unsigned long file_packets;
+    unsigned long file_start;   // pcap_now_us() when the current file was opened
+    char **file_names;          // ring of the last rotate.max_files names
+
+    int iface[RECORD_NUM_TYPES][PCAPNG_NUM_FREQS]; // pcapng interface ID, -1 if not written yet
+    unsigned num_ifaces;
+    uint8_t *buf;
+    size_t buf_len;
+    unsigned long last_flush;
+
+    // async writer, only valid when has_writer is set
+    int has_writer;
+    pcap_policy_t policy;
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t data_cond;  // writer waits here for records
+    pthread_cond_t space_cond; // blocked producers wait here for room
+    int writer_waiting;
+    int producers_waiting;
+    int stopping;
+
+    pcap_stats_t stats;
 };
 
 typedef struct __attribute__((packed)) _pcap_hdr_t {
@@ -41,6 +114,65 @@ typedef struct __attribute__((packed)) _pcap_le_header_t {
 #define LE_SIGNAL_POWER_VALID 0x0002
 #define LE_NOISE_POWER_VALID  0x0004
 
+typedef struct __attribute__((packed)) _pcap_bredr_header_t {
+    uint8_t rf_channel;
+    int8_t signal_power;
+    int8_t noise_power;
+    uint8_t access_code_offenses;
+    uint8_t payload_transport_rate;
+    uint8_t corrected_header_bits;
+    int16_t corrected_payload_bits;
+    uint32_t lap;
+    uint32_t ref_lap_uap;
+    uint32_t bt_header;
+    uint16_t flags;
+} pcap_bredr_header_t;
+
+#define BREDR_SIGNAL_POWER_VALID 0x0002
+#define BREDR_NOISE_POWER_VALID  0x0004
+
+// pcapng blocks are written in host byte order, readers use the SHB's
+// byte-order magic to tell
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+
+#define PCAPNG_OPT_ENDOFOPT  0
+#define PCAPNG_OPT_COMMENT   1
+#define PCAPNG_SHB_USERAPPL  4
+#define PCAPNG_IF_NAME       2
+#define PCAPNG_IF_DESCRIPTION 3
+#define PCAPNG_IF_TSRESOL    9
+
+typedef struct _pcapng_block_hdr_t {
+    uint32_t type;
+    uint32_t total_len;
+} pcapng_block_hdr_t;
+
+typedef struct _pcapng_shb_t {
+    uint32_t byte_order_magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int64_t section_len;
+} pcapng_shb_t;
+
+typedef struct _pcapng_idb_t {
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+} pcapng_idb_t;
+
+typedef struct _pcapng_epb_t {
+    uint32_t interface_id;
+    uint32_t ts_high;
+    uint32_t ts_low;
+    uint32_t captured_len;
+    uint32_t orig_len;
+} pcapng_epb_t;
+
+// largest option area we ever emit in one block
+#define PCAPNG_MAX_OPTIONS 128
+
 
 static inline uint16_t pcap_htole16(uint16_t val) {
 #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
@@ -64,54 +196,669 @@ static inline uint32_t pcap_htole32(uint32_t val) {
 #if !defined( DLT_BLUETOOTH_LE_LL_WITH_PHDR )
 #define DLT_BLUETOOTH_LE_LL_WITH_PHDR 256
 #endif
+#if !defined( DLT_BLUETOOTH_BREDR_BB )
+#define DLT_BLUETOOTH_BREDR_BB 255
+#endif
 
-pcap_t *pcap_open(char *path) {
-    pcap_t *p;
-    pcap_hdr_t h = {
-        .magic_number = pcap_htole32(0xa1b2c3d4),
-        .version_major = pcap_htole16(2),
-        .version_minor = pcap_htole16(4),
-        .thiszone = 0,
-        .sigfigs = 0,
-        .snaplen = pcap_htole32(4 + 2 + 255 + 3),
-        .network = pcap_htole32(DLT_BLUETOOTH_LE_LL_WITH_PHDR),
+static inline unsigned long pcap_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000000lu + (unsigned long)now.tv_nsec / 1000lu;
+}
+
+static void pcap_append(pcap_t *p, const void *data, size_t len) {
+    memcpy(p->buf + p->buf_len, data, len);
+    p->buf_len += len;
+    p->file_bytes += len;
+}
+
+void pcap_flush(pcap_t *p) {
+    size_t off = 0;
+    ssize_t r;
+
+    while (p->fd >= 0 && off < p->buf_len) {
+        r = write(p->fd, p->buf + off, p->buf_len - off);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0) {
+            // reader went away (EPIPE) or the disk is full. the file may end
+            // partway through a record, and anything appended after that
+            // would be garbage to a reader, so this file is done
+            fprintf(stderr, "WARNING: pcap write failed, capture stopped: %s\n",
+                    r < 0 ? strerror(errno) : "short write");
+            close(p->fd);
+            p->fd = -1;
+            p->write_failed = 1;
+            break;
+        }
+        off += r;
+    }
+    // from here on everything is dropped, but still counted
+    if (p->write_failed)
+        __atomic_add_fetch(&p->stats.lost_bytes, p->buf_len - off, __ATOMIC_RELAXED);
+    p->buf_len = 0;
+    p->last_flush = pcap_now_us();
+}
+
+static void pcap_append_option(uint8_t *opts, size_t *len, uint16_t code, const void *val, uint16_t val_len) {
+    uint16_t hdr[2] = { code, val_len };
+    size_t padded = (val_len + 3) & ~3u;
+
+    if (*len + sizeof(hdr) + padded + 4 > PCAPNG_MAX_OPTIONS)
+        return;
+    memcpy(opts + *len, hdr, sizeof(hdr));
+    memset(opts + *len + sizeof(hdr), 0, padded);
+    memcpy(opts + *len + sizeof(hdr), val, val_len);
+    *len += sizeof(hdr) + padded;
+}
+
+static void pcap_end_options(uint8_t *opts, size_t *len) {
+    memset(opts + *len, 0, 4); // opt_endofopt
+    *len += 4;
+}
+
+// append a complete pcapng block: header, body, padding, options, trailer.
+// returns the block length
+static size_t pcapng_append_block(pcap_t *p, uint32_t type, const void *body, size_t body_len,
+                                const void *data, size_t data_len, const uint8_t *opts, size_t opts_len) {
+    static const uint8_t zero[4] = { 0 };
+    size_t data_pad = ((data_len + 3) & ~(size_t)3) - data_len;
+    uint32_t total = sizeof(pcapng_block_hdr_t) + body_len + data_len + data_pad + opts_len + sizeof(uint32_t);
+    pcapng_block_hdr_t hdr = { .type = type, .total_len = total };
+
+    if (p->buf_len + total > PCAP_BUFFER_SIZE)
+        pcap_flush(p);
+
+    pcap_append(p, &hdr, sizeof(hdr));
+    pcap_append(p, body, body_len);
+    if (data_len > 0) {
+        pcap_append(p, data, data_len);
+        pcap_append(p, zero, data_pad);
+    }
+    pcap_append(p, opts, opts_len);
+    pcap_append(p, &total, sizeof(total));
+    return total;
+}
+
+static void pcap_write_file_header(pcap_t *p) {
+    memset(p->iface, 0xff, sizeof(p->iface));
+    p->num_ifaces = 0;
+
+    if (p->format == PCAP_FORMAT_SPOOL) {
+        return;
+    } else if (p->format == PCAP_FORMAT_PCAPNG) {
+        static const char appl[] = "ICE9 Bluetooth Sniffer";
+        uint8_t opts[PCAPNG_MAX_OPTIONS];
+        size_t opts_len = 0;
+        pcapng_shb_t shb = {
+            .byte_order_magic = 0x1a2b3c4d,
+            .version_major = 1,
+            .version_minor = 0,
+            .section_len = -1,
+        };
+        pcap_append_option(opts, &opts_len, PCAPNG_SHB_USERAPPL, appl, sizeof(appl) - 1);
+        pcap_end_options(opts, &opts_len);
+        pcapng_append_block(p, PCAPNG_SHB, &shb, sizeof(shb), NULL, 0, opts, opts_len);
+    } else {
+        pcap_hdr_t h = {
+            .magic_number = pcap_htole32(0xa1b2c3d4),
+            .version_major = pcap_htole16(2),
+            .version_minor = pcap_htole16(4),
+            .thiszone = 0,
+            .sigfigs = 0,
+            .snaplen = pcap_htole32(PCAP_MAX_PACKET),
+            .network = pcap_htole32(DLT_BLUETOOTH_LE_LL_WITH_PHDR),
+        };
+        pcap_append(p, &h, sizeof(h));
+    }
+}
+
+// interface for this record's link type and frequency, emitting its IDB
+// the first time it is seen
+static uint32_t pcapng_interface(pcap_t *p, const pcap_record_t *r) {
+    unsigned slot = (r->freq - 2402) % PCAPNG_NUM_FREQS;
+    uint8_t opts[PCAPNG_MAX_OPTIONS];
+    size_t opts_len = 0;
+    char name[32];
+    uint8_t tsresol = 9; // nanoseconds
+    pcapng_idb_t idb = {
+        .linktype = r->type == RECORD_BLE ? DLT_BLUETOOTH_LE_LL_WITH_PHDR : DLT_BLUETOOTH_BREDR_BB,
+        .reserved = 0,
+        .snaplen = PCAP_MAX_PACKET + sizeof(pcap_bredr_header_t),
     };
 
-    FILE *f = fopen(path, "wb");
-    if (f == NULL)
+    if (p->iface[r->type][slot] >= 0)
+        return p->iface[r->type][slot];
+
+    snprintf(name, sizeof(name), "%s-%u", r->type == RECORD_BLE ? "ble" : "bredr", r->freq);
+    pcap_append_option(opts, &opts_len, PCAPNG_IF_NAME, name, strlen(name));
+    pcap_append_option(opts, &opts_len, PCAPNG_IF_TSRESOL, &tsresol, sizeof(tsresol));
+    pcap_end_options(opts, &opts_len);
+    pcapng_append_block(p, PCAPNG_IDB, &idb, sizeof(idb), NULL, 0, opts, opts_len);
+
+    p->iface[r->type][slot] = p->num_ifaces;
+    return p->num_ifaces++;
+}
+
+// fill in the link-layer pseudo header, returns its length
+static size_t pcap_phdr(const pcap_record_t *r, uint8_t *out) {
+    if (r->type == RECORD_BLE) {
+        pcap_le_header_t le_header = {
+            .rf_channel = (r->freq - 2402) / 2,
+            .signal_power = r->rssi_db,
+            .noise_power = r->noise_db,
+            .aa_offenses = 0,
+            .ref_aa = 0,
+            .flags = pcap_htole16(LE_DEWHITENED | LE_SIGNAL_POWER_VALID | LE_NOISE_POWER_VALID),
+        };
+        memcpy(out, &le_header, sizeof(le_header));
+        return sizeof(le_header);
+    } else {
+        pcap_bredr_header_t bredr_header = {
+            .rf_channel = r->freq - 2402,
+            .signal_power = r->rssi_db,
+            .noise_power = r->noise_db,
+            .access_code_offenses = 0,
+            .payload_transport_rate = 0, // unknown transport, basic rate
+            .lap = pcap_htole32(r->lap),
+            .flags = pcap_htole16(BREDR_SIGNAL_POWER_VALID | BREDR_NOISE_POWER_VALID),
+        };
+        memcpy(out, &bredr_header, sizeof(bredr_header));
+        return sizeof(bredr_header);
+    }
+}
+
+// name of rotated file number index: foo.pcap -> foo_00001_20240102030405.pcap
+static char *pcap_file_name(const char *path, unsigned long index) {
+    const char *slash = strrchr(path, '/');
+    const char *dot = strrchr(slash ? slash : path, '.');
+    size_t stem = dot ? (size_t)(dot - path) : strlen(path);
+    char when[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    char *name;
+
+    localtime_r(&now, &tm);
+    strftime(when, sizeof(when), "%Y%m%d%H%M%S", &tm);
+    if (asprintf(&name, "%.*s_%05lu_%s%s", (int)stem, path, index, when, dot ? dot : "") < 0)
         return NULL;
-    p = malloc(sizeof(*p));
-    p->f = f;
+    return name;
+}
+
+// give back the preallocated space past what was actually written
+static void pcap_finish_file(pcap_t *p) {
+    off_t end;
+
+    pcap_flush(p);
+    if (p->fd < 0)
+        return;
+    if (p->rotating && p->rotate.max_bytes > 0 && (end = lseek(p->fd, 0, SEEK_CUR)) >= 0) {
+        // best effort, the capture itself is already on disk
+        if (ftruncate(p->fd, end) != 0)
+            perror("ftruncate");
+    }
+    close(p->fd);
+    p->fd = -1;
+}
+
+static int pcap_next_file(pcap_t *p) {
+    unsigned slot;
+    char *name = pcap_file_name(p->path, ++p->file_index);
+    int fd;
+
+    if (name == NULL)
+        return -1;
+    fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        free(name);
+        return -1;
+    }
+
+    // ring buffer mode: the file that falls off the end is deleted
+    if (p->rotate.max_files > 0) {
+        slot = p->file_index % p->rotate.max_files;
+        if (p->file_names[slot] != NULL) {
+            unlink(p->file_names[slot]);
+            free(p->file_names[slot]);
+        }
+        p->file_names[slot] = name;
+    } else {
+        free(name);
+    }
 
-    // write header
-    fwrite(&h, sizeof(h), 1, p->f);
+#ifdef __linux__
+    // reserve the blocks up front so the file does not fragment and the
+    // writer never waits on block allocation. KEEP_SIZE leaves the visible
+    // length alone, so a crash still leaves a readable capture.
+    if (p->rotate.max_bytes > 0)
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, p->rotate.max_bytes);
+#endif
+
+    p->fd = fd;
+    p->file_bytes = 0;
+    p->file_packets = 0;
+    p->file_start = pcap_now_us();
+    pcap_write_file_header(p);
+    return 0;
+}
+
+// start a new file once the current one holds a full share of the capture
+static void pcap_check_rotate(pcap_t *p) {
+    if (!p->rotating || p->fd < 0)
+        return;
+    if ((p->rotate.max_bytes > 0 && p->file_bytes >= p->rotate.max_bytes) ||
+            (p->rotate.max_packets > 0 && p->file_packets >= p->rotate.max_packets) ||
+            (p->rotate.max_seconds > 0 && pcap_now_us() - p->file_start >= p->rotate.max_seconds * 1000000lu)) {
+        pcap_finish_file(p);
+        if (pcap_next_file(p) != 0)
+            fprintf(stderr, "WARNING: unable to open next pcap file, capture stopped\n");
+    }
+}
+
+static long round_hz(float hz) {
+    return (long)(hz < 0.0f ? hz - 0.5f : hz + 0.5f);
+}
+
+static void pcap_write_record(pcap_t *p, const pcap_record_t *r) {
+    uint8_t phdr[sizeof(pcap_bredr_header_t)];
+    size_t phdr_len = pcap_phdr(r, phdr);
+    size_t rec_len;
+
+    pcap_check_rotate(p);
+    if (p->fd < 0 && !p->write_failed)
+        return;
+
+    if (p->format == PCAP_FORMAT_SPOOL) {
+        rec_len = sizeof(*r);
+        if (p->buf_len + rec_len > PCAP_BUFFER_SIZE)
+            pcap_flush(p);
+        pcap_append(p, r, rec_len);
+    } else if (p->format == PCAP_FORMAT_PCAPNG) {
+        uint8_t pkt[sizeof(phdr) + PCAP_MAX_PACKET];
+        uint8_t opts[PCAPNG_MAX_OPTIONS];
+        size_t opts_len = 0;
+        char comment[64];
+        uint64_t ts = (uint64_t)r->timestamp.tv_sec * 1000000000ull + (uint64_t)r->timestamp.tv_nsec;
+        pcapng_epb_t epb = {
+            .interface_id = pcapng_interface(p, r),
+            .ts_high = (uint32_t)(ts >> 32),
+            .ts_low = (uint32_t)ts,
+            .captured_len = phdr_len + r->len,
+            .orig_len = phdr_len + r->len,
+        };
+
+        memcpy(pkt, phdr, phdr_len);
+        memcpy(pkt + phdr_len, r->data, r->len);
+        // whole Hz, so the comment reads the same in every locale
+        snprintf(comment, sizeof(comment), "cfo_hz=%ld deviation_hz=%ld", round_hz(r->cfo), round_hz(r->deviation));
+        pcap_append_option(opts, &opts_len, PCAPNG_OPT_COMMENT, comment, strlen(comment));
+        pcap_end_options(opts, &opts_len);
+
+        rec_len = pcapng_append_block(p, PCAPNG_EPB, &epb, sizeof(epb), pkt, phdr_len + r->len, opts, opts_len);
+    } else {
+        // classic pcap carries a single link type: LE only
+        if (r->type != RECORD_BLE)
+            return;
+
+        pcaprec_hdr_t pcap_header = {
+            .ts_sec   = pcap_htole32((uint32_t)r->timestamp.tv_sec),
+            .ts_usec  = pcap_htole32((uint32_t)(r->timestamp.tv_nsec / 1000)),
+            .incl_len = pcap_htole32((uint32_t)(r->len + phdr_len)),
+            .orig_len = pcap_htole32((uint32_t)(r->len + phdr_len)),
+        };
+        rec_len = sizeof(pcap_header) + phdr_len + r->len;
+
+        if (p->buf_len + rec_len > PCAP_BUFFER_SIZE)
+            pcap_flush(p);
+
+        pcap_append(p, &pcap_header, sizeof(pcap_header));
+        pcap_append(p, phdr, phdr_len);
+        pcap_append(p, r->data, r->len);
+    }
+
+    ++p->file_packets;
+    __atomic_add_fetch(&p->stats.packets, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p->stats.bytes, rec_len, __ATOMIC_RELAXED);
+}
+
+static void *pcap_writer_thread(void *arg) {
+    pcap_t *p = (pcap_t *)arg;
+    pcap_record_t r;
+    struct timespec deadline;
+    unsigned n;
+
+    for (;;) {
+        n = 0;
+        while (mpsc_ring_pop(&p->ring, &r) == 0) {
+            pcap_write_record(p, &r);
+            ++n;
+        }
+
+        if (n > 0 && __atomic_load_n(&p->producers_waiting, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&p->mutex);
+            pthread_cond_broadcast(&p->space_cond);
+            pthread_mutex_unlock(&p->mutex);
+        }
+
+        // the ring just ran dry, so this is the end of a batch
+        if (p->buf_len > 0 && (p->is_fifo || pcap_now_us() - p->last_flush >= PCAP_FLUSH_INTERVAL_US))
+            pcap_flush(p);
+
+        pthread_mutex_lock(&p->mutex);
+        if (p->stopping && mpsc_ring_size(&p->ring) == 0) {
+            pthread_mutex_unlock(&p->mutex);
+            break;
+        }
+        // announce we are about to sleep, then look once more so a
+        // producer that pushed before seeing the flag is not missed
+        __atomic_store_n(&p->writer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (mpsc_ring_size(&p->ring) == 0 && !p->stopping) {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += PCAP_FLUSH_INTERVAL_US * 1000;
+            if (deadline.tv_nsec >= 1000000000l) {
+                deadline.tv_sec += deadline.tv_nsec / 1000000000l;
+                deadline.tv_nsec %= 1000000000l;
+            }
+            pthread_cond_timedwait(&p->data_cond, &p->mutex, &deadline);
+        }
+        __atomic_store_n(&p->writer_waiting, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&p->mutex);
+
+        // idle long enough: push out whatever is pending
+        if (p->buf_len > 0 && pcap_now_us() - p->last_flush >= PCAP_FLUSH_INTERVAL_US)
+            pcap_flush(p);
+
+        // time-based rotation must happen on a quiet channel too
+        pcap_check_rotate(p);
+    }
+
+    return NULL;
+}
+
+static int pcap_enqueue(pcap_t *p, const pcap_record_t *r) {
+    pcap_record_t evicted;
+    int blocked = 0;
+
+    while (mpsc_ring_push(&p->ring, r) != 0) {
+        switch (p->policy) {
+            case PCAP_POLICY_DROP_NEWEST:
+                __atomic_add_fetch(&p->stats.dropped_newest, 1, __ATOMIC_RELAXED);
+                return -1;
+
+            case PCAP_POLICY_DROP_OLDEST:
+                if (mpsc_ring_pop(&p->ring, &evicted) == 0)
+                    __atomic_add_fetch(&p->stats.dropped_oldest, 1, __ATOMIC_RELAXED);
+                break;
+
+            case PCAP_POLICY_BLOCK:
+            default:
+                if (!blocked++)
+                    __atomic_add_fetch(&p->stats.blocked, 1, __ATOMIC_RELAXED);
+                pthread_mutex_lock(&p->mutex);
+                __atomic_add_fetch(&p->producers_waiting, 1, __ATOMIC_SEQ_CST);
+                if (mpsc_ring_size(&p->ring) > p->ring.mask) {
+                    struct timespec deadline;
+                    clock_gettime(CLOCK_REALTIME, &deadline);
+                    deadline.tv_nsec += 10000000l;
+                    if (deadline.tv_nsec >= 1000000000l) {
+                        deadline.tv_sec += 1;
+                        deadline.tv_nsec -= 1000000000l;
+                    }
+                    pthread_cond_timedwait(&p->space_cond, &p->mutex, &deadline);
+                }
+                __atomic_sub_fetch(&p->producers_waiting, 1, __ATOMIC_SEQ_CST);
+                pthread_mutex_unlock(&p->mutex);
+                break;
+        }
+    }
+
+    if (__atomic_load_n(&p->writer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&p->mutex);
+        pthread_cond_signal(&p->data_cond);
+        pthread_mutex_unlock(&p->mutex);
+    }
+
+    return 0;
+}
+
+pcap_t *pcap_open(char *path, pcap_format_t format) {
+    return pcap_open_rotating(path, format, NULL);
+}
+
+pcap_t *pcap_open_rotating(char *path, pcap_format_t format, const pcap_rotate_t *rotate) {
+    pcap_t *p;
+    struct stat st;
+    int fd = -1;
+
+    // a FIFO is a single stream, there is nothing to rotate
+    if (rotate != NULL && stat(path, &st) == 0 && S_ISFIFO(st.st_mode))
+        return NULL;
+
+    if (rotate == NULL) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0)
+            return NULL;
+    }
+    if (posix_memalign((void **)&p, MPSC_RING_CACHE_LINE, sizeof(*p)) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->fd = fd;
+    p->format = format;
+    if (posix_memalign((void **)&p->buf, PCAP_BUFFER_ALIGN, PCAP_BUFFER_SIZE) != 0) {
+        if (fd >= 0)
+            close(fd);
+        free(p);
+        return NULL;
+    }
+
+    if (rotate != NULL) {
+        p->rotating = 1;
+        p->rotate = *rotate;
+        p->path = strdup(path);
+        if (p->rotate.max_files > 0)
+            p->file_names = calloc(p->rotate.max_files, sizeof(char *));
+        if (p->path == NULL || (p->rotate.max_files > 0 && p->file_names == NULL) || pcap_next_file(p) != 0) {
+            free(p->file_names);
+            free(p->path);
+            free(p->buf);
+            free(p);
+            return NULL;
+        }
+        pcap_flush(p);
+        return p;
+    }
+
+    // Wireshark reads a FIFO live, so every packet goes out immediately.
+    // regular files are batched and only hit the disk on size or time.
+    p->is_fifo = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+
+    pcap_write_file_header(p);
+    pcap_flush(p);
 
     return p;
 }
 
+int pcap_start_writer(pcap_t *p, pcap_policy_t policy, unsigned ring_size) {
+    if (p->has_writer)
+        return 0;
+    if (mpsc_ring_init(&p->ring, ring_size, sizeof(pcap_record_t)) != 0)
+        return -1;
+
+    p->policy = policy;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->data_cond, NULL);
+    pthread_cond_init(&p->space_cond, NULL);
+    if (pthread_create(&p->writer, NULL, pcap_writer_thread, p) != 0) {
+        mpsc_ring_destroy(&p->ring);
+        return -1;
+    }
+#ifdef __linux__
+    pthread_setname_np(p->writer, "pcap-writer");
+#endif
+    p->has_writer = 1;
+    return 0;
+}
+
 void pcap_close(pcap_t *p) {
-    fclose(p->f);
+    if (p->has_writer) {
+        // the writer drains the ring before it exits
+        pthread_mutex_lock(&p->mutex);
+        p->stopping = 1;
+        pthread_cond_signal(&p->data_cond);
+        pthread_mutex_unlock(&p->mutex);
+        pthread_join(p->writer, NULL);
+
+        mpsc_ring_destroy(&p->ring);
+        pthread_cond_destroy(&p->data_cond);
+        pthread_cond_destroy(&p->space_cond);
+        pthread_mutex_destroy(&p->mutex);
+    }
+    if (p->fd >= 0 || p->write_failed)
+        pcap_finish_file(p);
+    if (p->file_names != NULL) {
+        unsigned i;
+        for (i = 0; i < p->rotate.max_files; ++i)
+            free(p->file_names[i]);
+        free(p->file_names);
+    }
+    free(p->path);
+    free(p->buf);
     free(p);
 }
 
-// TODO timestamp
-void pcap_write_ble(pcap_t *p, ble_packet_t *b) {
-    pcap_le_header_t le_header = {
-        .rf_channel = (b->freq - 2402) / 2,
-        .signal_power = b->rssi_db,
-        .noise_power = b->noise_db,
-        .aa_offenses = 0,
-        .ref_aa = 0,
-        .flags = pcap_htole16(LE_DEWHITENED | LE_SIGNAL_POWER_VALID | LE_NOISE_POWER_VALID),
+static int pcap_submit(pcap_t *p, const pcap_record_t *r) {
+    if (p->has_writer)
+        return pcap_enqueue(p, r);
+
+    pcap_write_record(p, r);
+    if (p->is_fifo || pcap_now_us() - p->last_flush >= PCAP_FLUSH_INTERVAL_US)
+        pcap_flush(p);
+    return 0;
+}
+
+int pcap_write_ble(pcap_t *p, ble_packet_t *b) {
+    pcap_record_t r = {
+        .timestamp = b->timestamp,
+        .freq = b->freq,
+        .type = RECORD_BLE,
+        .rssi_db = b->rssi_db,
+        .noise_db = b->noise_db,
+        .len = b->len > PCAP_MAX_PACKET ? PCAP_MAX_PACKET : b->len,
+        .cfo = b->cfo,
+        .deviation = b->deviation,
     };
-    pcaprec_hdr_t pcap_header = {
-        .ts_sec   = pcap_htole32((uint32_t)b->timestamp.tv_sec),
-        .ts_usec  = pcap_htole32((uint32_t)(b->timestamp.tv_nsec / 1000)),
-        .incl_len = pcap_htole32((uint32_t)(b->len + sizeof(le_header))),
-        .orig_len = pcap_htole32((uint32_t)(b->len + sizeof(le_header))),
+    memcpy(r.data, b->data, r.len);
+    return pcap_submit(p, &r);
+}
+
+int pcap_write_br(pcap_t *p, br_packet_t *b) {
+    pcap_record_t r = {
+        .timestamp = b->timestamp,
+        .freq = b->freq,
+        .type = RECORD_BREDR,
+        .rssi_db = b->rssi_db,
+        .noise_db = b->noise_db,
+        .len = 0,
+        .lap = b->lap,
+        .cfo = b->cfo,
+        .deviation = b->deviation,
     };
-    fwrite(&pcap_header, sizeof(pcap_header), 1, p->f);
-    fwrite(&le_header, sizeof(le_header), 1, p->f);
-    fwrite(b->data, b->len, 1, p->f);
-    fflush(p->f);
+
+    // classic pcap has a single link type, don't bother queueing
+    if (p->format == PCAP_FORMAT_PCAP)
+        return 0;
+    return pcap_submit(p, &r);
+}
+
+void pcap_get_stats(pcap_t *p, pcap_stats_t *out) {
+    out->packets        = __atomic_load_n(&p->stats.packets, __ATOMIC_RELAXED);
+    out->bytes          = __atomic_load_n(&p->stats.bytes, __ATOMIC_RELAXED);
+    out->dropped_newest = __atomic_load_n(&p->stats.dropped_newest, __ATOMIC_RELAXED);
+    out->dropped_oldest = __atomic_load_n(&p->stats.dropped_oldest, __ATOMIC_RELAXED);
+    out->blocked        = __atomic_load_n(&p->stats.blocked, __ATOMIC_RELAXED);
+    out->lost_bytes     = __atomic_load_n(&p->stats.lost_bytes, __ATOMIC_RELAXED);
+}
+
+// packets written recently enough to still have a duplicate coming
+#define PCAP_MERGE_RECENT 64
+
+static int64_t pcap_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000ll + ts->tv_nsec;
+}
+
+static int pcap_same_packet(const pcap_record_t *a, const pcap_record_t *b) {
+    return a->freq == b->freq && a->type == b->type && a->len == b->len && a->lap == b->lap &&
+        memcmp(a->data, b->data, a->len) == 0;
+}
+
+int pcap_merge(pcap_t *p, char **spools, unsigned n) {
+    FILE **in = calloc(n, sizeof(*in));
+    pcap_record_t *head = calloc(n, sizeof(*head));
+    pcap_record_t *recent = calloc(PCAP_MERGE_RECENT, sizeof(*recent));
+    int *live = calloc(n, sizeof(*live));
+    unsigned num_recent = 0, next_recent = 0, i;
+    int ret = 0;
+
+    if (in == NULL || head == NULL || recent == NULL || live == NULL) {
+        ret = -1;
+        goto out;
+    }
+
+    for (i = 0; i < n; ++i) {
+        in[i] = fopen(spools[i], "rb");
+        if (in[i] == NULL) {
+            ret = -1;
+            goto out;
+        }
+        live[i] = fread(&head[i], sizeof(head[i]), 1, in[i]) == 1;
+    }
+
+    // n is the number of shards, a linear scan beats a heap
+    for (;;) {
+        int best = -1;
+        for (i = 0; i < n; ++i) {
+            if (!live[i])
+                continue;
+            if (best < 0 || head[i].timestamp.tv_sec < head[best].timestamp.tv_sec ||
+                    (head[i].timestamp.tv_sec == head[best].timestamp.tv_sec &&
+                     head[i].timestamp.tv_nsec < head[best].timestamp.tv_nsec))
+                best = i;
+        }
+        if (best < 0)
+            break;
+
+        // shards overlap, so the same burst may have been decoded twice, a
+        // sample or two apart, and other channels' packets can sort between
+        // the copies. look back over everything written within the window
+        int64_t t = pcap_ns(&head[best].timestamp);
+        int dup = 0;
+        for (i = 1; i <= num_recent && !dup; ++i) {
+            const pcap_record_t *r = &recent[(next_recent + PCAP_MERGE_RECENT - i) % PCAP_MERGE_RECENT];
+            if (t - pcap_ns(&r->timestamp) > PCAP_MERGE_WINDOW_NS)
+                break;
+            dup = pcap_same_packet(r, &head[best]);
+        }
+        if (!dup) {
+            pcap_submit(p, &head[best]);
+            recent[next_recent] = head[best];
+            next_recent = (next_recent + 1) % PCAP_MERGE_RECENT;
+            if (num_recent < PCAP_MERGE_RECENT)
+                ++num_recent;
+        }
+        live[best] = fread(&head[best], sizeof(head[best]), 1, in[best]) == 1;
+    }
+
+out:
+    if (in != NULL)
+        for (i = 0; i < n; ++i)
+            if (in[i] != NULL)
+                fclose(in[i]);
+    free(in);
+    free(head);
+    free(recent);
+    free(live);
+    return ret;
 }
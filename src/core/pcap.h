@@ -9,8 +9,60 @@
 
 typedef struct _pcap_t pcap_t;
 
-pcap_t *pcap_open(char *path);
+// what pcap_write_ble does when the writer thread has fallen behind
+typedef enum {
+    PCAP_POLICY_BLOCK,          // wait for the writer
+    PCAP_POLICY_DROP_NEWEST,    // discard the packet being written
+    PCAP_POLICY_DROP_OLDEST,    // discard the oldest queued packet
+} pcap_policy_t;
+
+typedef enum {
+    PCAP_FORMAT_PCAP,           // classic pcap, BLE only, microsecond timestamps
+    PCAP_FORMAT_PCAPNG,         // one interface per channel, nanosecond timestamps, BLE and BR/EDR
+    PCAP_FORMAT_SPOOL,          // internal, unformatted records for pcap_merge
+} pcap_format_t;
+
+// start a new file when any nonzero limit is reached
+typedef struct _pcap_rotate_t {
+    unsigned long max_bytes;    // also preallocated for each file
+    unsigned long max_seconds;
+    unsigned long max_packets;
+    unsigned max_files;         // keep only the newest max_files, 0 keeps all
+} pcap_rotate_t;
+
+typedef struct _pcap_stats_t {
+    unsigned long packets;
+    unsigned long bytes;
+    unsigned long dropped_newest;
+    unsigned long dropped_oldest;
+    unsigned long blocked;
+    unsigned long lost_bytes;   // not written after a write error stopped the capture
+} pcap_stats_t;
+
+pcap_t *pcap_open(char *path, pcap_format_t format);
+// write path_00001_<time>.ext, path_00002_<time>.ext, ... (not for FIFOs)
+pcap_t *pcap_open_rotating(char *path, pcap_format_t format, const pcap_rotate_t *rotate);
 void pcap_close(pcap_t *p);
-void pcap_write_ble(pcap_t *p, ble_packet_t *b);
+// returns -1 if the packet was dropped by PCAP_POLICY_DROP_NEWEST
+int pcap_write_ble(pcap_t *p, ble_packet_t *b);
+// BR/EDR packets are silently skipped in classic pcap
+int pcap_write_br(pcap_t *p, br_packet_t *b);
+// synchronous mode only; the writer thread flushes on its own
+void pcap_flush(pcap_t *p);
+
+// move file I/O to a dedicated thread fed by a ring of ring_size packets.
+// until this is called, pcap_write_ble writes synchronously.
+int pcap_start_writer(pcap_t *p, pcap_policy_t policy, unsigned ring_size);
+void pcap_get_stats(pcap_t *p, pcap_stats_t *out);
+
+// shards keep bursts up to this far outside their own range, since two
+// shards' AGCs can start the same burst a sample or two apart. pcap_merge
+// takes the same packet on the same channel within this much of another
+// as one packet
+#define PCAP_MERGE_WINDOW_NS 5000
+
+// write the packets from n spool files to p in timestamp order, dropping
+// duplicates. each spool must already be in timestamp order.
+int pcap_merge(pcap_t *p, char **spools, unsigned n);
 
 #endif
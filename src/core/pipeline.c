@@ -0,0 +1,152 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "trace.h"
+
+int pipe_init(pipe_t *p, unsigned depth, size_t slot_size, unsigned consumers) {
+    memset(p, 0, sizeof(*p));
+    if (depth == 0 || consumers == 0)
+        return -1;
+
+    p->depth = depth;
+    p->slot_size = (slot_size + PIPE_CACHE_LINE - 1) & ~(size_t)(PIPE_CACHE_LINE - 1);
+    p->consumers = consumers;
+    if (posix_memalign((void **)&p->slots, PIPE_CACHE_LINE, depth * p->slot_size) != 0)
+        return -1;
+    if (posix_memalign((void **)&p->tails, PIPE_CACHE_LINE, consumers * sizeof(*p->tails)) != 0) {
+        free(p->slots);
+        p->slots = NULL;
+        return -1;
+    }
+    memset(p->tails, 0, consumers * sizeof(*p->tails));
+    // fault the slots in now, not in the middle of the stream
+    memset(p->slots, 0, depth * p->slot_size);
+    futex_init(&p->published);
+    futex_init(&p->released);
+    return 0;
+}
+
+void pipe_destroy(pipe_t *p) {
+    futex_destroy(&p->published);
+    futex_destroy(&p->released);
+    free(p->slots);
+    free(p->tails);
+    p->slots = NULL;
+    p->tails = NULL;
+}
+
+static inline void *slot(pipe_t *p, size_t pos) {
+    return p->slots + (pos % p->depth) * p->slot_size;
+}
+
+static size_t slowest_tail(pipe_t *p) {
+    size_t min = __atomic_load_n(&p->tails[0].pos, __ATOMIC_SEQ_CST);
+    unsigned i;
+    for (i = 1; i < p->consumers; ++i) {
+        size_t pos = __atomic_load_n(&p->tails[i].pos, __ATOMIC_SEQ_CST);
+        if (pos < min)
+            min = pos;
+    }
+    return min;
+}
+
+void *pipe_acquire(pipe_t *p) {
+    size_t head = p->head;
+
+    while (head - p->min_tail >= p->depth) {
+        uint32_t seq;
+        if (__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE))
+            return NULL;
+        p->min_tail = slowest_tail(p);
+        if (head - p->min_tail < p->depth)
+            break;
+
+        seq = futex_value(&p->released);
+        __atomic_store_n(&p->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        // the slowest consumer may have moved before the flag was visible
+        p->min_tail = slowest_tail(p);
+        if (head - p->min_tail >= p->depth && !__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE)) {
+            TRACE_BEGIN(wait);
+            __atomic_add_fetch(&p->producer_waits, 1, __ATOMIC_RELAXED);
+            futex_wait(&p->released, seq);
+            TRACE_END(wait, "pipe_acquire wait");
+        }
+        __atomic_store_n(&p->producer_waiting, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    if (head - p->min_tail + 1 > p->high_water)
+        __atomic_store_n(&p->high_water, head - p->min_tail + 1, __ATOMIC_RELAXED);
+    return slot(p, head);
+}
+
+void pipe_publish(pipe_t *p) {
+    // seq_cst against pipe_next: either the consumer sees the new head or
+    // we see it waiting
+    __atomic_store_n(&p->head, p->head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->consumers_waiting, __ATOMIC_SEQ_CST))
+        futex_wake(&p->published);
+}
+
+void pipe_finish(pipe_t *p) {
+    __atomic_store_n(&p->finished, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&p->published);
+}
+
+void *pipe_next(pipe_t *p, unsigned consumer) {
+    size_t pos = p->tails[consumer].pos;
+
+    for (;;) {
+        uint32_t seq;
+        int finished;
+        if (__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE))
+            return NULL;
+        // finished before head: once it is set, head is final
+        finished = __atomic_load_n(&p->finished, __ATOMIC_ACQUIRE);
+        if (pos != __atomic_load_n(&p->head, __ATOMIC_ACQUIRE))
+            return slot(p, pos);
+        if (finished)
+            return NULL;
+
+        // a count rather than a flag, there can be several of us asleep
+        seq = futex_value(&p->published);
+        __atomic_add_fetch(&p->consumers_waiting, 1, __ATOMIC_SEQ_CST);
+        if (pos == __atomic_load_n(&p->head, __ATOMIC_SEQ_CST) &&
+                !__atomic_load_n(&p->finished, __ATOMIC_ACQUIRE) &&
+                !__atomic_load_n(&p->shutdown, __ATOMIC_ACQUIRE)) {
+            TRACE_BEGIN(wait);
+            __atomic_add_fetch(&p->consumer_waits, 1, __ATOMIC_RELAXED);
+            futex_wait(&p->published, seq);
+            TRACE_END(wait, "pipe_next wait");
+        }
+        __atomic_sub_fetch(&p->consumers_waiting, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void pipe_release(pipe_t *p, unsigned consumer) {
+    __atomic_store_n(&p->tails[consumer].pos, p->tails[consumer].pos + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->producer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&p->producer_waiting, 0, __ATOMIC_SEQ_CST))
+        futex_wake(&p->released);
+}
+
+void pipe_shutdown(pipe_t *p) {
+    __atomic_store_n(&p->shutdown, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&p->published);
+    futex_wake(&p->released);
+}
+
+void pipe_get_stats(pipe_t *p, pipe_stats_t *stats) {
+    stats->depth = p->depth;
+    stats->high_water = __atomic_load_n(&p->high_water, __ATOMIC_RELAXED);
+    // head first, so it can't be behind the tails read after it
+    stats->in_flight = __atomic_load_n(&p->head, __ATOMIC_SEQ_CST) - slowest_tail(p);
+    stats->producer_waits = __atomic_load_n(&p->producer_waits, __ATOMIC_RELAXED);
+    stats->consumer_waits = __atomic_load_n(&p->consumer_waits, __ATOMIC_RELAXED);
+}
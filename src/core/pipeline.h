@@ -0,0 +1,92 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "futex.h"
+
+#define PIPE_CACHE_LINE 64
+
+// bounded ring of fixed-size buffers joining two pipeline stages
+//
+// the buffers live in the ring. the upstream stage acquires the next free
+// one, fills it and publishes it. each downstream consumer walks the ring
+// with its own cursor and releases a buffer when done with it; a buffer is
+// free again once every consumer has released it. with one consumer this
+// is a queue, with several every consumer sees every buffer (the AGC
+// threads each take their channel out of the same FFT output).
+//
+// depth is how far upstream may run ahead of the slowest consumer. nobody
+// takes a lock, a stage only sleeps on a futex when it has to wait.
+//
+// a stage thread looks like:
+//
+//     while ((in = pipe_next(up, me)) != NULL) {
+//         out = pipe_acquire(down);
+//         ...
+//         pipe_release(up, me);
+//         pipe_publish(down);
+//     }
+//     pipe_finish(down);
+
+typedef struct _pipe_cursor_t {
+    size_t pos __attribute__((aligned(PIPE_CACHE_LINE)));
+} pipe_cursor_t;
+
+typedef struct _pipe_stats_t {
+    unsigned depth;
+    unsigned high_water;          // most buffers ever in flight
+    unsigned in_flight;           // published, not yet released by everyone
+    unsigned long producer_waits; // upstream found every buffer in use
+    unsigned long consumer_waits; // a consumer found nothing published
+} pipe_stats_t;
+
+typedef struct _pipe_t {
+    // producer's line
+    size_t head __attribute__((aligned(PIPE_CACHE_LINE))); // buffers published
+    size_t min_tail; // producer's last look at the slowest cursor
+    unsigned high_water;
+    unsigned long producer_waits;
+    // blocking, only written when someone sleeps or at the end
+    futex_t published __attribute__((aligned(PIPE_CACHE_LINE)));
+    futex_t released;
+    int consumers_waiting;
+    int producer_waiting;
+    int finished; // no more will be published
+    int shutdown; // stop now, whatever is in flight
+    unsigned long consumer_waits;
+    // read-only after init
+    size_t depth __attribute__((aligned(PIPE_CACHE_LINE)));
+    size_t slot_size;
+    unsigned consumers;
+    uint8_t *slots;
+    pipe_cursor_t *tails; // one per consumer
+} pipe_t;
+
+// depth buffers of slot_size bytes, cache line aligned
+int pipe_init(pipe_t *p, unsigned depth, size_t slot_size, unsigned consumers);
+void pipe_destroy(pipe_t *p);
+
+// upstream: the buffer to fill next, waiting while all of them are in use.
+// NULL once the pipe is shut down
+void *pipe_acquire(pipe_t *p);
+void pipe_publish(pipe_t *p);
+// end of stream: consumers get NULL after the last published buffer
+void pipe_finish(pipe_t *p);
+
+// downstream: the next buffer for this consumer, waiting until there is
+// one. NULL at end of stream or once the pipe is shut down
+void *pipe_next(pipe_t *p, unsigned consumer);
+void pipe_release(pipe_t *p, unsigned consumer);
+
+// wakes every stage waiting on the pipe, everything fails from here on
+void pipe_shutdown(pipe_t *p);
+
+void pipe_get_stats(pipe_t *p, pipe_stats_t *stats);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#include "placement.h"
+
+#define PLACEMENT_MAX_NODES 64
+
+int parse_cpu_list(const char *list, unsigned *cpus, unsigned max) {
+    const char *p = list;
+    unsigned num = 0;
+
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        unsigned long lo, hi, i;
+
+        if (!isdigit((unsigned char)*p))
+            return -1;
+        lo = hi = strtoul(p, &end, 10);
+        if (*end == '-') {
+            if (!isdigit((unsigned char)end[1]))
+                return -1;
+            hi = strtoul(end + 1, &end, 10);
+        }
+        if (hi < lo || hi >= PLACEMENT_MAX_CPUS)
+            return -1;
+        for (i = lo; i <= hi; ++i) {
+            if (num == max)
+                return -1;
+            cpus[num++] = i;
+        }
+
+        p = end;
+        if (*p == ',')
+            ++p;
+        else if (*p != '\0' && *p != '\n')
+            return -1;
+    }
+    return num > 0 ? (int)num : -1;
+}
+
+#ifdef __linux__
+
+static int read_cpu_list(const char *path, unsigned *cpus, unsigned max) {
+    char buf[4096];
+    FILE *f = fopen(path, "r");
+    int num = -1;
+
+    if (f == NULL)
+        return -1;
+    if (fgets(buf, sizeof(buf), f) != NULL)
+        num = parse_cpu_list(buf, cpus, max);
+    fclose(f);
+    return num;
+}
+
+// NUMA node of every cpu from sysfs, -1 where there's no telling. returns
+// how many nodes have cpus
+static unsigned cpu_nodes(int *node_of) {
+    static unsigned cpus[PLACEMENT_MAX_CPUS];
+    unsigned nodes = 0;
+    int node, num, i;
+
+    for (i = 0; i < PLACEMENT_MAX_CPUS; ++i)
+        node_of[i] = -1;
+    for (node = 0; node < PLACEMENT_MAX_NODES; ++node) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        num = read_cpu_list(path, cpus, PLACEMENT_MAX_CPUS);
+        if (num <= 0)
+            continue;
+        for (i = 0; i < num; ++i)
+            node_of[cpus[i]] = node;
+        ++nodes;
+    }
+    return nodes;
+}
+
+// first hardware thread of its core. SMT siblings share execution units,
+// so they're the last choice for a busy stage
+static int primary_thread(unsigned cpu) {
+    unsigned siblings[64];
+    char path[96];
+    int num, i;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+    num = read_cpu_list(path, siblings, 64);
+    for (i = 0; i < num; ++i)
+        if (siblings[i] < cpu)
+            return 0;
+    return 1;
+}
+
+int placement_init(placement_t *pl, placement_mode_t mode, const unsigned *cpus, unsigned num) {
+    static int node_of[PLACEMENT_MAX_CPUS];
+    unsigned per_node[PLACEMENT_MAX_NODES] = { 0 };
+    cpu_set_t allowed;
+    unsigned i, pass;
+    int best = 0;
+
+    memset(pl, 0, sizeof(*pl));
+    pl->mode = mode;
+    pl->node = -1;
+    if (mode == PLACEMENT_NONE)
+        return 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return -1;
+    pl->num_nodes = cpu_nodes(node_of);
+
+    if (mode == PLACEMENT_LIST) {
+        for (i = 0; i < num; ++i) {
+            if (cpus[i] >= CPU_SETSIZE || !CPU_ISSET(cpus[i], &allowed))
+                return -1;
+            pl->cpus[pl->num_cpus++] = cpus[i];
+        }
+        pl->node = node_of[pl->cpus[0]];
+        for (i = 1; i < pl->num_cpus; ++i)
+            if (node_of[pl->cpus[i]] != pl->node)
+                pl->node = -1;
+        return 0;
+    }
+
+    // auto: the node we may use most of, so the buffers handed from stage
+    // to stage never cross the interconnect
+    for (i = 0; i < CPU_SETSIZE && i < PLACEMENT_MAX_CPUS; ++i)
+        if (CPU_ISSET(i, &allowed) && node_of[i] >= 0)
+            ++per_node[node_of[i]];
+    for (i = 1; i < PLACEMENT_MAX_NODES; ++i)
+        if (per_node[i] > per_node[best])
+            best = i;
+    if (per_node[best] > 0)
+        pl->node = best;
+
+    // a core each before doubling up on hyperthreads
+    for (pass = 0; pass < 2; ++pass) {
+        for (i = 0; i < CPU_SETSIZE && i < PLACEMENT_MAX_CPUS; ++i) {
+            if (!CPU_ISSET(i, &allowed) || (pl->node >= 0 && node_of[i] != pl->node))
+                continue;
+            if (primary_thread(i) == (pass == 0))
+                pl->cpus[pl->num_cpus++] = i;
+        }
+    }
+    return pl->num_cpus > 0 ? 0 : -1;
+}
+
+void placement_bind(placement_t *pl) {
+    unsigned long nodemask = 0;
+    cpu_set_t set;
+    unsigned i;
+
+    if (pl->mode == PLACEMENT_NONE)
+        return;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < pl->num_cpus; ++i)
+        CPU_SET(pl->cpus[i], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    // first touch from the right cpus mostly does this already, but the
+    // preference also covers pages faulted in by threads left unpinned
+    if (pl->num_nodes > 1 && pl->node >= 0) {
+        nodemask = 1ul << pl->node;
+        pl->memory_bound = syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, 8 * sizeof(nodemask) + 1) == 0;
+    }
+}
+
+int placement_pin(placement_t *pl, pthread_t thread, const char *name) {
+    placement_entry_t *e;
+    cpu_set_t set;
+    int cpu;
+
+    if (pl->mode == PLACEMENT_NONE || pl->num_cpus == 0)
+        return -1;
+
+    cpu = pl->cpus[pl->next++ % pl->num_cpus];
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+        cpu = -1;
+
+    e = realloc(pl->threads, (pl->num_threads + 1) * sizeof(*pl->threads));
+    if (e != NULL) {
+        pl->threads = e;
+        e = &pl->threads[pl->num_threads++];
+        snprintf(e->name, sizeof(e->name), "%s", name);
+        e->cpu = cpu;
+    }
+    return cpu;
+}
+
+#else
+
+// no thread affinity on macOS
+int placement_init(placement_t *pl, placement_mode_t mode, const unsigned *cpus, unsigned num) {
+    memset(pl, 0, sizeof(*pl));
+    pl->node = -1;
+    return mode == PLACEMENT_NONE ? 0 : -1;
+}
+
+void placement_bind(placement_t *pl) {
+}
+
+int placement_pin(placement_t *pl, pthread_t thread, const char *name) {
+    return -1;
+}
+
+#endif
+
+void placement_free(placement_t *pl) {
+    free(pl->threads);
+    pl->threads = NULL;
+    pl->num_threads = 0;
+}
+
+void placement_print(placement_t *pl, FILE *out) {
+    unsigned i;
+
+    if (pl->mode == PLACEMENT_NONE)
+        return;
+
+    fprintf(out, "placement: %s, %u cpus", pl->mode == PLACEMENT_AUTO ? "auto" : "list", pl->num_cpus);
+    if (pl->node >= 0)
+        fprintf(out, " on node %d%s", pl->node, pl->memory_bound ? ", memory node-local" : "");
+    else if (pl->num_nodes > 1)
+        fprintf(out, " across nodes");
+    fprintf(out, "\n");
+
+    for (i = 0; i < pl->num_threads; ++i) {
+        if (pl->threads[i].cpu >= 0)
+            fprintf(out, "%s%s %d", i % 6 == 0 ? "    " : ", ", pl->threads[i].name, pl->threads[i].cpu);
+        else
+            fprintf(out, "%s%s unpinned", i % 6 == 0 ? "    " : ", ", pl->threads[i].name);
+        if (i % 6 == 5 || i == pl->num_threads - 1)
+            fprintf(out, "\n");
+    }
+}
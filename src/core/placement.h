@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define PLACEMENT_MAX_CPUS 1024
+
+// --cpus: where the pipeline threads run
+typedef enum {
+    PLACEMENT_NONE, // leave it to the scheduler
+    PLACEMENT_LIST, // the cpus given, in order
+    PLACEMENT_AUTO, // one NUMA node, a core per stage before sharing any
+} placement_mode_t;
+
+typedef struct _placement_entry_t {
+    char name[16];
+    int cpu;
+} placement_entry_t;
+
+typedef struct _placement_t {
+    placement_mode_t mode;
+    unsigned cpus[PLACEMENT_MAX_CPUS]; // threads are pinned round robin
+    unsigned num_cpus;
+    int node;           // NUMA node every cpu is on, -1 if mixed or unknown
+    unsigned num_nodes; // nodes with cpus on this machine
+    int memory_bound;   // allocations prefer that node
+    unsigned next;
+    placement_entry_t *threads; // what went where, for placement_print
+    unsigned num_threads;
+} placement_t;
+
+// "0-3,8,10-11" into cpus, returns how many or -1 if it doesn't parse
+int parse_cpu_list(const char *list, unsigned *cpus, unsigned max);
+
+// work out the cpus for mode against what this process may run on. for
+// PLACEMENT_LIST those are cpus[0..num). returns -1 if none are usable
+int placement_init(placement_t *pl, placement_mode_t mode, const unsigned *cpus, unsigned num);
+void placement_free(placement_t *pl);
+
+// keep the calling thread, and the memory it faults in from now on, on the
+// chosen cpus and node. call before allocating the big buffers so they are
+// first touched node-locally. threads created afterwards inherit both
+void placement_bind(placement_t *pl);
+
+// pin a thread to the next cpu. returns the cpu, or -1 if pinning failed
+int placement_pin(placement_t *pl, pthread_t thread, const char *name);
+
+void placement_print(placement_t *pl, FILE *out);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "realtime.h"
+
+// CAP_IPC_LOCK lifts RLIMIT_MEMLOCK
+static int can_lock_unlimited(void) {
+    int can = 0;
+#ifdef __linux__
+    char line[128];
+    unsigned long long caps;
+    FILE *f = fopen("/proc/self/status", "r");
+
+    if (f == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+        if (sscanf(line, "CapEff: %llx", &caps) == 1)
+            can = (caps >> 14) & 1;
+    fclose(f);
+#endif
+    return can;
+}
+
+int rt_lock_memory(void) {
+    struct rlimit unlimited = { RLIM_INFINITY, RLIM_INFINITY }, rl;
+    int flags = MCL_CURRENT, r;
+
+    // with a finite RLIMIT_MEMLOCK, MCL_FUTURE turns running into the limit
+    // into failed allocations later on. only lock what's there now then
+    if (can_lock_unlimited() || setrlimit(RLIMIT_MEMLOCK, &unlimited) == 0 ||
+            (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur == RLIM_INFINITY))
+        flags |= MCL_FUTURE;
+
+#ifdef MCL_ONFAULT
+    // locking everything up front would also fault in every thread's
+    // whole stack, lock pages as they are touched instead
+    r = mlockall(flags | MCL_ONFAULT);
+    if (r != 0 && errno == EINVAL) // kernel older than 4.4
+        r = mlockall(flags);
+#else
+    r = mlockall(flags);
+#endif
+
+    if (r != 0)
+        fprintf(stderr, "realtime: unable to lock memory: %s\n", strerror(errno));
+    else if (flags & MCL_FUTURE)
+        fprintf(stderr, "realtime: memory locked\n");
+    else
+        fprintf(stderr, "realtime: memory allocated so far locked, RLIMIT_MEMLOCK is too low for the rest\n");
+    return r;
+}
+
+int rt_set_thread(pthread_t thread, int priority, const char *name) {
+    struct sched_param param = { .sched_priority = priority };
+    int r = pthread_setschedparam(thread, SCHED_FIFO, &param);
+
+    if (r == 0)
+        fprintf(stderr, "realtime: %s running SCHED_FIFO priority %d\n", name, priority);
+    else
+        fprintf(stderr, "realtime: unable to run %s SCHED_FIFO: %s\n", name, strerror(r));
+    return r == 0 ? 0 : -1;
+}
+
+int rt_set_self(int priority, const char *name) {
+    return rt_set_thread(pthread_self(), priority, name);
+}
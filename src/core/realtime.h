@@ -0,0 +1,28 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __REALTIME_H__
+#define __REALTIME_H__
+
+#include <pthread.h>
+
+// --rt: the ingest path (SDR receive thread or spewer) runs SCHED_FIFO at
+// the given priority and the channelizer one below it, so neither waits on
+// a normal process. memory is locked so a page fault can't stall them
+// either. each step says on stderr whether it worked, lacking the
+// privilege is not fatal
+#define RT_DEFAULT_PRIORITY 50
+
+// mlockall. pages are locked as they fault in where the kernel can, so
+// everything the hot path uses must be pre-faulted: the sample pool and
+// the pipeline rings are. without MCL_FUTURE (a finite RLIMIT_MEMLOCK)
+// only what is mapped already is locked, so call it once the pipeline and
+// its threads are up
+int rt_lock_memory(void);
+
+int rt_set_thread(pthread_t thread, int priority, const char *name);
+// for threads created by SDR libraries, from inside their callbacks
+int rt_set_self(int priority, const char *name);
+
+#endif
@@ -8,16 +8,68 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "options.h"
 
 typedef struct _sample_buf_t {
     unsigned num;
     unsigned sample_size;
-    int8_t samples[];
+    unsigned pool_index; // 0 if not from the sample pool, else index + 1
+    struct timespec timestamp; // arrival of the last sample, set by push_samples
+    int8_t *samples; // points at data, or into a memory-mapped input file
+    int8_t data[];
 } sample_buf_t;
 
+// buffer with room for bytes of samples
+sample_buf_t *sample_buf_alloc(size_t bytes);
+// zero-copy view of samples owned by someone else
+sample_buf_t *sample_buf_view(int8_t *samples);
+// releases any kind of sample buffer, pooled ones go back to the pool
+void sample_buf_free(sample_buf_t *buf);
+
+// SDR receive callbacks take their buffers from a fixed pool, allocated and
+// faulted in up front (on huge pages when the system has them), so they
+// never call into the allocator and memory use is bounded. get and free are
+// lock-free and safe from any thread. the pool holds SAMPLE_POOL_SECONDS of
+// samples, so the channelizer can fall that far behind before anything is
+// dropped, but never more than SAMPLE_POOL_MEMORY.
+#define SAMPLE_POOL_SECONDS 1.0
+#define SAMPLE_POOL_MEMORY (256u << 20)
+
+typedef struct _sample_pool_stats_t {
+    unsigned count;          // buffers in the pool
+    size_t bytes;            // room for samples in each
+    unsigned in_use;         // handed out and not yet freed
+    unsigned high_water;     // most ever in use at once
+    unsigned long exhausted; // sample_pool_get calls that came back empty
+    unsigned long oversized; // requests bigger than a buffer, a sizing bug
+    int hugepages;           // backed by explicit huge pages
+} sample_pool_stats_t;
+
+// how many buffers of bytes each hold SAMPLE_POOL_SECONDS of ci8 samples at
+// samp_rate, capped at SAMPLE_POOL_MEMORY
+unsigned sample_pool_count(size_t bytes, double samp_rate);
+// count buffers of bytes each. count 0 fits as many as SAMPLE_POOL_MEMORY
+// allows. returns 0 on success, -1 if already initialized or out of memory
+int sample_pool_init(size_t bytes, unsigned count);
+// NULL if every buffer is in use or bytes is too big, the caller drops the
+// samples. the two are counted apart: too big means the pool was sized wrong
+sample_buf_t *sample_pool_get(size_t bytes);
+void sample_pool_get_stats(sample_pool_stats_t *stats);
+// every buffer must have been freed
+void sample_pool_destroy(void);
+
+// why samples were lost, counted separately in the metrics
+typedef enum {
+    DROP_POOL_EXHAUSTED, // no sample buffer free to receive into
+    DROP_QUEUE_FULL,     // the channelizer fell behind
+    DROP_REASONS,
+} drop_reason_t;
+
 void push_samples(sample_buf_t *buf);
+// num samples were lost before they could be pushed
+void drop_samples(unsigned num, drop_reason_t why);
 
 typedef struct sdr_dev sdr_dev_t;
 
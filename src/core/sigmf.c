@@ -0,0 +1,419 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sigmf.h"
+
+#define SIGMF_DATA_EXT ".sigmf-data"
+#define SIGMF_META_EXT ".sigmf-meta"
+
+// drops less than this far apart share one annotation
+#define DROP_MERGE_SECONDS 1.0
+
+typedef struct _sigmf_capture_t {
+    unsigned long sample_start;
+    struct timespec datetime; // zero if unknown
+} sigmf_capture_t;
+
+typedef struct _sigmf_annotation_t {
+    unsigned long sample_start;
+    unsigned long sample_count; // span of merged drops, 0 for a single one
+    unsigned long dropped;
+} sigmf_annotation_t;
+
+struct _sigmf_writer_t {
+    FILE *data;
+    char *data_path;
+    char *meta_path;
+    double sample_rate;
+    double frequency;
+    unsigned sample_size;
+    unsigned long samples;
+
+    sigmf_capture_t *captures;
+    unsigned num_captures;
+    sigmf_annotation_t *annotations;
+    unsigned num_annotations;
+    int new_capture; // next write starts a new capture segment
+};
+
+static int ends_with(const char *s, const char *suffix) {
+    size_t len = strlen(s), suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+char *sigmf_meta_path(const char *data_path) {
+    char *meta;
+    size_t len = strlen(data_path);
+
+    if (ends_with(data_path, SIGMF_DATA_EXT))
+        len -= strlen(SIGMF_DATA_EXT);
+    if (asprintf(&meta, "%.*s%s", (int)len, data_path, SIGMF_META_EXT) < 0)
+        return NULL;
+    return meta;
+}
+
+const char *sigmf_datatype(unsigned sample_size) {
+    switch (sample_size) {
+        case 2: return "ci8";
+        case 4: return "ci16_le";
+        case 8: return "cf32_le";
+        default: return NULL;
+    }
+}
+
+static void write_datetime(FILE *out, const struct timespec *ts) {
+    struct tm tm;
+    char buf[32];
+
+    gmtime_r(&ts->tv_sec, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    fprintf(out, "%s.%09ldZ", buf, ts->tv_nsec);
+}
+
+// file names may hold anything but NUL, so escape what JSON can't carry
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        switch (c) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\t': fputs("\\t", out); break;
+            default:
+                if (c < 0x20)
+                    fprintf(out, "\\u%04x", c);
+                else
+                    fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// written once the recording is closed, and renamed into place so a reader
+// never sees half a file
+static int write_meta(sigmf_writer_t *w) {
+    const char *datatype = sigmf_datatype(w->sample_size);
+    const char *slash = strrchr(w->data_path, '/');
+    char *tmp;
+    FILE *out;
+    unsigned i;
+
+    if (asprintf(&tmp, "%s.tmp", w->meta_path) < 0)
+        return -1;
+    out = fopen(tmp, "w");
+    if (out == NULL) {
+        free(tmp);
+        return -1;
+    }
+
+    fprintf(out, "{\n    \"global\": {\n");
+    fprintf(out, "        \"core:datatype\": \"%s\",\n", datatype ? datatype : "ci8");
+    fprintf(out, "        \"core:sample_rate\": %.0f,\n", w->sample_rate);
+    fprintf(out, "        \"core:version\": \"1.0.0\",\n");
+    fprintf(out, "        \"core:recorder\": \"ice9-bluetooth\"");
+    if (!ends_with(w->data_path, SIGMF_DATA_EXT)) {
+        fprintf(out, ",\n        \"core:dataset\": ");
+        write_json_string(out, slash ? slash + 1 : w->data_path);
+    }
+    fprintf(out, "\n    },\n    \"captures\": [");
+    for (i = 0; i < w->num_captures; ++i) {
+        fprintf(out, "%s\n        {\n", i ? "," : "");
+        fprintf(out, "            \"core:sample_start\": %lu,\n", w->captures[i].sample_start);
+        fprintf(out, "            \"core:frequency\": %.0f", w->frequency);
+        if (w->captures[i].datetime.tv_sec != 0) {
+            fprintf(out, ",\n            \"core:datetime\": \"");
+            write_datetime(out, &w->captures[i].datetime);
+            fprintf(out, "\"");
+        }
+        fprintf(out, "\n        }");
+    }
+    fprintf(out, "\n    ],\n    \"annotations\": [");
+    for (i = 0; i < w->num_annotations; ++i) {
+        fprintf(out, "%s\n        {\n", i ? "," : "");
+        fprintf(out, "            \"core:sample_start\": %lu,\n", w->annotations[i].sample_start);
+        if (w->annotations[i].sample_count > 0)
+            fprintf(out, "            \"core:sample_count\": %lu,\n", w->annotations[i].sample_count);
+        fprintf(out, "            \"core:label\": \"dropped\",\n");
+        if (w->annotations[i].sample_count > 0)
+            fprintf(out, "            \"core:comment\": \"%lu samples dropped within this span\"\n", w->annotations[i].dropped);
+        else
+            fprintf(out, "            \"core:comment\": \"%lu samples dropped before this point\"\n", w->annotations[i].dropped);
+        fprintf(out, "        }");
+    }
+    fprintf(out, "\n    ]\n}\n");
+
+    if (fclose(out) != 0 || rename(tmp, w->meta_path) != 0) {
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    return 0;
+}
+
+sigmf_writer_t *sigmf_open(const char *data_path, double sample_rate, double frequency) {
+    sigmf_writer_t *w = calloc(1, sizeof(*w));
+
+    if (w == NULL)
+        return NULL;
+    w->data_path = strdup(data_path);
+    w->meta_path = sigmf_meta_path(data_path);
+    w->data = fopen(data_path, "wb");
+    if (w->data_path == NULL || w->meta_path == NULL || w->data == NULL) {
+        if (w->data)
+            fclose(w->data);
+        free(w->data_path);
+        free(w->meta_path);
+        free(w);
+        return NULL;
+    }
+    w->sample_rate = sample_rate;
+    w->frequency = frequency;
+    w->new_capture = 1;
+    return w;
+}
+
+int sigmf_write(sigmf_writer_t *w, const void *samples, unsigned num, unsigned sample_size, const struct timespec *ts) {
+    w->sample_size = sample_size;
+    if (w->new_capture) {
+        sigmf_capture_t *c;
+        // a capture opened inside the span of merged drops only timed the
+        // samples up to the next one, move it past that instead of adding
+        // another
+        if (w->num_captures > 0 && w->num_annotations > 0 &&
+                w->captures[w->num_captures - 1].sample_start >= w->annotations[w->num_annotations - 1].sample_start) {
+            c = &w->captures[w->num_captures - 1];
+        } else {
+            c = realloc(w->captures, (w->num_captures + 1) * sizeof(*c));
+            if (c == NULL)
+                return -1;
+            w->captures = c;
+            c = &w->captures[w->num_captures++];
+        }
+        c->sample_start = w->samples;
+        c->datetime = (struct timespec){ 0, 0 };
+        // ts is the end of the buffer, back up to its first sample
+        if (ts != NULL && ts->tv_sec != 0) {
+            long long ns = (long long)ts->tv_sec * 1000000000ll + ts->tv_nsec - (long long)(num / w->sample_rate * 1e9);
+            c->datetime.tv_sec = ns / 1000000000ll;
+            c->datetime.tv_nsec = ns % 1000000000ll;
+        }
+        w->new_capture = 0;
+    }
+
+    if (fwrite(samples, sample_size, num, w->data) != num)
+        return -1;
+    w->samples += num;
+    return 0;
+}
+
+void sigmf_dropped(sigmf_writer_t *w, unsigned long num) {
+    sigmf_annotation_t *a = w->num_annotations > 0 ? &w->annotations[w->num_annotations - 1] : NULL;
+
+    // under sustained overload drops come every few buffers, fold them
+    // into one span rather than an annotation and a capture apiece
+    if (a != NULL && w->samples - a->sample_start - a->sample_count < w->sample_rate * DROP_MERGE_SECONDS) {
+        a->sample_count = w->samples - a->sample_start;
+        a->dropped += num;
+        w->new_capture = 1;
+        return;
+    }
+
+    a = realloc(w->annotations, (w->num_annotations + 1) * sizeof(*a));
+    if (a == NULL)
+        return;
+    w->annotations = a;
+    a = &w->annotations[w->num_annotations++];
+    a->sample_start = w->samples;
+    a->sample_count = 0;
+    a->dropped = num;
+    // the gap breaks timing, so what follows gets its own timestamp
+    w->new_capture = 1;
+}
+
+void sigmf_close(sigmf_writer_t *w) {
+    fclose(w->data);
+    if (write_meta(w) != 0)
+        fprintf(stderr, "WARNING: unable to write SigMF metadata %s\n", w->meta_path);
+    free(w->captures);
+    free(w->annotations);
+    free(w->data_path);
+    free(w->meta_path);
+    free(w);
+}
+
+// just enough JSON for SigMF: find "key" at or after start, return a
+// pointer to its value
+static const char *json_value(const char *json, const char *key) {
+    char quoted[64];
+    const char *p;
+
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    p = strstr(json, quoted);
+    if (p == NULL)
+        return NULL;
+    p += strlen(quoted);
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        ++p;
+    if (*p != ':')
+        return NULL;
+    ++p;
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        ++p;
+    return p;
+}
+
+// unescapes as it copies. \\u escapes outside the BMP are not supported
+static int json_string(const char *json, const char *key, char *out, size_t out_len) {
+    const char *p = json_value(json, key);
+    size_t len = 0;
+    unsigned u, i;
+    char c;
+
+    if (p == NULL || *p++ != '"')
+        return -1;
+    while ((c = *p++) != '"') {
+        if (c == '\0')
+            return -1;
+        if (c == '\\') {
+            switch (c = *p++) {
+                case '"': case '\\': case '/': break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u':
+                    for (u = 0, i = 0; i < 4; ++i, ++p) {
+                        if (!isxdigit((unsigned char)*p))
+                            return -1;
+                        u = u << 4 | (*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+                    }
+                    if (u == 0 || (u >= 0xd800 && u < 0xe000))
+                        return -1;
+                    // as UTF-8, all but the last byte go in here
+                    if (u >= 0x800) {
+                        if (len + 2 >= out_len)
+                            return -1;
+                        out[len++] = 0xe0 | u >> 12;
+                        out[len++] = 0x80 | (u >> 6 & 0x3f);
+                    } else if (u >= 0x80) {
+                        if (len + 1 >= out_len)
+                            return -1;
+                        out[len++] = 0xc0 | u >> 6;
+                    }
+                    c = u < 0x80 ? u : 0x80 | (u & 0x3f);
+                    break;
+                default:
+                    return -1;
+            }
+        }
+        if (len + 1 >= out_len)
+            return -1;
+        out[len++] = c;
+    }
+    out[len] = '\0';
+    return 0;
+}
+
+// ISO 8601 UTC as written by write_datetime, fraction optional
+static int parse_datetime(const char *s, struct timespec *ts) {
+    struct tm tm;
+    const char *p;
+    long ns = 0, scale = 100000000l;
+
+    memset(&tm, 0, sizeof(tm));
+    p = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (p == NULL)
+        return -1;
+    if (*p == '.')
+        for (++p; *p >= '0' && *p <= '9'; ++p, scale /= 10)
+            ns += (*p - '0') * scale;
+    ts->tv_sec = timegm(&tm);
+    ts->tv_nsec = ns;
+    return 0;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *buf;
+    long len;
+
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len + 1);
+    if (buf != NULL) {
+        len = fread(buf, 1, len, f);
+        buf[len] = '\0';
+    }
+    fclose(f);
+    return buf;
+}
+
+int sigmf_read(const char *path, sigmf_info_t *info, char **data_path) {
+    char *meta_path, *json, dataset[256];
+    const char *p;
+    int is_meta = ends_with(path, SIGMF_META_EXT);
+
+    meta_path = is_meta ? strdup(path) : sigmf_meta_path(path);
+    if (meta_path == NULL)
+        return -1;
+    json = read_file(meta_path);
+    if (json == NULL) {
+        free(meta_path);
+        return is_meta ? -1 : 1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    *data_path = NULL;
+    if (json_string(json, "core:datatype", info->datatype, sizeof(info->datatype)) != 0)
+        goto fail;
+    if ((p = json_value(json, "core:sample_rate")) == NULL)
+        goto fail;
+    info->sample_rate = strtod(p, NULL);
+    if ((p = strstr(json, "\"captures\"")) != NULL) {
+        char datetime[64];
+        const char *v;
+        if ((v = json_value(p, "core:frequency")) != NULL)
+            info->frequency = strtod(v, NULL);
+        if (json_string(p, "core:datetime", datetime, sizeof(datetime)) == 0)
+            parse_datetime(datetime, &info->datetime);
+    }
+
+    if (!is_meta) {
+        *data_path = strdup(path);
+    } else if (json_string(json, "core:dataset", dataset, sizeof(dataset)) == 0) {
+        // relative to the metadata file
+        const char *slash = strrchr(meta_path, '/');
+        if (asprintf(data_path, "%.*s%s", slash ? (int)(slash - meta_path + 1) : 0, meta_path, dataset) < 0)
+            *data_path = NULL;
+    } else {
+        size_t len = strlen(meta_path) - strlen(SIGMF_META_EXT);
+        if (asprintf(data_path, "%.*s%s", (int)len, meta_path, SIGMF_DATA_EXT) < 0)
+            *data_path = NULL;
+    }
+    if (*data_path == NULL)
+        goto fail;
+
+    free(json);
+    free(meta_path);
+    return 0;
+
+fail:
+    free(json);
+    free(meta_path);
+    return -1;
+}
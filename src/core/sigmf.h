@@ -0,0 +1,41 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __SIGMF_H__
+#define __SIGMF_H__
+
+#include <time.h>
+
+// SigMF recording: the dataset is written as-is, the .sigmf-meta next to
+// it describes rate, frequency, sample format, when capture started and
+// where samples were lost. the metadata is only written by sigmf_close,
+// so writing samples never waits on it.
+//
+// foo.sigmf-data gets foo.sigmf-meta, any other name gets NAME.sigmf-meta
+
+typedef struct _sigmf_writer_t sigmf_writer_t;
+
+typedef struct _sigmf_info_t {
+    char datatype[16];      // e.g. ci8, ci16_le, cf32_le
+    double sample_rate;     // Hz
+    double frequency;       // Hz, of the first capture
+    struct timespec datetime; // of the first capture, zero if unknown
+} sigmf_info_t;
+
+sigmf_writer_t *sigmf_open(const char *data_path, double sample_rate, double frequency);
+// ts is when the last sample of the buffer arrived, may be zero if unknown
+int sigmf_write(sigmf_writer_t *w, const void *samples, unsigned num, unsigned sample_size, const struct timespec *ts);
+// num samples were lost before the next call to sigmf_write
+void sigmf_dropped(sigmf_writer_t *w, unsigned long num);
+void sigmf_close(sigmf_writer_t *w);
+
+// path may be the dataset or the .sigmf-meta. returns 0 and fills in info
+// and data_path (malloc'd) if the recording has SigMF metadata, 1 if it
+// does not, -1 if the metadata can't be understood.
+int sigmf_read(const char *path, sigmf_info_t *info, char **data_path);
+
+char *sigmf_meta_path(const char *data_path);
+const char *sigmf_datatype(unsigned sample_size);
+
+#endif
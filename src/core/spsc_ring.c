@@ -0,0 +1,111 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+int spsc_ring_init(spsc_ring_t *r, unsigned capacity) {
+    size_t n = 2;
+
+    memset(r, 0, sizeof(*r));
+    while (n < capacity)
+        n <<= 1;
+
+    r->mask = n - 1;
+    if (posix_memalign((void **)&r->slots, SPSC_RING_CACHE_LINE, n * sizeof(*r->slots)) != 0)
+        return -1;
+    futex_init(&r->not_empty);
+    futex_init(&r->not_full);
+    return 0;
+}
+
+void spsc_ring_destroy(spsc_ring_t *r) {
+    futex_destroy(&r->not_empty);
+    futex_destroy(&r->not_full);
+    free(r->slots);
+    r->slots = NULL;
+}
+
+int spsc_ring_push(spsc_ring_t *r, void *elem) {
+    size_t head = r->head;
+
+    if (head - r->tail_cache > r->mask) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (head - r->tail_cache > r->mask)
+            return -1;
+    }
+    r->slots[head & r->mask] = elem;
+    // seq_cst against spsc_ring_take: either it sees the new head or we see
+    // it waiting. only the first push after it sleeps pays for the wake
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->consumer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&r->consumer_waiting, 0, __ATOMIC_SEQ_CST))
+        futex_wake(&r->not_empty);
+    return 0;
+}
+
+int spsc_ring_pop(spsc_ring_t *r, void **elem_out) {
+    size_t tail = r->tail;
+
+    if (tail == r->head_cache) {
+        r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (tail == r->head_cache)
+            return -1;
+    }
+    *elem_out = r->slots[tail & r->mask];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->producer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&r->producer_waiting, 0, __ATOMIC_SEQ_CST))
+        futex_wake(&r->not_full);
+    return 0;
+}
+
+int spsc_ring_put(spsc_ring_t *r, void *elem) {
+    for (;;) {
+        uint32_t seq;
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            return -1;
+        if (spsc_ring_push(r, elem) == 0)
+            return 0;
+
+        seq = futex_value(&r->not_full);
+        __atomic_store_n(&r->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        // room may have been made before the flag was visible
+        if (r->head - __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) > r->mask &&
+                !__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            futex_wait(&r->not_full, seq);
+        __atomic_store_n(&r->producer_waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+int spsc_ring_take(spsc_ring_t *r, void **elem_out) {
+    for (;;) {
+        uint32_t seq;
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            return -1;
+        if (spsc_ring_pop(r, elem_out) == 0)
+            return 0;
+
+        seq = futex_value(&r->not_empty);
+        __atomic_store_n(&r->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (r->tail == __atomic_load_n(&r->head, __ATOMIC_SEQ_CST) &&
+                !__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+            futex_wait(&r->not_empty, seq);
+        __atomic_store_n(&r->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void spsc_ring_close(spsc_ring_t *r) {
+    __atomic_store_n(&r->closed, 1, __ATOMIC_RELEASE);
+    futex_wake(&r->not_empty);
+    futex_wake(&r->not_full);
+}
+
+size_t spsc_ring_size(spsc_ring_t *r) {
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    return head >= tail ? head - tail : 0;
+}
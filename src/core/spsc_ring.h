@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "futex.h"
+
+#define SPSC_RING_CACHE_LINE 64
+
+// bounded lock-free queue of pointers between exactly one producer thread
+// and one consumer thread
+//
+// push and pop never take a lock or make a system call. put and take block
+// when the ring is full / empty, sleeping on a futex (a condition variable
+// off Linux) that is only touched when the other side is actually waiting.
+typedef struct _spsc_ring_t {
+    // producer's line
+    size_t head __attribute__((aligned(SPSC_RING_CACHE_LINE))); // next slot to push
+    size_t tail_cache; // producer's last look at tail
+    // consumer's line
+    size_t tail __attribute__((aligned(SPSC_RING_CACHE_LINE))); // next slot to pop
+    size_t head_cache; // consumer's last look at head
+    // blocking, only written when someone sleeps or on close
+    futex_t not_empty __attribute__((aligned(SPSC_RING_CACHE_LINE)));
+    futex_t not_full;
+    int consumer_waiting;
+    int producer_waiting;
+    int closed;
+    size_t mask __attribute__((aligned(SPSC_RING_CACHE_LINE)));
+    void **slots;
+} spsc_ring_t;
+
+// capacity is rounded up to a power of two
+int spsc_ring_init(spsc_ring_t *r, unsigned capacity);
+void spsc_ring_destroy(spsc_ring_t *r);
+
+// return 0 on success, -1 if the ring is full / empty
+int spsc_ring_push(spsc_ring_t *r, void *elem);
+int spsc_ring_pop(spsc_ring_t *r, void **elem_out);
+
+// block while full / empty. return 0 on success, -1 once the ring is closed
+int spsc_ring_put(spsc_ring_t *r, void *elem);
+int spsc_ring_take(spsc_ring_t *r, void **elem_out);
+
+// wakes and fails any blocked or future put / take
+void spsc_ring_close(spsc_ring_t *r);
+
+// approximate number of queued elements
+size_t spsc_ring_size(spsc_ring_t *r);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "trace.h"
+
+typedef struct _trace_ring_t {
+    uint64_t head; // spans written, the newest TRACE_RING_EVENTS are kept
+    long tid;
+    char name[16];
+    trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+static __thread trace_ring_t *ring = NULL;
+
+// every thread's ring, kept after it exits. the lock is taken by a
+// thread's first span and by trace_dump
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_t **rings = NULL;
+static unsigned num_rings = 0;
+
+uint64_t trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static long thread_id(void) {
+#ifdef __linux__
+    return syscall(SYS_gettid);
+#else
+    uint64_t tid;
+    pthread_threadid_np(NULL, &tid);
+    return (long)tid;
+#endif
+}
+
+static trace_ring_t *new_ring(void) {
+    trace_ring_t *r = calloc(1, sizeof(*r)), **grown;
+
+    if (r == NULL)
+        return NULL;
+    r->tid = thread_id();
+    pthread_getname_np(pthread_self(), r->name, sizeof(r->name));
+
+    pthread_mutex_lock(&rings_lock);
+    grown = realloc(rings, (num_rings + 1) * sizeof(*rings));
+    if (grown == NULL) {
+        pthread_mutex_unlock(&rings_lock);
+        free(r);
+        return NULL;
+    }
+    rings = grown;
+    rings[num_rings++] = r;
+    pthread_mutex_unlock(&rings_lock);
+    return r;
+}
+
+void trace_span(const char *name, uint64_t start) {
+    uint64_t end = trace_now();
+    trace_event_t *e;
+
+    if (ring == NULL && (ring = new_ring()) == NULL)
+        return;
+
+    // relaxed, trace_dump may be reading the slot
+    e = &ring->events[ring->head % TRACE_RING_EVENTS];
+    __atomic_store_n(&e->name, name, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->start, start, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->dur, end - start, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// threads are named by whoever started them, which may be after their
+// first span
+static void thread_name(trace_ring_t *r, char *out, size_t len) {
+#ifdef __linux__
+    char path[64];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/self/task/%ld/comm", r->tid);
+    if ((f = fopen(path, "r")) != NULL) {
+        if (fgets(out, len, f) != NULL) {
+            out[strcspn(out, "\n")] = '\0';
+            fclose(f);
+            return;
+        }
+        fclose(f);
+    }
+#endif
+    snprintf(out, len, "%s", r->name);
+}
+
+int trace_dump(const char *path) {
+    FILE *out = fopen(path, "w");
+    int pid = (int)getpid();
+    unsigned i;
+
+    if (out == NULL)
+        return -1;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ice9-bluetooth\"}}", pid);
+
+    pthread_mutex_lock(&rings_lock);
+    for (i = 0; i < num_rings; ++i) {
+        trace_ring_t *r = rings[i];
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t pos = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        char name[32];
+
+        thread_name(r, name, sizeof(name));
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}", pid, r->tid, name);
+
+        for (; pos < head; ++pos) {
+            trace_event_t *e = &r->events[pos % TRACE_RING_EVENTS];
+            const char *ename = __atomic_load_n(&e->name, __ATOMIC_RELAXED);
+            uint64_t start = __atomic_load_n(&e->start, __ATOMIC_RELAXED);
+            uint64_t dur = __atomic_load_n(&e->dur, __ATOMIC_RELAXED);
+
+            // microseconds, to the ns
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu}",
+                    ename, pid, r->tid,
+                    (unsigned long long)(start / 1000), (unsigned long long)(start % 1000),
+                    (unsigned long long)(dur / 1000), (unsigned long long)(dur % 1000));
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    fprintf(out, "\n]}\n");
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+void trace_free(void) {
+    unsigned i;
+
+    pthread_mutex_lock(&rings_lock);
+    for (i = 0; i < num_rings; ++i)
+        free(rings[i]);
+    free(rings);
+    rings = NULL;
+    num_rings = 0;
+    pthread_mutex_unlock(&rings_lock);
+    ring = NULL;
+}
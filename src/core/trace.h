@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+// hot-path trace points, compiled in with -DENABLE_TRACE=ON (USE_TRACE)
+//
+// a span is a name, a start and a duration, written to a ring of the last
+// TRACE_RING_EVENTS in the calling thread, which nobody else writes. the
+// rings are dumped as Chrome trace JSON (chrome://tracing, Perfetto) on
+// SIGUSR2 and at exit, so a stall shows up on a timeline of every stage.
+//
+//     TRACE_BEGIN(fft);
+//     fftwf_execute_dft(...);
+//     TRACE_END(fft, "fft");
+//
+// names must be string literals, only the pointer is kept. without
+// USE_TRACE both macros compile to nothing.
+#define TRACE_RING_EVENTS (1 << 14)
+
+#ifdef USE_TRACE
+
+typedef struct _trace_event_t {
+    const char *name;
+    uint64_t start; // ns, CLOCK_MONOTONIC
+    uint64_t dur;
+} trace_event_t;
+
+uint64_t trace_now(void);
+void trace_span(const char *name, uint64_t start);
+
+#define TRACE_BEGIN(var) uint64_t trace_##var = trace_now()
+#define TRACE_END(var, name) trace_span(name, trace_##var)
+
+// what has been recorded so far, as {"traceEvents":[...]}. safe while the
+// threads are still tracing, though a span being written as its slot is
+// read may come out garbled. returns -1 if path can't be written
+int trace_dump(const char *path);
+// frees every thread's ring, no thread may trace from here on
+void trace_free(void);
+
+#else
+
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name)
+
+static inline int trace_dump(const char *path) { return -1; }
+static inline void trace_free(void) { }
+
+#endif
+
+#endif
@@ -17,8 +17,6 @@ const float bt = 0.25f; // agc bandwidth
 // starting size of burst buffer in floats
 #define BURST_START_SIZE 2048
 
-#define MAX_BURST_SIZE 32768
-
 // grab the RSSI once AGC has stabilized a handful of samples into the
 // burst, but not too soon before the burst ends!
 #define BURST_RSSI_OFFSET 80
@@ -46,8 +44,43 @@ void burst_catcher_destroy(burst_catcher_t *c) {
     c->burst = NULL;
 }
 
+void burst_catcher_set_clock(burst_catcher_t *c, struct timespec epoch, float samp_rate) {
+    c->epoch = epoch;
+    c->samp_rate = samp_rate;
+    c->samples = 0;
+}
+
+static void sample_time(burst_catcher_t *c, struct timespec *ts) {
+    unsigned long n = c->samples - 1; // the sample just executed
+    unsigned long rate = (unsigned long)c->samp_rate;
+    unsigned long sec = n / rate, rem = n % rate;
+
+    ts->tv_sec = c->epoch.tv_sec + sec;
+    ts->tv_nsec = c->epoch.tv_nsec + (long)((double)rem * 1e9 / c->samp_rate);
+    if (ts->tv_nsec >= 1000000000l) {
+        ts->tv_nsec -= 1000000000l;
+        ++ts->tv_sec;
+    }
+}
+
+static void emit_burst(burst_catcher_t *c, burst_t *burst_out) {
+    burst_out->burst = c->burst;
+    burst_out->len = c->burst_len;
+    burst_out->num = c->burst_num;
+    burst_out->freq = c->freq;
+    burst_out->timestamp = c->timestamp;
+    burst_out->rssi_db = c->burst_rssi;
+    // grab the noise level after the burst has ended
+    burst_out->noise_db = agc_crcf_get_rssi(c->agc);
+    c->burst = NULL;
+    c->burst_len = 0;
+    c->burst_buf_size = 0;
+    ++c->burst_num;
+}
+
 int burst_catcher_execute(burst_catcher_t *c, float complex *sample, burst_t *burst_out) {
     agc_crcf_execute(c->agc, *sample, sample);
+    ++c->samples;
     if (agc_crcf_squelch_get_status(c->agc) == LIQUID_AGC_SQUELCH_SIGNALHI) {
         if (c->burst_len == c->burst_buf_size && c->burst_len < MAX_BURST_SIZE) {
             c->burst_buf_size *= 2;
@@ -62,26 +95,25 @@ int burst_catcher_execute(burst_catcher_t *c, float complex *sample, burst_t *bu
         c->burst_buf_size = BURST_START_SIZE;
         c->burst_len = 0;
         c->burst_rssi = -127;
-        clock_gettime(CLOCK_REALTIME, &c->timestamp);
+        if (c->samp_rate > 0)
+            sample_time(c, &c->timestamp);
+        else
+            clock_gettime(CLOCK_REALTIME, &c->timestamp);
     } else if (agc_crcf_squelch_get_status(c->agc) == LIQUID_AGC_SQUELCH_TIMEOUT) {
-        burst_out->burst = c->burst;
-        burst_out->len = c->burst_len;
-        burst_out->num = c->burst_num;
-        burst_out->freq = c->freq;
-        burst_out->timestamp = c->timestamp;
-        burst_out->rssi_db = c->burst_rssi;
-        // grab the noise level after the burst has ended
-        burst_out->noise_db = agc_crcf_get_rssi(c->agc);
-        c->burst = NULL;
-        c->burst_len = 0;
-        c->burst_buf_size = 0;
-        ++c->burst_num;
+        emit_burst(c, burst_out);
         return 1;
     }
 
     return 0;
 }
 
+int burst_catcher_flush(burst_catcher_t *c, burst_t *burst_out) {
+    if (c->burst == NULL)
+        return 0;
+    emit_burst(c, burst_out);
+    return 1;
+}
+
 void burst_destroy(burst_t *b) {
     free(b->burst);
     free(b->packet.demod);
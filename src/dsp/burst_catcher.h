@@ -9,6 +9,9 @@
 
 #include "fsk.h"
 
+// longest burst kept, in channel samples
+#define MAX_BURST_SIZE 32768
+
 // burst processing, one per channel
 typedef struct _burst_catcher_t {
     unsigned freq;
@@ -19,6 +22,11 @@ typedef struct _burst_catcher_t {
     unsigned burst_num;
     float burst_rssi;
     struct timespec timestamp;
+
+    // sample clock, used instead of the wall clock when samp_rate is set
+    float samp_rate;
+    struct timespec epoch;
+    unsigned long samples;
 } burst_catcher_t;
 
 typedef struct _burst_t {
@@ -33,7 +41,11 @@ typedef struct _burst_t {
 
 void burst_catcher_create(burst_catcher_t *c, unsigned freq);
 void burst_catcher_destroy(burst_catcher_t *c);
+// timestamp bursts by sample count: the first sample is at epoch
+void burst_catcher_set_clock(burst_catcher_t *c, struct timespec epoch, float samp_rate);
 int burst_catcher_execute(burst_catcher_t *c, float complex *sample, burst_t *burst_out);
+// end of input: hand over the burst in progress, if any
+int burst_catcher_flush(burst_catcher_t *c, burst_t *burst_out);
 void burst_destroy(burst_t *b);
 
 #endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "convert.h"
+
+static inline int8_t saturate8(int v) {
+    return v > 127 ? 127 : v < -128 ? -128 : v;
+}
+
+// the vector loops below leave the tail to these
+static void convert_ci16_ci8_scalar(const int16_t *in, int8_t *out, size_t n, unsigned shift) {
+    size_t i;
+    for (i = 0; i < n; ++i)
+        out[i] = saturate8(in[i] >> shift);
+}
+
+static void convert_cf32_ci8_scalar(const float *in, int8_t *out, size_t n, float scale) {
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        float v = in[i] * scale;
+        v = v > 127.0f ? 127.0f : v < -128.0f ? -128.0f : v;
+        out[i] = (int8_t)lrintf(v);
+    }
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+void convert_ci16_ci8(const int16_t *in, int8_t *out, size_t n, unsigned shift) {
+    int16x8_t s = vdupq_n_s16(-(int16_t)shift);
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        int16x8_t a = vshlq_s16(vld1q_s16(&in[i]), s);
+        int16x8_t b = vshlq_s16(vld1q_s16(&in[i + 8]), s);
+        vst1q_s8(&out[i], vcombine_s8(vqmovn_s16(a), vqmovn_s16(b)));
+    }
+    convert_ci16_ci8_scalar(&in[i], &out[i], n - i, shift);
+}
+
+#if defined(__aarch64__)
+void convert_cf32_ci8(const float *in, int8_t *out, size_t n, float scale) {
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i]), scale));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 4]), scale));
+        int32x4_t c = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 8]), scale));
+        int32x4_t d = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 12]), scale));
+        int16x8_t ab = vcombine_s16(vqmovn_s32(a), vqmovn_s32(b));
+        int16x8_t cd = vcombine_s16(vqmovn_s32(c), vqmovn_s32(d));
+        vst1q_s8(&out[i], vcombine_s8(vqmovn_s16(ab), vqmovn_s16(cd)));
+    }
+    convert_cf32_ci8_scalar(&in[i], &out[i], n - i, scale);
+}
+#else
+// 32-bit ARM has no round-to-nearest conversion
+void convert_cf32_ci8(const float *in, int8_t *out, size_t n, float scale) {
+    convert_cf32_ci8_scalar(in, out, n, scale);
+}
+#endif
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+void convert_ci16_ci8(const int16_t *in, int8_t *out, size_t n, unsigned shift) {
+    __m128i s = _mm_cvtsi32_si128(shift);
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i a = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&in[i]), s);
+        __m128i b = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&in[i + 8]), s);
+        _mm_storeu_si128((__m128i *)&out[i], _mm_packs_epi16(a, b));
+    }
+    convert_ci16_ci8_scalar(&in[i], &out[i], n - i, shift);
+}
+
+void convert_cf32_ci8(const float *in, int8_t *out, size_t n, float scale) {
+    // clamp before converting, out of range floats convert to INT_MIN
+    __m128 k = _mm_set1_ps(scale), lo = _mm_set1_ps(-128.0f), hi = _mm_set1_ps(127.0f);
+    size_t i;
+
+#define CONVERT4(off) _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&in[i + (off)]), k), lo), hi))
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i ab = _mm_packs_epi32(CONVERT4(0), CONVERT4(4));
+        __m128i cd = _mm_packs_epi32(CONVERT4(8), CONVERT4(12));
+        _mm_storeu_si128((__m128i *)&out[i], _mm_packs_epi16(ab, cd));
+    }
+#undef CONVERT4
+    convert_cf32_ci8_scalar(&in[i], &out[i], n - i, scale);
+}
+
+#else
+#warning Using non-vectorized sample conversion
+
+void convert_ci16_ci8(const int16_t *in, int8_t *out, size_t n, unsigned shift) {
+    convert_ci16_ci8_scalar(in, out, n, shift);
+}
+
+void convert_cf32_ci8(const float *in, int8_t *out, size_t n, float scale) {
+    convert_cf32_ci8_scalar(in, out, n, scale);
+}
+
+#endif
+
+void convert_to_ci8(sample_format_t f, const void *in, int8_t *out, size_t num) {
+    switch (f) {
+        case SAMPLE_FORMAT_CI16:
+            convert_ci16_ci8(in, out, num * 2, 8);
+            break;
+        case SAMPLE_FORMAT_CF32:
+            convert_cf32_ci8(in, out, num * 2, 127.0f);
+            break;
+        default:
+            if (in != out)
+                memcpy(out, in, num * 2);
+            break;
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// interleaved I/Q sample formats, the channelizer wants ci8
+typedef enum {
+    SAMPLE_FORMAT_CI8,  // int8
+    SAMPLE_FORMAT_CI16, // int16, little endian, full scale
+    SAMPLE_FORMAT_CF32, // float, little endian, full scale is +/-1.0
+} sample_format_t;
+
+// bytes per complex sample
+static inline unsigned sample_format_size(sample_format_t f) {
+    switch (f) {
+        case SAMPLE_FORMAT_CI16: return 4;
+        case SAMPLE_FORMAT_CF32: return 8;
+        default:                 return 2;
+    }
+}
+
+// n is the number of values (twice the number of complex samples). results
+// saturate at the limits of int8.
+
+// out = in >> shift
+void convert_ci16_ci8(const int16_t *in, int8_t *out, size_t n, unsigned shift);
+// out = round(in * scale)
+void convert_cf32_ci8(const float *in, int8_t *out, size_t n, float scale);
+
+// num complex samples of format f to full-scale ci8
+void convert_to_ci8(sample_format_t f, const void *in, int8_t *out, size_t num);
@@ -14,6 +14,7 @@
 
 const unsigned median_symbols = 64; // number of symbols to use for CFO correction
 const float max_freq_offset = 0.4f;
+const float freqdem_kf = 0.8f; // demodulator output is f / (kf * sample rate)
 
 unsigned sps(void);
 
@@ -21,8 +22,12 @@ static inline unsigned median_size(void) {
     return sps() * median_symbols;
 }
 
+float fsk_hz(float v) {
+    return v * freqdem_kf * sps() * 1e6f;
+}
+
 void fsk_demod_init(fsk_demod_t *fsk) {
-    fsk->f = freqdem_create(0.8f);
+    fsk->f = freqdem_create(freqdem_kf);
     fsk->pos_points = malloc(sizeof(float) * median_size());
     fsk->neg_points = malloc(sizeof(float) * median_size());
     /*
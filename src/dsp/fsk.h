@@ -25,5 +25,7 @@ typedef struct _packet_t {
 void fsk_demod_init(fsk_demod_t *fsk);
 void fsk_demod_destroy(fsk_demod_t *fsk);
 void fsk_demod(fsk_demod_t *fsk, float complex *burst, unsigned burst_len, unsigned freq, packet_t *p_out);
+// packet_t's cfo and deviation are in demodulator units, this gives Hz
+float fsk_hz(float v);
 
 #endif
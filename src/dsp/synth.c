@@ -0,0 +1,417 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "synth.h"
+
+#define NOISE_SIGMA 6.0f    // per component, in LSB of the ci8 output
+#define NOISE_TABLE (1 << 16)
+#define MAX_AMPLITUDE 100.0f
+#define GAUSS_BT 0.5f
+#define PULSE_SYMBOLS 3
+#define PHASE_BITS 12       // of the sin/cos table
+#define BLE_DEVIATION 250e3f
+#define BR_DEVIATION 160e3f
+#define GUARD_SECONDS 500e-6
+#define IFS_SECONDS 150e-6  // between packets on one channel
+#define MAX_PACKET_BITS 2870
+
+// air length of DH1, DH3 and DH5 packets, access code included
+static const unsigned br_lengths[] = { 366, 1622, 2870 };
+
+static const uint64_t pn = 0x83848d96bbcc54fcull;
+
+// BCH(64,30) generator of the access code, g(D) = 260534236651 (octal)
+static const uint64_t sync_generator = 0260534236651ull;
+
+void synth_defaults(synth_params_t *p) {
+    p->seconds = 1.0f;
+    p->rate = 100.0f;
+    p->br = 0.5f;
+    p->mix = SYNTH_MIX_ALL;
+    p->snr_db = 20.0f;
+    p->cfo_khz = 50.0f;
+    p->seed = 1;
+}
+
+int synth_parse(synth_params_t *p, const char *spec) {
+    enum { SECONDS, RATE, BR, MIX, SNR, CFO, SEED };
+    char *const keys[] = { "seconds", "rate", "br", "mix", "snr", "cfo", "seed", NULL };
+    char *copy = strdup(spec), *opts = copy, *value, *end;
+    int ret = -1;
+
+    if (copy == NULL)
+        return -1;
+
+    while (*opts != '\0') {
+        int key = getsubopt(&opts, keys, &value);
+        if (key < 0) {
+            fprintf(stderr, "unknown --synth setting %s\n", value);
+            goto out;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "--synth %s needs a value\n", keys[key]);
+            goto out;
+        }
+        if (key == MIX) {
+            if (strcmp(value, "all") == 0) {
+                p->mix = SYNTH_MIX_ALL;
+            } else if (strcmp(value, "adv") == 0) {
+                p->mix = SYNTH_MIX_ADV;
+            } else {
+                fprintf(stderr, "invalid --synth mix %s, must be all or adv\n", value);
+                goto out;
+            }
+            continue;
+        }
+        if (key == SEED) {
+            p->seed = strtoul(value, &end, 0);
+        } else {
+            float v = strtof(value, &end);
+            switch (key) {
+                case SECONDS: p->seconds = v; break;
+                case RATE:    p->rate = v;    break;
+                case BR:      p->br = v;      break;
+                case SNR:     p->snr_db = v;  break;
+                case CFO:     p->cfo_khz = v; break;
+            }
+        }
+        if (*end != '\0') {
+            fprintf(stderr, "invalid --synth %s %s\n", keys[key], value);
+            goto out;
+        }
+    }
+
+    if (p->seconds <= 0.0f) {
+        fprintf(stderr, "--synth seconds must be greater than 0\n");
+    } else if (p->rate < 0.0f) {
+        fprintf(stderr, "--synth rate can't be negative\n");
+    } else if (p->br < 0.0f || p->br > 1.0f) {
+        fprintf(stderr, "--synth br must be between 0 and 1\n");
+    } else if (p->cfo_khz < 0.0f || p->cfo_khz > 250.0f) {
+        fprintf(stderr, "--synth cfo must be between 0 and 250 kHz\n");
+    } else {
+        ret = 0;
+    }
+
+out:
+    free(copy);
+    return ret;
+}
+
+// xorshift32, never 0
+static uint32_t next(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// [0, 1)
+static float uniform(uint32_t *state) {
+    return (next(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(uint32_t *state) {
+    float u = uniform(state), v = uniform(state);
+    return sqrtf(-2.0f * logf(1.0f - u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static unsigned ble_channel(unsigned freq) {
+    unsigned phys = (freq - 2402) / 2;
+    if (phys == 0) return 37;
+    if (phys == 12) return 38;
+    if (phys == 39) return 39;
+    if (phys < 12) return phys - 1;
+    return phys - 2;
+}
+
+static void put_bits(uint8_t *bits, uint64_t v, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; ++i)
+        bits[i] = (v >> i) & 1;
+}
+
+unsigned synth_ble_bits(uint8_t *bits, unsigned freq, const uint8_t *pdu, unsigned pdu_len) {
+    uint8_t header[2] = { 0x42, pdu_len }; // ADV_NONCONN_IND, random address
+    uint8_t *pdu_bits = bits + 8 + 32, lfsr;
+    uint32_t crc = 0x555555;
+    unsigned i, n = 0;
+
+    put_bits(bits, SYNTH_BLE_AA & 1 ? 0x55 : 0xaa, 8);
+    put_bits(bits + 8, SYNTH_BLE_AA, 32);
+
+    put_bits(pdu_bits, header[0], 8);
+    put_bits(pdu_bits + 8, header[1], 8);
+    for (i = 0; i < pdu_len; ++i)
+        put_bits(pdu_bits + 16 + 8 * i, pdu[i], 8);
+    n = 16 + 8 * pdu_len;
+
+    // CRC over the header and payload, sent most significant bit first
+    for (i = 0; i < n; ++i) {
+        uint32_t feedback = ((crc >> 23) ^ pdu_bits[i]) & 1;
+        crc = (crc << 1) & 0xffffff;
+        if (feedback)
+            crc ^= 0x00065b;
+    }
+    for (i = 0; i < 24; ++i)
+        pdu_bits[n + i] = (crc >> (23 - i)) & 1;
+    n += 24;
+
+    // whitening, x^7 + x^4 + 1 seeded from the channel index
+    lfsr = ble_channel(freq) | 0x40;
+    for (i = 0; i < n; ++i) {
+        if (lfsr & 1) {
+            pdu_bits[i] ^= 1;
+            lfsr ^= 0x88;
+        }
+        lfsr >>= 1;
+    }
+
+    return 8 + 32 + n;
+}
+
+// LAP and barker code, the parity bits from the BCH code, all scrambled
+// with the PN sequence
+static uint64_t sync_word(uint32_t lap) {
+    uint64_t barker = lap & 0x800000 ? 0x13 : 0x2c;
+    uint64_t info = ((lap & 0xffffff) | barker << 24) ^ (pn >> 34);
+    uint64_t r = info << 34;
+    int i;
+
+    for (i = 63; i >= 34; --i)
+        if ((r >> i) & 1)
+            r ^= sync_generator << (i - 34);
+    return ((info << 34) | (r & ((1ull << 34) - 1))) ^ pn;
+}
+
+unsigned synth_br_bits(uint8_t *bits, uint32_t lap, unsigned num_bits, uint32_t *rng) {
+    uint64_t sync = sync_word(lap);
+    unsigned i;
+
+    // preamble and trailer carry on the alternation of the sync word
+    put_bits(bits, sync & 1 ? 0x5 : 0xa, 4);
+    put_bits(bits + 4, sync, 64);
+    put_bits(bits + 68, sync >> 63 ? 0xa : 0x5, 4);
+    for (i = 72; i < num_bits; ++i)
+        bits[i] = next(rng) & 1;
+    return num_bits;
+}
+
+typedef struct {
+    unsigned sps;           // samples per symbol
+    float fs;
+    float *pulse;           // frequency pulse, PULSE_SYMBOLS * sps long
+    int32_t *step;          // the same as phase steps, for one packet
+    float cos_table[1 << PHASE_BITS];
+    float sin_table[1 << PHASE_BITS];
+} modulator_t;
+
+// Gaussian filtered rectangle, normalized so a run of ones sits at the
+// full deviation
+static int modulator_init(modulator_t *mod, unsigned channels) {
+    float k = (float)M_PI * GAUSS_BT * sqrtf(2.0f / logf(2.0f)), sum = 0.0f;
+    unsigned i, len;
+
+    mod->sps = channels;
+    mod->fs = channels * 1e6f;
+    len = PULSE_SYMBOLS * mod->sps;
+    mod->pulse = malloc(sizeof(float) * len);
+    mod->step = malloc(sizeof(int32_t) * len);
+    if (mod->pulse == NULL || mod->step == NULL)
+        return -1;
+    for (i = 0; i < len; ++i) {
+        float t = (i + 0.5f) / mod->sps - PULSE_SYMBOLS / 2.0f;
+        mod->pulse[i] = 0.5f * (erff(k * (t + 0.5f)) - erff(k * (t - 0.5f)));
+        sum += mod->pulse[i];
+    }
+    for (i = 0; i < len; ++i)
+        mod->pulse[i] *= mod->sps / sum;
+
+    for (i = 0; i < 1 << PHASE_BITS; ++i) {
+        mod->cos_table[i] = cosf(2.0f * (float)M_PI * i / (1 << PHASE_BITS));
+        mod->sin_table[i] = sinf(2.0f * (float)M_PI * i / (1 << PHASE_BITS));
+    }
+    return 0;
+}
+
+// round to the nearest, saturating
+static inline int8_t clip(float v) {
+    v = v > 127.0f ? 127.0f : v;
+    v = v < -127.0f ? -127.0f : v;
+    // offset so truncation rounds, the sign of noise doesn't predict
+    return (int8_t)((int)(v + 128.5f) - 128);
+}
+
+// adds a packet to the noise already in out, (num_bits + PULSE_SYMBOLS - 1)
+// symbols long
+static void modulate(modulator_t *mod, int8_t *out, const uint8_t *bits, unsigned num_bits,
+        float deviation, float offset, float amplitude, uint32_t phase) {
+    unsigned sps = mod->sps, num_symbols = num_bits + PULSE_SYMBOLS - 1, sym, j, k;
+    float scale = 4294967296.0f / mod->fs;
+    uint32_t carrier = (uint32_t)(int64_t)(offset * scale);
+    int32_t *step = mod->step;
+
+    // phase steps of a one's pulse at this deviation, a zero's are negated
+    for (j = 0; j < PULSE_SYMBOLS * sps; ++j)
+        step[j] = (int32_t)(deviation * mod->pulse[j] * scale);
+
+    for (sym = 0; sym < num_symbols; ++sym) {
+        // the bits whose pulses reach into this symbol, 0 past either end
+        int sign[PULSE_SYMBOLS];
+        for (k = 0; k < PULSE_SYMBOLS; ++k)
+            sign[k] = sym >= k && sym - k < num_bits ? (bits[sym - k] ? 1 : -1) : 0;
+
+        for (j = 0; j < sps; ++j, out += 2) {
+            int32_t f = 0;
+            float a = amplitude, i, q;
+
+            for (k = 0; k < PULSE_SYMBOLS; ++k)
+                f += sign[k] * step[j + k * sps];
+            phase += carrier + (uint32_t)f;
+
+            // ramp up and down over a symbol
+            if (sym == 0)
+                a *= (float)j / sps;
+            else if (sym == num_symbols - 1)
+                a *= (float)(sps - j) / sps;
+            i = out[0] + a * mod->cos_table[phase >> (32 - PHASE_BITS)];
+            q = out[1] + a * mod->sin_table[phase >> (32 - PHASE_BITS)];
+            out[0] = clip(i);
+            out[1] = clip(q);
+        }
+    }
+}
+
+static int add_packet(synth_t *s, unsigned *allocated, synth_packet_t *p) {
+    if (s->num_packets == *allocated) {
+        unsigned grown = *allocated ? *allocated * 2 : 256;
+        synth_packet_t *packets = realloc(s->packets, sizeof(*packets) * grown);
+        if (packets == NULL)
+            return -1;
+        s->packets = packets;
+        *allocated = grown;
+    }
+    s->packets[s->num_packets++] = *p;
+    ++s->injected[p->type];
+    return 0;
+}
+
+int synth_render(synth_t *s, const synth_params_t *p, unsigned channels, unsigned center_freq, size_t num) {
+    uint32_t rng = p->seed ? p->seed : 1;
+    unsigned live[40], ble[40], num_live = 0, num_ble = 0, allocated = 0, i;
+    size_t busy[40] = { 0 }, guard, ifs;
+    int8_t noise[NOISE_TABLE];
+    uint8_t bits[MAX_PACKET_BITS];
+    modulator_t *mod = NULL;
+    float amplitude;
+    double t;
+
+    memset(s, 0, sizeof(*s));
+    s->num = num;
+    s->samples = malloc(2 * num);
+    mod = calloc(1, sizeof(*mod));
+    if (s->samples == NULL || mod == NULL || modulator_init(mod, channels) != 0)
+        goto fail;
+
+    // the channels main() decodes
+    for (i = 0; i < channels; ++i) {
+        unsigned freq = center_freq + (i < channels / 2 ? i : -channels + i);
+        if ((freq & 1) == 0 && freq >= 2402 && freq <= 2480) {
+            live[num_live++] = freq;
+            if (p->mix == SYNTH_MIX_ALL || freq == 2402 || freq == 2426 || freq == 2480)
+                ble[num_ble++] = freq;
+        }
+    }
+
+    for (i = 0; i < NOISE_TABLE; ++i)
+        noise[i] = clip(gaussian(&rng) * NOISE_SIGMA);
+    for (i = 0; i < 2 * num; i += 2) {
+        uint32_t r = next(&rng);
+        s->samples[i] = noise[r & (NOISE_TABLE - 1)];
+        s->samples[i + 1] = noise[r >> 16];
+    }
+
+    // SNR over the 1 MHz of a channel, where the noise is 1/channels of
+    // the total. clipped well short of full scale
+    amplitude = sqrtf(powf(10.0f, p->snr_db / 10.0f) * 2.0f * NOISE_SIGMA * NOISE_SIGMA / channels);
+    if (amplitude > MAX_AMPLITUDE)
+        amplitude = MAX_AMPLITUDE;
+
+    guard = (size_t)(GUARD_SECONDS * mod->fs);
+    ifs = (size_t)(IFS_SECONDS * mod->fs);
+
+    // Poisson arrivals over the band, a packet that would land on one
+    // still going on its channel is left out
+    t = GUARD_SECONDS;
+    while (num_live > 0 && p->rate > 0.0f) {
+        synth_packet_t pkt;
+        unsigned ch, num_bits;
+        float deviation;
+
+        t += -log(1.0 - uniform(&rng)) / (p->rate * num_live);
+        pkt.start = (size_t)(t * mod->fs);
+        if (pkt.start + guard >= num)
+            break;
+
+        pkt.type = num_ble == 0 || uniform(&rng) < p->br ? SYNTH_BR : SYNTH_BLE;
+        if (pkt.type == SYNTH_BLE) {
+            uint8_t pdu[37];
+            unsigned data_len = 3 + next(&rng) % 29, j;
+
+            // AdvA, then one manufacturer specific AD structure
+            for (j = 0; j < 6; ++j)
+                pdu[j] = next(&rng);
+            pdu[6] = data_len - 1;
+            pdu[7] = 0xff;
+            for (j = 8; j < 6 + data_len; ++j)
+                pdu[j] = next(&rng);
+            pkt.freq = ble[next(&rng) % num_ble];
+            num_bits = synth_ble_bits(bits, pkt.freq, pdu, 6 + data_len);
+            deviation = BLE_DEVIATION;
+        } else {
+            pkt.freq = live[next(&rng) % num_live];
+            num_bits = synth_br_bits(bits, SYNTH_BR_LAP, br_lengths[next(&rng) % 3], &rng);
+            deviation = BR_DEVIATION;
+        }
+        pkt.cfo = (2.0f * uniform(&rng) - 1.0f) * p->cfo_khz * 1e3f;
+        pkt.len = (num_bits + PULSE_SYMBOLS - 1) * mod->sps;
+
+        ch = (pkt.freq - 2402) / 2;
+        if (pkt.start < busy[ch] || pkt.start + pkt.len + guard > num)
+            continue;
+        busy[ch] = pkt.start + pkt.len + ifs;
+
+        modulate(mod, &s->samples[2 * pkt.start], bits, num_bits, deviation,
+                ((int)pkt.freq - (int)center_freq) * 1e6f + pkt.cfo, amplitude, next(&rng));
+        if (add_packet(s, &allocated, &pkt) != 0)
+            goto fail;
+    }
+
+    free(mod->pulse);
+    free(mod->step);
+    free(mod);
+    return 0;
+
+fail:
+    if (mod != NULL) {
+        free(mod->pulse);
+        free(mod->step);
+    }
+    free(mod);
+    synth_free(s);
+    return -1;
+}
+
+void synth_free(synth_t *s) {
+    free(s->samples);
+    free(s->packets);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// synthetic wideband input, for benchmarking the whole pipeline without an
+// SDR or a recording (--synth)
+//
+// GFSK packets are dropped into complex Gaussian noise at random times on
+// the 2 MHz channels the sniffer decodes: BLE advertising packets (1 Msym/s,
+// h = 0.5) and BR/EDR basic rate packets (h = 0.32), both BT = 0.5. the
+// stream is ci8 at 1 Msample/s per channel, as an SDR would deliver it.
+// everything comes from the seed, so a run can be repeated exactly.
+
+// every BLE packet goes to the advertising access address and every BR/EDR
+// packet to the general inquiry LAP, so detections are easy to tell apart
+#define SYNTH_BLE_AA 0x8e89bed6
+#define SYNTH_BR_LAP 0x9e8b33
+
+typedef enum {
+    SYNTH_BLE,
+    SYNTH_BR,
+    SYNTH_TYPES,
+} synth_type_t;
+
+typedef enum {
+    SYNTH_MIX_ALL, // both kinds on every channel
+    SYNTH_MIX_ADV, // BLE only on the advertising channels 37-39
+} synth_mix_t;
+
+typedef struct _synth_params_t {
+    float seconds;      // of input
+    float rate;         // packets per second per channel, on average
+    float br;           // fraction of them that are BR/EDR
+    synth_mix_t mix;
+    float snr_db;       // signal to noise in the 1 MHz around a packet
+    float cfo_khz;      // each packet's carrier offset is uniform in +/- this
+    uint32_t seed;
+} synth_params_t;
+
+typedef struct _synth_packet_t {
+    synth_type_t type;
+    unsigned freq;      // MHz
+    size_t start;       // first sample
+    unsigned len;       // in samples
+    float cfo;          // Hz
+} synth_packet_t;
+
+typedef struct _synth_t {
+    int8_t *samples;    // interleaved I/Q
+    size_t num;         // complex samples
+    synth_packet_t *packets;
+    unsigned num_packets;
+    unsigned injected[SYNTH_TYPES];
+} synth_t;
+
+void synth_defaults(synth_params_t *p);
+// comma separated key=value pairs over the defaults, for instance
+// "rate=500,br=0.2,mix=adv,snr=15,cfo=100,seconds=5,seed=7". returns -1
+// and says why on stderr if spec doesn't parse
+int synth_parse(synth_params_t *p, const char *spec);
+
+// num complex samples covering channels MHz around center_freq. packets
+// only go to channels the sniffer decodes, and never overlap on one
+// channel. returns -1 if out of memory
+int synth_render(synth_t *s, const synth_params_t *p, unsigned channels, unsigned center_freq, size_t num);
+void synth_free(synth_t *s);
+
+// the bits of one packet in the order they go on air, returns how many.
+// a BLE ADV_NONCONN_IND on freq carrying pdu_len (6 to 37) bytes of pdu
+unsigned synth_ble_bits(uint8_t *bits, unsigned freq, const uint8_t *pdu, unsigned pdu_len);
+// a BR/EDR access code for lap followed by num_bits - 72 bits of header and
+// payload from *rng
+unsigned synth_br_bits(uint8_t *bits, uint32_t lap, unsigned num_bits, uint32_t *rng);
@@ -58,7 +58,7 @@ ble_packet_t *ble_burst(uint8_t *bits, unsigned bits_len, unsigned freq, struct
             if (i + 32 + 8 + 8 > bits_len) continue;
             uint32_t aa = 0;
             for (j = 0; j < 32; ++j)
-                aa |= bits[i+j] << j;
+                aa |= (uint32_t)bits[i+j] << j;
             uint8_t header_len = 0;
             unsigned wh = (whitening_index[channel] + 8) % sizeof(whitening);
             for (j = 0; j < 8; ++j) {
@@ -104,18 +104,33 @@ ble_packet_t *ble_burst(uint8_t *bits, unsigned bits_len, unsigned freq, struct
     return NULL;
 }
 
-void bluetooth_detect(uint8_t *bits, unsigned len, unsigned freq, unsigned rssi, unsigned noise, struct timespec timestamp, uint32_t *lap_out, uint32_t *aa_out) {
+void bluetooth_detect(uint8_t *bits, unsigned len, unsigned freq, unsigned rssi, unsigned noise, float cfo, float deviation, struct timespec timestamp, uint32_t *lap_out, uint32_t *aa_out) {
     uint32_t lap = btbb_find_ac((char *)bits, len, 1);
     if (lap != 0xffffffff) {
         *lap_out = lap;
+        if (config.pcap) {
+            br_packet_t br = {
+                .lap = lap,
+                .rssi_db = rssi,
+                .noise_db = noise,
+                .freq = freq,
+                .cfo = cfo,
+                .deviation = deviation,
+                .timestamp = timestamp,
+            };
+            if (pcap_write_br(config.pcap, &br) != 0 && config.verbose)
+                printf("WARNING: dropped packet on the floor. pcap writer is too slow.\n");
+        }
     } else {
         ble_packet_t * p = ble_burst(bits, len, freq, timestamp);
         if (p != NULL) {
             p->rssi_db = rssi;
             p->noise_db = noise;
+            p->cfo = cfo;
+            p->deviation = deviation;
             *aa_out = p->aa;
-            if (config.pcap)
-                pcap_write_ble(config.pcap, p);
+            if (config.pcap && pcap_write_ble(config.pcap, p) != 0 && config.verbose)
+                printf("WARNING: dropped packet on the floor. pcap writer is too slow.\n");
             free(p);
         }
     }
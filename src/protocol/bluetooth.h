@@ -8,16 +8,29 @@
 #include <stdint.h>
 #include <time.h>
 
-void bluetooth_detect(uint8_t *bits, unsigned len, unsigned freq, unsigned rssi, unsigned noise, struct timespec timestamp, uint32_t *lap_out, uint32_t *aa_out);
+void bluetooth_detect(uint8_t *bits, unsigned len, unsigned freq, unsigned rssi, unsigned noise, float cfo, float deviation, struct timespec timestamp, uint32_t *lap_out, uint32_t *aa_out);
 
 typedef struct _ble_packet_t {
     uint32_t aa;
     int rssi_db;
     int noise_db;
     unsigned freq; // frequency in MHz
+    float cfo;       // Hz
+    float deviation; // Hz
     unsigned len; // length including AA + header + CRC
     struct timespec timestamp;
     uint8_t data[0]; // data starts at AA
 } ble_packet_t;
 
+// BR/EDR packets are only identified by their access code, no payload
+typedef struct _br_packet_t {
+    uint32_t lap;
+    int rssi_db;
+    int noise_db;
+    unsigned freq; // frequency in MHz
+    float cfo;       // Hz
+    float deviation; // Hz
+    struct timespec timestamp;
+} br_packet_t;
+
 #endif
@@ -4,7 +4,6 @@
 
 #ifdef HAVE_BLADERF
 
-#include <complex.h>
 #include <err.h>
 #include <signal.h>
 #include <stdio.h>
@@ -13,12 +12,14 @@
 
 #include <libbladeRF.h>
 
+#include "convert.h"
 #include "sdr.h"
 
 const int bladerf_gain_val = 30;
 const unsigned num_transfers = 7;
 
 #include "options.h"
+#include "realtime.h"
 
 extern sig_atomic_t running;
 extern pid_t self_pid;
@@ -30,6 +31,8 @@ int num_samples_workaround = 0;
 #define BLADERF_OVERSAMPLE
 #endif
 
+#define BLADERF_SC16_Q11_SHIFT 4
+
 void bladerf_list(void) {
     struct bladerf_devinfo *devices;
     int i, num;
@@ -89,7 +92,6 @@ struct bladerf *bladerf_setup(int id) {
 }
 
 void *bladerf_rx_cb(struct bladerf *bladerf, struct bladerf_stream *stream, struct bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) {
-    unsigned i;
 #ifdef BLADERF_OVERSAMPLE
     int8_t *d = (int8_t *)samples;
 #else
@@ -100,20 +102,23 @@ void *bladerf_rx_cb(struct bladerf *bladerf, struct bladerf_stream *stream, stru
     if (num_samples_workaround) // see https://github.com/Nuand/bladeRF/pull/916
         num_samples *= 2;
 
-    sample_buf_t *s = malloc(sizeof(*s) + num_samples * sizeof(int8_t) * 2);
+    if (!running)
+        return samples;
+    sample_buf_t *s = sample_pool_get(num_samples * sizeof(int8_t) * 2);
+    if (s == NULL) {
+        drop_samples(num_samples, DROP_POOL_EXHAUSTED);
+        return samples;
+    }
     s->num = num_samples;
     s->sample_size = 2;
-    for (i = 0; i < num_samples * 2; ++i)
 #ifdef BLADERF_OVERSAMPLE
-        s->samples[i] = d[i];
+    memcpy(s->samples, d, num_samples * 2);
 #else
-        s->samples[i] = d[2*i] / 2048.0f + d[2*i+1] / 2048.0f * I;
+    // Q11 full scale is +/-2048, the top 8 of 12 bits are kept
+    convert_ci16_ci8(d, s->samples, num_samples * 2, BLADERF_SC16_Q11_SHIFT);
 #endif
 
-    if (running)
-        push_samples(s);
-    else
-        free(s);
+    push_samples(s);
 
     return samples;
 }
@@ -126,6 +131,10 @@ void *bladerf_stream_thread(void *arg) {
     unsigned timeout;
     int status;
 
+    // bladerf_rx_cb runs on this thread
+    if (config.rt_priority)
+        rt_set_self(config.rt_priority, "bladeRF stream");
+
 #ifdef BLADERF_OVERSAMPLE
     if ((status = bladerf_init_stream(&stream, bladerf, bladerf_rx_cb, &buffers, num_transfers, BLADERF_FORMAT_SC8_Q7, config.channels / 2 * 4096, num_transfers, NULL)) != 0)
 #else
@@ -174,6 +183,10 @@ static int bladerf_ops_open(sdr_dev_t *dev, const sniffer_config_t *cfg) {
     int id = cfg->bladerf_num >= 0 ? cfg->bladerf_num : 0;
     struct bladerf *bdev = bladerf_setup(id);
     if (!bdev) return -1;
+    // one stream buffer's worth, doubled in case of the num_samples workaround
+    size_t bytes = config.channels / 2 * 4096 * 2 * sizeof(int8_t) * 2;
+    if (sample_pool_init(bytes, sample_pool_count(bytes, cfg->samp_rate)) != 0)
+        errx(1, "Unable to allocate bladeRF sample buffers");
     bladerf_priv_t *priv = calloc(1, sizeof(bladerf_priv_t));
     priv->dev = bdev;
     dev->priv = priv;
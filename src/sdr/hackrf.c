@@ -8,11 +8,13 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <libhackrf/hackrf.h>
 
 #include "sdr.h"
 #include "options.h"
+#include "realtime.h"
 
 const unsigned vga_gain = 32;
 const unsigned lna_gain = 32;
@@ -60,24 +62,38 @@ hackrf_device *hackrf_setup(void) {
     return hackrf;
 }
 
+// libhackrf resubmits t->buffer to libusb as soon as this returns, so the
+// samples can't be handed on in place. one copy into a pooled buffer is the
+// least that can be done here.
 int hackrf_rx_cb(hackrf_transfer *t) {
-    unsigned i;
-    sample_buf_t *s = malloc(sizeof(*s) + t->valid_length * 4);
+    static int promoted = 0;
+    sample_buf_t *s;
+
+    if (!running)
+        return 0;
+    // libhackrf's transfer thread, only reachable from here
+    if (!promoted && config.rt_priority) {
+        rt_set_self(config.rt_priority, "HackRF transfer");
+        promoted = 1;
+    }
+    s = sample_pool_get(t->valid_length);
+    if (s == NULL) {
+        drop_samples(t->valid_length / 2, DROP_POOL_EXHAUSTED);
+        return 0;
+    }
     s->num = t->valid_length / 2;
     s->sample_size = 2;
-    for (i = 0; i < s->num * 2; ++i)
-        s->samples[i] = ((int8_t *)t->buffer)[i];
-    if (running)
-        push_samples(s);
-    else
-        free(s);
+    memcpy(s->samples, t->buffer, s->num * 2);
+    push_samples(s);
     return 0;
 }
 
 static int hackrf_ops_open(sdr_dev_t *dev, const sniffer_config_t *cfg) {
-    (void)cfg;
     hackrf_device *hdev = hackrf_setup();
     if (!hdev) return -1;
+    size_t bytes = hackrf_get_transfer_buffer_size(hdev);
+    if (sample_pool_init(bytes, sample_pool_count(bytes, cfg->samp_rate)) != 0)
+        errx(1, "Unable to allocate HackRF sample buffers");
     dev->priv = hdev;
     return 0;
 }
@@ -2,12 +2,206 @@
  * Unified SDR Hardware Abstraction Layer implementation
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "sdr.h"
 
+#define HUGE_PAGE_SIZE (2u << 20)
+#define CACHE_LINE 64
+
+static struct {
+    uint8_t *mem;
+    size_t mem_size;
+    size_t stride;
+    size_t bytes;
+    unsigned count;
+    int hugepages;
+    // free list: a stack threaded through next[], head is index + 1 in the
+    // low half and a change counter in the high half to defeat ABA
+    unsigned *next;
+    uint64_t head;
+    unsigned in_use;
+    unsigned high_water;
+    unsigned long exhausted;
+    unsigned long oversized;
+} pool;
+
+sample_buf_t *sample_buf_alloc(size_t bytes) {
+    sample_buf_t *buf = malloc(sizeof(*buf) + bytes);
+    if (buf != NULL) {
+        buf->pool_index = 0;
+        buf->samples = buf->data;
+    }
+    return buf;
+}
+
+sample_buf_t *sample_buf_view(int8_t *samples) {
+    sample_buf_t *buf = malloc(sizeof(*buf));
+    if (buf != NULL) {
+        buf->pool_index = 0;
+        buf->samples = samples;
+    }
+    return buf;
+}
+
+static inline sample_buf_t *pool_buf(unsigned index) {
+    return (sample_buf_t *)(pool.mem + (size_t)index * pool.stride);
+}
+
+static void pool_push(unsigned index) {
+    uint64_t old = __atomic_load_n(&pool.head, __ATOMIC_RELAXED), new;
+    do {
+        __atomic_store_n(&pool.next[index], (unsigned)old, __ATOMIC_RELAXED);
+        new = ((old >> 32) + 1) << 32 | (index + 1);
+    } while (!__atomic_compare_exchange_n(&pool.head, &old, new, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// index + 1, or 0 if empty
+static unsigned pool_pop(void) {
+    uint64_t old = __atomic_load_n(&pool.head, __ATOMIC_ACQUIRE), new;
+    unsigned top;
+    do {
+        top = (unsigned)old;
+        if (top == 0)
+            return 0;
+        new = ((old >> 32) + 1) << 32 | __atomic_load_n(&pool.next[top - 1], __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool.head, &old, new, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return top;
+}
+
+static size_t pool_stride(size_t bytes) {
+    return (sizeof(sample_buf_t) + bytes + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+unsigned sample_pool_count(size_t bytes, double samp_rate) {
+    double want = samp_rate * 2 * SAMPLE_POOL_SECONDS / bytes;
+    size_t count = want < 4 ? 4 : (size_t)want + 1, max = SAMPLE_POOL_MEMORY / pool_stride(bytes);
+
+    // count 0 would ask sample_pool_init for the whole SAMPLE_POOL_MEMORY
+    if (max == 0)
+        max = 1;
+    return count < max ? count : max;
+}
+
+int sample_pool_init(size_t bytes, unsigned count) {
+    size_t stride = pool_stride(bytes);
+    size_t mem_size, page = sysconf(_SC_PAGESIZE), i;
+    uint8_t *mem = MAP_FAILED;
+    int hugepages = 0;
+
+    if (pool.mem != NULL || bytes == 0)
+        return -1;
+    if (count == 0)
+        count = SAMPLE_POOL_MEMORY / stride;
+    if (count == 0)
+        count = 1;
+    mem_size = stride * count;
+
+#ifdef MAP_HUGETLB
+    // explicit huge pages need to be reserved by the admin, fall back to
+    // asking for transparent ones
+    mem = mmap(NULL, (mem_size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED) {
+        mem_size = (mem_size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+        hugepages = 1;
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        mem_size = (mem_size + page - 1) & ~(page - 1);
+        mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            return -1;
+#ifdef MADV_HUGEPAGE
+        madvise(mem, mem_size, MADV_HUGEPAGE);
+#endif
+    }
+
+    pool.next = malloc(sizeof(*pool.next) * count);
+    if (pool.next == NULL) {
+        munmap(mem, mem_size);
+        return -1;
+    }
+
+    // fault every page in now rather than in the receive callback
+    memset(mem, 0, mem_size);
+
+    pool.mem = mem;
+    pool.mem_size = mem_size;
+    pool.stride = stride;
+    pool.bytes = bytes;
+    pool.count = count;
+    pool.hugepages = hugepages;
+    pool.head = 0;
+    pool.in_use = pool.high_water = 0;
+    pool.exhausted = pool.oversized = 0;
+    for (i = count; i > 0; --i) {
+        sample_buf_t *buf = pool_buf(i - 1);
+        buf->pool_index = i;
+        buf->samples = buf->data;
+        pool_push(i - 1);
+    }
+    return 0;
+}
+
+sample_buf_t *sample_pool_get(size_t bytes) {
+    unsigned index, in_use, high;
+    sample_buf_t *buf;
+
+    if (pool.mem != NULL && bytes > pool.bytes) {
+        if (__atomic_fetch_add(&pool.oversized, 1, __ATOMIC_RELAXED) == 0)
+            fprintf(stderr, "WARNING: %zu byte sample buffer requested, pool only has %zu\n", bytes, pool.bytes);
+        return NULL;
+    }
+    if (pool.mem == NULL || (index = pool_pop()) == 0) {
+        __atomic_add_fetch(&pool.exhausted, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    in_use = __atomic_add_fetch(&pool.in_use, 1, __ATOMIC_RELAXED);
+    high = __atomic_load_n(&pool.high_water, __ATOMIC_RELAXED);
+    while (in_use > high && !__atomic_compare_exchange_n(&pool.high_water, &high, in_use, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    buf = pool_buf(index - 1);
+    buf->samples = buf->data;
+    return buf;
+}
+
+void sample_buf_free(sample_buf_t *buf) {
+    if (buf == NULL)
+        return;
+    if (buf->pool_index == 0) {
+        free(buf);
+        return;
+    }
+    __atomic_sub_fetch(&pool.in_use, 1, __ATOMIC_RELAXED);
+    pool_push(buf->pool_index - 1);
+}
+
+void sample_pool_get_stats(sample_pool_stats_t *stats) {
+    stats->count = pool.count;
+    stats->bytes = pool.bytes;
+    stats->in_use = __atomic_load_n(&pool.in_use, __ATOMIC_RELAXED);
+    stats->high_water = __atomic_load_n(&pool.high_water, __ATOMIC_RELAXED);
+    stats->exhausted = __atomic_load_n(&pool.exhausted, __ATOMIC_RELAXED);
+    stats->oversized = __atomic_load_n(&pool.oversized, __ATOMIC_RELAXED);
+    stats->hugepages = pool.hugepages;
+}
+
+void sample_pool_destroy(void) {
+    if (pool.mem == NULL)
+        return;
+    munmap(pool.mem, pool.mem_size);
+    free(pool.next);
+    memset(&pool, 0, sizeof(pool));
+}
+
 sdr_dev_t *sdr_open_device(const sniffer_config_t *cfg) {
     if (cfg == NULL) return NULL;
 
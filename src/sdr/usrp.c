@@ -7,13 +7,16 @@
 #include <err.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 
 #include <uhd.h>
 
+#include "convert.h"
 #include "sdr.h"
 #include "options.h"
+#include "realtime.h"
 
 extern sig_atomic_t running;
 extern pid_t self_pid;
@@ -148,58 +151,80 @@ uhd_usrp_handle usrp_setup(char *serial) {
     return usrp;
 }
 
-void *usrp_stream_thread(void *arg) {
-    uhd_usrp_handle usrp = arg;
+typedef struct {
+    uhd_usrp_handle usrp;
     uhd_rx_streamer_handle rx_handle;
-    uhd_error error;
     uhd_rx_metadata_handle md;
-    size_t channel = 0, num_samples, num_rx_samples;
-    void *buf;
-    uhd_rx_metadata_error_code_t error_code;
+    size_t num_samples;     // per recv
+    int16_t *sc16;
+    pthread_t stream_thread;
+} usrp_priv_t;
+
+// the rx streamer, sample pool and conversion buffer are set up when the
+// device is opened, before memory is locked and anything streams
+static void usrp_stream_setup(usrp_priv_t *priv) {
+    size_t channel = 0;
     uhd_stream_args_t stream_args = {
-        .cpu_format = "fc32",
+        // fixed point all the way, the channelizer wants ci8
+        .cpu_format = "sc16",
         .otw_format = "sc16",
         .args = "",
         .channel_list = &channel,
         .n_channels = 1
     };
+    uhd_error error;
+
+    uhd_rx_metadata_make(&priv->md);
+    uhd_rx_streamer_make(&priv->rx_handle);
+    error = uhd_usrp_get_rx_stream(priv->usrp, &stream_args, priv->rx_handle);
+    if (error)
+        errx(1, "Error opening RX stream: %u", error);
+
+    uhd_rx_streamer_max_num_samps(priv->rx_handle, &priv->num_samples);
+    size_t bytes = priv->num_samples * 2 * sizeof(int8_t);
+    if (sample_pool_init(bytes, sample_pool_count(bytes, config.samp_rate)) != 0)
+        errx(1, "Unable to allocate USRP sample buffers");
+    if ((priv->sc16 = malloc(priv->num_samples * 2 * sizeof(int16_t))) == NULL)
+        errx(1, "Unable to allocate USRP sample buffers");
+}
+
+void *usrp_stream_thread(void *arg) {
+    usrp_priv_t *priv = arg;
+    size_t num_rx_samples;
+    void *buf;
+    uhd_rx_metadata_error_code_t error_code;
     uhd_stream_cmd_t stream_cmd = {
         .stream_mode = UHD_STREAM_MODE_START_CONTINUOUS,
         .stream_now = 1,
     };
 
-    uhd_rx_metadata_make(&md);
-
-    uhd_rx_streamer_make(&rx_handle);
-    stream_args.channel_list = &channel;
-    stream_args.n_channels = 1;
-    error = uhd_usrp_get_rx_stream(usrp, &stream_args, rx_handle);
-    if (error)
-        errx(1, "Error opening RX stream: %u", error);
+    if (config.rt_priority)
+        rt_set_self(config.rt_priority, "USRP stream");
 
-    uhd_rx_streamer_max_num_samps(rx_handle, &num_samples);
-    uhd_rx_streamer_issue_stream_cmd(rx_handle, &stream_cmd);
+    uhd_rx_streamer_issue_stream_cmd(priv->rx_handle, &stream_cmd);
 
     while (running) {
-        sample_buf_t *s = malloc(sizeof(*s) + num_samples * 2 * sizeof(float));
-        buf = s->samples;
-        uhd_rx_streamer_recv(rx_handle, &buf, num_samples, &md, 3.0, false, &num_rx_samples);
-	uhd_rx_metadata_error_code(md, &error_code);
+        sample_buf_t *s;
+        buf = priv->sc16;
+        uhd_rx_streamer_recv(priv->rx_handle, &buf, priv->num_samples, &priv->md, 3.0, false, &num_rx_samples);
+	uhd_rx_metadata_error_code(priv->md, &error_code);
         if(error_code != UHD_RX_METADATA_ERROR_CODE_NONE && error_code != 8)
             errx(1, "Error during streaming: %u", error_code);
+        if (!running)
+            break;
+        // the stream has to be read even when there's nowhere to put it
+        if ((s = sample_pool_get(num_rx_samples * 2 * sizeof(int8_t))) == NULL) {
+            drop_samples(num_rx_samples, DROP_POOL_EXHAUSTED);
+            continue;
+        }
+        convert_ci16_ci8(priv->sc16, s->samples, num_rx_samples * 2, 8);
         s->num = num_rx_samples;
-        s->sample_size = 2 * sizeof(float);
-        if (running)
-            push_samples(s);
-        else
-            free(s);
+        s->sample_size = 2;
+        push_samples(s);
     }
 
     stream_cmd.stream_mode = UHD_STREAM_MODE_STOP_CONTINUOUS;
-    uhd_rx_streamer_issue_stream_cmd(rx_handle, &stream_cmd);
-
-    uhd_rx_streamer_free(&rx_handle);
-    uhd_rx_metadata_free(&md);
+    uhd_rx_streamer_issue_stream_cmd(priv->rx_handle, &stream_cmd);
 
     return NULL;
 }
@@ -208,16 +233,12 @@ void usrp_close(uhd_usrp_handle usrp) {
     uhd_usrp_free(&usrp);
 }
 
-typedef struct {
-    uhd_usrp_handle usrp;
-    pthread_t stream_thread;
-} usrp_priv_t;
-
 static int usrp_ops_open(sdr_dev_t *dev, const sniffer_config_t *cfg) {
     uhd_usrp_handle usrp = usrp_setup(cfg->usrp_serial);
     if (!usrp) return -1;
     usrp_priv_t *priv = calloc(1, sizeof(usrp_priv_t));
     priv->usrp = usrp;
+    usrp_stream_setup(priv);
     dev->priv = priv;
     return 0;
 }
@@ -226,7 +247,7 @@ static int usrp_ops_start(sdr_dev_t *dev) {
     usrp_priv_t *priv = (usrp_priv_t *)dev->priv;
     if (!priv || !priv->usrp) return -1;
     dev->is_streaming = true;
-    return pthread_create(&priv->stream_thread, NULL, usrp_stream_thread, (void *)priv->usrp);
+    return pthread_create(&priv->stream_thread, NULL, usrp_stream_thread, (void *)priv);
 }
 
 static int usrp_ops_stop(sdr_dev_t *dev) {
@@ -239,6 +260,9 @@ static void usrp_ops_close(sdr_dev_t *dev) {
     if (priv) {
         if (priv->usrp) {
             pthread_join(priv->stream_thread, NULL);
+            uhd_rx_streamer_free(&priv->rx_handle);
+            uhd_rx_metadata_free(&priv->md);
+            free(priv->sc16);
             usrp_close(priv->usrp);
         }
         free(priv);
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2026 ICE9 Consulting LLC
+ */
+
+#define _GNU_SOURCE
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "burst_archive.h"
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: ice9-bursts <archive>                    list bursts\n"
+            "       ice9-bursts <archive> <index> <prefix>   extract burst to <prefix>.fc32 and <prefix>.f32\n");
+    exit(1);
+}
+
+static void list(burst_archive_reader_t *r) {
+    size_t i, n = burst_archive_count(r);
+
+    printf("# %zu bursts, %.0f samples/sec per channel\n", n, burst_archive_samp_rate(r));
+    printf("# index timestamp freq num len rssi_db noise_db cfo deviation silence lap aa\n");
+    for (i = 0; i < n; ++i) {
+        const burst_archive_entry_t *e = burst_archive_entry(r, i);
+        printf("%zu %lld.%09u %u %u %u %.1f %.1f %f %f %u ",
+                i, (long long)e->ts_sec, e->ts_nsec, e->freq, e->num, e->len,
+                e->rssi_db, e->noise_db, e->cfo, e->deviation, e->silence);
+        if (e->lap != 0xffffffff)
+            printf("%06x ", e->lap);
+        else
+            printf("- ");
+        if (e->aa != 0xffffffff)
+            printf("%08x\n", e->aa);
+        else
+            printf("-\n");
+    }
+}
+
+static void extract(burst_archive_reader_t *r, size_t i, const char *prefix) {
+    const burst_archive_entry_t *e = burst_archive_entry(r, i);
+    char *filename;
+    FILE *out;
+
+    if (e == NULL)
+        errx(1, "no burst %zu, archive has %zu", i, burst_archive_count(r));
+
+    if (asprintf(&filename, "%s.fc32", prefix) < 0)
+        err(1, "asprintf");
+    out = fopen(filename, "w");
+    if (out == NULL)
+        err(1, "Unable to create file %s", filename);
+    fwrite(burst_archive_iq(r, i), sizeof(float complex), e->len, out);
+    fclose(out);
+    free(filename);
+
+    if (asprintf(&filename, "%s.f32", prefix) < 0)
+        err(1, "asprintf");
+    out = fopen(filename, "w");
+    if (out == NULL)
+        err(1, "Unable to create file %s", filename);
+    fwrite(burst_archive_demod(r, i), sizeof(float), e->len, out);
+    fclose(out);
+    free(filename);
+}
+
+int main(int argc, char **argv) {
+    burst_archive_reader_t *r;
+
+    if (argc != 2 && argc != 4)
+        usage();
+
+    r = burst_archive_map(argv[1]);
+    if (r == NULL)
+        errx(1, "Unable to read burst archive %s", argv[1]);
+
+    if (argc == 2)
+        list(r);
+    else
+        extract(r, strtoul(argv[2], NULL, 10), argv[3]);
+
+    burst_archive_unmap(r);
+    return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * Micro-benchmarks of the DSP and detection kernels at the sizes the
+ * sniffer runs them: 20, 40 and 96 channels for the channelizer, and
+ * burst lengths from an empty BLE PDU up to a BR/EDR DH5.
+ *
+ * Each case is run until it has taken at least the minimum time, RUNS
+ * times over, and the median is reported. Inputs come from a fixed seed
+ * so runs are comparable.
+ *
+ * usage: bench_dsp [-j] [-t ms] [kernel ...]
+ *
+ *     -j      one JSON object per line, for keeping track over time
+ *     -t ms   minimum time per run (default 100)
+ *     kernel  only run these (window_dotprod, pfbch2_execute, fsk_demod,
+ *             btbb_find_ac, ble_burst)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <time.h>
+#include <unistd.h>
+
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <liquid/liquid.h>
+
+#include "bluetooth.h"
+#include "btbb.h"
+#include "fsk.h"
+#include "options.h"
+#include "pfbch2.h"
+#include "window.h"
+
+#define RUNS 5
+
+// bluetooth.c writes packets to config.pcap, left NULL here
+sniffer_config_t config;
+
+// 2 MHz channels at 1 Msym/s
+unsigned sps(void) {
+    return 2;
+}
+
+extern ble_packet_t *ble_burst(uint8_t *bits, unsigned bits_len, unsigned freq, struct timespec timestamp);
+
+static const unsigned channel_counts[] = { 20, 40, 96 };
+
+// samples at 2 sps: an empty BLE PDU (80 bits), the longest legacy
+// advertising PDU (376 bits), and a BR/EDR DH5 (2870 bits)
+static const unsigned burst_lens[] = { 160, 752, 5740 };
+
+static int json = 0;
+static unsigned min_ms = 100;
+static char **only = NULL;
+static int num_only = 0;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// xorshift, so every run sees the same input
+static uint32_t rng_state = 0x1ce9;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int wanted(const char *kernel) {
+    int i;
+    if (num_only == 0)
+        return 1;
+    for (i = 0; i < num_only; ++i)
+        if (strcmp(only[i], kernel) == 0)
+            return 1;
+    return 0;
+}
+
+// a case runs iters calls of fn, each covering samples_per_call samples
+typedef void (*bench_fn)(void *arg, unsigned iters);
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *kernel, const char *param, unsigned value,
+        bench_fn fn, void *arg, unsigned samples_per_call) {
+    double ns_per_sample[RUNS], ns, rate;
+    uint64_t iters = 1, start, elapsed;
+    unsigned i;
+
+    // warm up, and find how many calls take min_ms
+    for (;;) {
+        start = now_ns();
+        fn(arg, iters);
+        elapsed = now_ns() - start;
+        if (elapsed >= min_ms * 1000000ull)
+            break;
+        iters = elapsed < 1000 ? iters * 16 : iters * 2;
+    }
+
+    for (i = 0; i < RUNS; ++i) {
+        start = now_ns();
+        fn(arg, iters);
+        elapsed = now_ns() - start;
+        ns_per_sample[i] = (double)elapsed / ((double)iters * samples_per_call);
+    }
+    qsort(ns_per_sample, RUNS, sizeof(double), compare_doubles);
+    ns = ns_per_sample[RUNS / 2];
+    rate = 1e9 / ns;
+
+    if (json)
+        printf("{\"kernel\":\"%s\",\"%s\":%u,\"iterations\":%llu,\"ns_per_sample\":%.4f,\"samples_per_sec\":%.0f,\"min_ns_per_sample\":%.4f,\"max_ns_per_sample\":%.4f}\n",
+                kernel, param, value, (unsigned long long)iters, ns, rate,
+                ns_per_sample[0], ns_per_sample[RUNS - 1]);
+    else
+        printf("%-15s %-8s %5u  %9.3f ns/sample  %8.2f Msamples/s  (%.3f-%.3f)\n",
+                kernel, param, value, ns, rate / 1e6,
+                ns_per_sample[0], ns_per_sample[RUNS - 1]);
+    fflush(stdout);
+}
+
+// prototype filter as main() designs it
+static float *prototype(unsigned channels, unsigned m) {
+    unsigned h_len = 2 * channels * m + 1;
+    float *h = malloc(sizeof(float) * h_len);
+    liquid_firdes_kaiser(h_len, 0.75f / (float)channels, 60.0f, 0.0f, h);
+    return h;
+}
+
+// window_dotprod: one call per channel per output, on subfilter-sized
+// windows
+typedef struct {
+    window_t *w;
+    int16_t *h;
+    unsigned channels;
+    int16_t out[2];
+} window_arg_t;
+
+static void bench_window(void *p, unsigned iters) {
+    window_arg_t *a = p;
+    unsigned i, c;
+    for (i = 0; i < iters; ++i)
+        for (c = 0; c < a->channels; ++c)
+            window_dotprod(&a->w[c], &a->h[c * 8], a->out);
+}
+
+static void window_dotprod_cases(void) {
+    window_arg_t a;
+    unsigned i, c, j;
+    int8_t x[2];
+
+    for (i = 0; i < sizeof(channel_counts) / sizeof(channel_counts[0]); ++i) {
+        a.channels = channel_counts[i];
+        a.w = malloc(sizeof(window_t) * a.channels);
+        a.h = malloc(sizeof(int16_t) * 8 * a.channels);
+        for (c = 0; c < a.channels; ++c) {
+            window_init(&a.w[c], 8);
+            for (j = 0; j < 8; ++j) {
+                x[0] = rng(); x[1] = rng();
+                window_push(&a.w[c], x);
+                a.h[c * 8 + j] = rng();
+            }
+        }
+        run("window_dotprod", "channels", a.channels, bench_window, &a, a.channels);
+        for (c = 0; c < a.channels; ++c)
+            window_release(&a.w[c]);
+        free(a.w);
+        free(a.h);
+    }
+}
+
+// pfbch2_execute: each call takes M/2 input samples
+#define PFB_FRAMES 4096
+
+typedef struct {
+    pfbch2_t c;
+    int8_t *x;
+    int16_t *y;
+} pfb_arg_t;
+
+static void bench_pfb(void *p, unsigned iters) {
+    pfb_arg_t *a = p;
+    unsigned i;
+    for (i = 0; i < iters; ++i)
+        pfbch2_execute(&a->c, &a->x[(i % PFB_FRAMES) * a->c.M], a->y);
+}
+
+static void pfbch2_execute_cases(void) {
+    pfb_arg_t a;
+    unsigned i, j;
+
+    for (i = 0; i < sizeof(channel_counts) / sizeof(channel_counts[0]); ++i) {
+        unsigned channels = channel_counts[i];
+        float *h = prototype(channels, 4);
+
+        pfbch2_init(&a.c, channels, 4, h);
+        free(h);
+        a.x = malloc(PFB_FRAMES * channels);
+        a.y = malloc(sizeof(int16_t) * 2 * channels);
+        for (j = 0; j < PFB_FRAMES * channels; ++j)
+            a.x[j] = rng();
+        run("pfbch2_execute", "channels", channels, bench_pfb, &a, channels / 2);
+        pfbch2_release(&a.c);
+        free(a.x);
+        free(a.y);
+    }
+}
+
+// fsk_demod: a GFSK-ish burst, modulation index 0.5 with some CFO and
+// noise, so it makes it past the CFO estimate
+typedef struct {
+    fsk_demod_t fsk;
+    float complex *burst;
+    unsigned len;
+} fsk_arg_t;
+
+static void bench_fsk(void *p, unsigned iters) {
+    fsk_arg_t *a = p;
+    unsigned i;
+    for (i = 0; i < iters; ++i) {
+        packet_t pkt = { 0 };
+        fsk_demod(&a->fsk, a->burst, a->len, 2402, &pkt);
+        free(pkt.demod);
+        free(pkt.bits);
+    }
+}
+
+static void fsk_demod_cases(void) {
+    fsk_arg_t a;
+    unsigned i, j;
+
+    fsk_demod_init(&a.fsk);
+    for (i = 0; i < sizeof(burst_lens) / sizeof(burst_lens[0]); ++i) {
+        float phase = 0, step = 0;
+
+        a.len = burst_lens[i];
+        a.burst = malloc(sizeof(float complex) * a.len);
+        for (j = 0; j < a.len; ++j) {
+            if ((j & 1) == 0)
+                step = (rng() & 1 ? 1.f : -1.f) * (float)M_PI / 4 + 0.02f;
+            phase += step;
+            a.burst[j] = cexpf(I * phase) + ((int)(rng() & 0xff) - 128) / 2048.f;
+        }
+        run("fsk_demod", "samples", a.len, bench_fsk, &a, a.len);
+        free(a.burst);
+    }
+    fsk_demod_destroy(&a.fsk);
+}
+
+// the detectors get the demodulated bits, one per symbol
+typedef struct {
+    uint8_t *bits;
+    unsigned len;
+    unsigned found;
+} bits_arg_t;
+
+static void bench_btbb(void *p, unsigned iters) {
+    bits_arg_t *a = p;
+    unsigned i;
+    for (i = 0; i < iters; ++i)
+        a->found += btbb_find_ac((char *)a->bits, a->len, 1) != 0xffffffff;
+}
+
+static void bench_ble(void *p, unsigned iters) {
+    bits_arg_t *a = p;
+    struct timespec ts = { 0 };
+    unsigned i;
+    for (i = 0; i < iters; ++i) {
+        ble_packet_t *pkt = ble_burst(a->bits, a->len, 2402, ts);
+        a->found += pkt != NULL;
+        free(pkt);
+    }
+}
+
+static void bits_cases(const char *kernel, bench_fn fn) {
+    bits_arg_t a;
+    unsigned i, j;
+
+    for (i = 0; i < sizeof(burst_lens) / sizeof(burst_lens[0]); ++i) {
+        a.len = burst_lens[i] / 2;
+        a.bits = malloc(a.len);
+        a.found = 0;
+        // BLE preamble, so ble_burst goes on to try the access addresses
+        for (j = 0; j < a.len; ++j)
+            a.bits[j] = j < 8 ? j & 1 : rng() & 1;
+        run(kernel, "bits", a.len, fn, &a, a.len);
+        free(a.bits);
+    }
+}
+
+int main(int argc, char **argv) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jt:")) != -1) {
+        switch (opt) {
+            case 'j':
+                json = 1;
+                break;
+            case 't':
+                min_ms = strtoul(optarg, NULL, 0);
+                if (min_ms == 0)
+                    min_ms = 1;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-j] [-t ms] [kernel ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    only = &argv[optind];
+    num_only = argc - optind;
+
+    gen_syndrome_map(1);
+
+    if (wanted("window_dotprod"))
+        window_dotprod_cases();
+    if (wanted("pfbch2_execute"))
+        pfbch2_execute_cases();
+    if (wanted("fsk_demod"))
+        fsk_demod_cases();
+    if (wanted("btbb_find_ac"))
+        bits_cases("btbb_find_ac", bench_btbb);
+    if (wanted("ble_burst"))
+        bits_cases("ble_burst", bench_ble);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Throughput and hand-off latency of Blocking_Queue vs spsc_ring with one
+ * producer and one consumer, the shape of the samples queue.
+ *
+ * usage: bench_queue [items]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define C_FEK_BLOCKING_QUEUE_IMPLEMENTATION
+#define C_FEK_FAIR_LOCK_IMPLEMENTATION
+#include "blocking_queue.h"
+#include "spsc_ring.h"
+
+#define QUEUE_SIZE 1024
+#define LATENCY_ITEMS 100000
+#define LATENCY_GAP_NS 2000 // between sends, so latency isn't queueing delay
+
+typedef struct {
+    uint64_t sent;
+    uint64_t received;
+} item_t;
+
+typedef struct {
+    const char *name;
+    int (*init)(void *q, unsigned capacity);
+    int (*put)(void *q, void *elem);
+    int (*take)(void *q, void **elem);
+    void (*destroy)(void *q);
+} queue_ops_t;
+
+static int bq_init(void *q, unsigned capacity) { return blocking_queue_init(q, capacity); }
+static int bq_put(void *q, void *elem) { return blocking_queue_put(q, elem); }
+static int bq_take(void *q, void **elem) { return blocking_queue_take(q, elem); }
+static void bq_destroy(void *q) { blocking_queue_destroy(q); }
+
+static int spsc_init(void *q, unsigned capacity) { return spsc_ring_init(q, capacity); }
+static int spsc_put(void *q, void *elem) { return spsc_ring_put(q, elem); }
+static int spsc_take(void *q, void **elem) { return spsc_ring_take(q, elem); }
+static void spsc_destroy(void *q) { spsc_ring_destroy(q); }
+
+static const queue_ops_t queues[] = {
+    { "Blocking_Queue", bq_init, bq_put, bq_take, bq_destroy },
+    { "spsc_ring", spsc_init, spsc_put, spsc_take, spsc_destroy },
+};
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+typedef struct {
+    const queue_ops_t *ops;
+    void *q;
+    item_t *items;
+    unsigned num;
+    uint64_t gap_ns;
+} producer_arg_t;
+
+static void *producer(void *arg) {
+    producer_arg_t *p = (producer_arg_t *)arg;
+    uint64_t next = now_ns();
+    unsigned i;
+
+    for (i = 0; i < p->num; ++i) {
+        if (p->gap_ns) {
+            next += p->gap_ns;
+            while (now_ns() < next)
+                ;
+        }
+        p->items[i].sent = now_ns();
+        p->ops->put(p->q, &p->items[i]);
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const queue_ops_t *ops, unsigned num, uint64_t gap_ns) {
+    union { Blocking_Queue bq; spsc_ring_t spsc; } q;
+    item_t *items = calloc(num, sizeof(*items));
+    uint64_t *lat = malloc(sizeof(*lat) * num), start, elapsed;
+    producer_arg_t arg = { ops, &q, items, num, gap_ns };
+    pthread_t t;
+    unsigned i;
+
+    if (items == NULL || lat == NULL || ops->init(&q, QUEUE_SIZE) != 0) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    start = now_ns();
+    pthread_create(&t, NULL, producer, &arg);
+    for (i = 0; i < num; ++i) {
+        item_t *it;
+        ops->take(&q, (void **)&it);
+        it->received = now_ns();
+    }
+    elapsed = now_ns() - start;
+    pthread_join(t, NULL);
+
+    for (i = 0; i < num; ++i)
+        lat[i] = items[i].received - items[i].sent;
+    qsort(lat, num, sizeof(*lat), cmp_u64);
+
+    if (gap_ns == 0)
+        printf("%-15s throughput %7.2f Mitems/s\n", ops->name, num * 1e3 / elapsed);
+    else
+        printf("%-15s latency ns p50 %6lu p99 %6lu p99.9 %7lu max %8lu\n", ops->name,
+                (unsigned long)lat[num / 2], (unsigned long)lat[num * 99 / 100],
+                (unsigned long)lat[num * 999 / 1000], (unsigned long)lat[num - 1]);
+
+    ops->destroy(&q);
+    free(items);
+    free(lat);
+}
+
+int main(int argc, char **argv) {
+    unsigned num = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+    unsigned i;
+
+    for (i = 0; i < sizeof(queues) / sizeof(queues[0]); ++i)
+        run(&queues[i], num, 0);
+    for (i = 0; i < sizeof(queues) / sizeof(queues[0]); ++i)
+        run(&queues[i], LATENCY_ITEMS, LATENCY_GAP_NS);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Unit tests for burst_archive.c / burst_archive.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "burst_archive.h"
+
+#define NUM_BURSTS 100
+
+static void write_archive(const char *path) {
+    burst_archive_t *a = burst_archive_open(path, 2e6f);
+    unsigned i, j;
+
+    assert(a != NULL);
+    for (i = 0; i < NUM_BURSTS; ++i) {
+        unsigned len = 10 + i;
+        float complex *iq = malloc(sizeof(*iq) * len);
+        float *demod = malloc(sizeof(*demod) * len);
+        for (j = 0; j < len; ++j) {
+            iq[j] = i + j * I;
+            demod[j] = -(float)j;
+        }
+        burst_archive_entry_t e = {
+            .ts_sec = 1600000000 + i,
+            .ts_nsec = i * 1000,
+            .freq = 2402 + (i % 40) * 2,
+            .num = i,
+            .len = len,
+            .rssi_db = -50.0f,
+            .cfo = (float)i,
+            .lap = i % 2 ? 0x9e8b33 : 0xffffffff,
+            .aa = 0xffffffff,
+        };
+        assert(burst_archive_append(a, &e, iq, demod) == 0);
+        free(iq);
+        free(demod);
+    }
+    burst_archive_close(a);
+}
+
+static void check_archive(burst_archive_reader_t *r, size_t expected) {
+    size_t i, j;
+
+    assert(burst_archive_count(r) == expected);
+    assert(burst_archive_samp_rate(r) == 2e6f);
+    // random access, back to front
+    for (i = expected; i-- > 0; ) {
+        const burst_archive_entry_t *e = burst_archive_entry(r, i);
+        const float complex *iq = burst_archive_iq(r, i);
+        const float *demod = burst_archive_demod(r, i);
+        assert(e != NULL && iq != NULL && demod != NULL);
+        assert(e->num == i);
+        assert(e->len == 10 + i);
+        assert(e->ts_sec == 1600000000 + (int64_t)i);
+        assert(e->cfo == (float)i);
+        for (j = 0; j < e->len; ++j) {
+            assert(crealf(iq[j]) == (float)i && cimagf(iq[j]) == (float)j);
+            assert(demod[j] == -(float)j);
+        }
+    }
+    assert(burst_archive_entry(r, expected) == NULL);
+}
+
+static void test_burst_archive_roundtrip(void) {
+    const char *path = "test_bursts.bin";
+    burst_archive_reader_t *r;
+
+    write_archive(path);
+    r = burst_archive_map(path);
+    assert(r != NULL);
+    check_archive(r, NUM_BURSTS);
+    burst_archive_unmap(r);
+
+    remove(path);
+    printf("[PASS] test_burst_archive_roundtrip\n");
+}
+
+static void test_burst_archive_recover(void) {
+    const char *path = "test_bursts_truncated.bin";
+    burst_archive_reader_t *r;
+    FILE *f;
+    long size;
+
+    // lose the index and half of the last record, as if the writer died
+    write_archive(path);
+    f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    size -= sizeof(burst_archive_trailer_t) + NUM_BURSTS * sizeof(burst_archive_entry_t) + 16;
+    assert(truncate(path, size) == 0);
+
+    r = burst_archive_map(path);
+    assert(r != NULL);
+    check_archive(r, NUM_BURSTS - 1);
+    burst_archive_unmap(r);
+
+    remove(path);
+    printf("[PASS] test_burst_archive_recover\n");
+}
+
+// a trailer that still has its magic but doesn't describe the file is
+// ignored, and the records are walked instead
+static void corrupt(const char *path, long at, const void *data, size_t len) {
+    FILE *f = fopen(path, "r+b");
+    assert(f != NULL);
+    assert(fseek(f, at, at < 0 ? SEEK_END : SEEK_SET) == 0);
+    assert(fwrite(data, len, 1, f) == 1);
+    fclose(f);
+}
+
+static void test_burst_archive_bad_index(void) {
+    const char *path = "test_bursts_bad_index.bin";
+    const long trailer = -(long)sizeof(burst_archive_trailer_t);
+    const long last_entry = trailer - (long)sizeof(burst_archive_entry_t);
+    uint64_t huge = UINT64_MAX / 2, offset = 12345;
+    uint32_t len = 0x7fffffff;
+    burst_archive_reader_t *r;
+
+    // count large enough to wrap index_offset + count * entry size
+    write_archive(path);
+    corrupt(path, trailer + 8, &huge, sizeof(huge));
+    r = burst_archive_map(path);
+    assert(r != NULL);
+    check_archive(r, NUM_BURSTS);
+    burst_archive_unmap(r);
+
+    // an entry pointing somewhere else
+    write_archive(path);
+    corrupt(path, last_entry + offsetof(burst_archive_entry_t, offset), &offset, sizeof(offset));
+    r = burst_archive_map(path);
+    assert(r != NULL);
+    check_archive(r, NUM_BURSTS);
+    burst_archive_unmap(r);
+
+    // an entry running past the index
+    write_archive(path);
+    corrupt(path, last_entry + offsetof(burst_archive_entry_t, len), &len, sizeof(len));
+    r = burst_archive_map(path);
+    assert(r != NULL);
+    check_archive(r, NUM_BURSTS);
+    burst_archive_unmap(r);
+
+    remove(path);
+    printf("[PASS] test_burst_archive_bad_index\n");
+}
+
+static void test_burst_archive_bad_file(void) {
+    const char *path = "test_bursts_bad.bin";
+    FILE *f = fopen(path, "wb");
+    fprintf(f, "this is not a burst archive at all");
+    fclose(f);
+    assert(burst_archive_map(path) == NULL);
+    assert(burst_archive_map("does_not_exist.bin") == NULL);
+    remove(path);
+    printf("[PASS] test_burst_archive_bad_file\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running burst_archive.c Unit Tests        \n");
+    printf("===========================================\n");
+    test_burst_archive_roundtrip();
+    test_burst_archive_recover();
+    test_burst_archive_bad_index();
+    test_burst_archive_bad_file();
+    printf("===========================================\n");
+    printf(" All burst_archive tests passed!           \n");
+    printf("===========================================\n");
+    return 0;
+}
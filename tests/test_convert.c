@@ -0,0 +1,136 @@
+/*
+ * Unit tests for convert.c / convert.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "convert.h"
+
+// odd lengths so both the vector loop and the scalar tail get exercised
+#define N (1000 + 7)
+
+static int8_t ref_ci16(int16_t v, unsigned shift) {
+    int r = v >> shift;
+    return r > 127 ? 127 : r < -128 ? -128 : r;
+}
+
+static int8_t ref_cf32(float v, float scale) {
+    float r = nearbyintf(v * scale);
+    return r > 127.0f ? 127 : r < -128.0f ? -128 : (int8_t)r;
+}
+
+static void test_convert_ci16(void) {
+    int16_t *in = malloc(sizeof(*in) * N);
+    int8_t *out = malloc(N);
+    unsigned i, shift;
+
+    srand(1);
+    for (i = 0; i < N; ++i)
+        in[i] = (int16_t)(rand() & 0xffff);
+    in[0] = INT16_MAX;
+    in[1] = INT16_MIN;
+    in[2] = -1;
+
+    for (shift = 0; shift <= 8; shift += 4) {
+        convert_ci16_ci8(in, out, N, shift);
+        for (i = 0; i < N; ++i)
+            assert(out[i] == ref_ci16(in[i], shift));
+    }
+
+    // full scale ci16 lands on full scale ci8
+    convert_to_ci8(SAMPLE_FORMAT_CI16, in, out, 1);
+    assert(out[0] == 127 && out[1] == -128);
+
+    free(in);
+    free(out);
+    printf("[PASS] test_convert_ci16\n");
+}
+
+// bladeRF SC16_Q11: 12 significant bits, full scale +/-2048
+static void test_convert_sc16_q11(void) {
+    int16_t *in = malloc(sizeof(*in) * N);
+    int8_t *out = malloc(N);
+    unsigned i;
+
+    srand(3);
+    for (i = 0; i < N; ++i)
+        in[i] = (int16_t)(rand() % 4096 - 2048);
+    in[0] = 2047;
+    in[1] = -2048;
+    in[2] = 15;
+    in[3] = -16;
+    in[4] = 4000;  // out of range, as seen from a saturated ADC
+    in[5] = -4000;
+
+    convert_ci16_ci8(in, out, N, 4);
+    for (i = 0; i < N; ++i)
+        assert(out[i] == ref_ci16(in[i], 4));
+    assert(out[0] == 127 && out[1] == -128);
+    assert(out[2] == 0 && out[3] == -1);
+    assert(out[4] == 127 && out[5] == -128);
+
+    free(in);
+    free(out);
+    printf("[PASS] test_convert_sc16_q11\n");
+}
+
+static void test_convert_cf32(void) {
+    float *in = malloc(sizeof(*in) * N);
+    int8_t *out = malloc(N);
+    unsigned i;
+
+    srand(2);
+    for (i = 0; i < N; ++i)
+        in[i] = (rand() / (float)RAND_MAX) * 2.4f - 1.2f; // some clip
+    in[0] = 1.0f;
+    in[1] = -1.0f;
+    in[2] = 1e9f;
+    in[3] = -1e9f;
+    in[4] = 0.0f;
+
+    convert_cf32_ci8(in, out, N, 127.0f);
+    for (i = 0; i < N; ++i)
+        assert(out[i] == ref_cf32(in[i], 127.0f));
+    assert(out[0] == 127 && out[1] == -127);
+    assert(out[2] == 127 && out[3] == -128);
+    assert(out[4] == 0);
+
+    memset(out, 0, N);
+    convert_to_ci8(SAMPLE_FORMAT_CF32, in, out, 2);
+    assert(out[0] == 127 && out[1] == -127 && out[2] == 127 && out[3] == -128);
+
+    free(in);
+    free(out);
+    printf("[PASS] test_convert_cf32\n");
+}
+
+static void test_convert_ci8(void) {
+    int8_t in[8] = { 1, -2, 3, -4, 127, -128, 0, 5 }, out[8];
+
+    assert(sample_format_size(SAMPLE_FORMAT_CI8) == 2);
+    assert(sample_format_size(SAMPLE_FORMAT_CI16) == 4);
+    assert(sample_format_size(SAMPLE_FORMAT_CF32) == 8);
+
+    convert_to_ci8(SAMPLE_FORMAT_CI8, in, out, 4);
+    assert(memcmp(in, out, sizeof(in)) == 0);
+    printf("[PASS] test_convert_ci8\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running convert.c Unit Tests              \n");
+    printf("===========================================\n");
+    test_convert_ci16();
+    test_convert_sc16_q11();
+    test_convert_cf32();
+    test_convert_ci8();
+    printf("===========================================\n");
+    printf(" All convert tests passed successfully!    \n");
+    printf("===========================================\n");
+    return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Unit and Multithreaded Tests for metrics.c / metrics.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <locale.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+static char *snapshot_json(void) {
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&buf, &len);
+    assert(f != NULL);
+    metrics_write_json(f);
+    fclose(f);
+    return buf;
+}
+
+static void test_registry(void) {
+    static const char *const reasons[] = { "a", "b" };
+    metric_t *c, *g, *l, *ch;
+
+    c = metric_register("c", "a counter", METRIC_COUNTER, NULL, NULL, 1);
+    g = metric_register("g", "a gauge", METRIC_GAUGE, NULL, NULL, 1);
+    l = metric_register("l", "labelled", METRIC_COUNTER, "reason", reasons, 2);
+    ch = metric_register_channels("ch", "per channel", METRIC_COUNTER, 2426, 3);
+    assert(c && g && l && ch);
+    assert(metrics_count() == 4);
+    assert(metric_find("l") == l && metric_find("nope") == NULL);
+    assert(strcmp(ch->label, "channel") == 0 && strcmp(ch->label_values[2], "2430") == 0);
+
+    metric_add(c, 0, 5);
+    metric_inc(c, 0);
+    metric_set(g, 0, 2.5);
+    metric_inc(l, 1);
+    metric_set_count(ch, 1, 7);
+    assert(metric_count(c, 0) == 6);
+    assert(metric_gauge(g, 0) == 2.5);
+
+    char *json = snapshot_json();
+    assert(strstr(json, "\"c\":6,") != NULL);
+    assert(strstr(json, "\"g\":2.5,") != NULL);
+    assert(strstr(json, "\"l\":{\"a\":0,\"b\":1}") != NULL);
+    assert(strstr(json, "\"ch\":{\"2426\":0,\"2428\":7,\"2430\":0}}\n") != NULL);
+    free(json);
+
+    metrics_free();
+    assert(metrics_count() == 0);
+    printf("[PASS] test_registry\n");
+}
+
+static void test_histogram(void) {
+    uint64_t count, sum, buckets[METRIC_HIST_BUCKETS];
+    metric_t *h = metric_register("h", "a histogram", METRIC_HISTOGRAM, NULL, NULL, 1);
+
+    // bucket i is below 2^i
+    metric_observe(h, 0, 0);
+    metric_observe(h, 0, 1);
+    metric_observe(h, 0, 3);
+    metric_observe(h, 0, 3);
+    metric_observe(h, 0, 1ull << 40); // off the end, into the last bucket
+    metric_histogram(h, 0, &count, &sum, buckets);
+    assert(count == 5 && sum == 7 + (1ull << 40));
+    assert(buckets[0] == 1);
+    assert(buckets[1] == 1);
+    assert(buckets[2] == 2);
+    assert(buckets[METRIC_HIST_BUCKETS - 1] == 1);
+
+    metrics_free();
+    h = metric_register("h", "a histogram", METRIC_HISTOGRAM, NULL, NULL, 1);
+    metric_observe(h, 0, 3);
+    metric_observe(h, 0, 4);
+    char *json = snapshot_json();
+    // trailing empty buckets are left off
+    assert(strstr(json, "\"h\":{\"count\":2,\"sum\":7,\"buckets\":[0,0,1,1]}") != NULL);
+    free(json);
+
+    metrics_free();
+    printf("[PASS] test_histogram\n");
+}
+
+#define THREADS 4
+#define ADDS 100000
+
+static void *adder(void *arg) {
+    metric_t *m = (metric_t *)arg;
+    unsigned i;
+    for (i = 0; i < ADDS; ++i) {
+        metric_inc(m, 0);
+        metric_observe(m + 1, 0, i & 63);
+    }
+    return NULL;
+}
+
+// nothing lost with every thread hitting the same series, while a reader
+// adds them up
+static void test_concurrent(void) {
+    uint64_t count, sum, buckets[METRIC_HIST_BUCKETS];
+    pthread_t threads[THREADS];
+    metric_t *c, *h;
+    char *json;
+    unsigned i;
+
+    c = metric_register("c", "shared", METRIC_COUNTER, NULL, NULL, 1);
+    h = metric_register("h", "shared", METRIC_HISTOGRAM, NULL, NULL, 1);
+    assert(h == c + 1);
+    for (i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, adder, c);
+    json = snapshot_json();
+    free(json);
+    for (i = 0; i < THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    // summed over the threads' blocks, which outlive the threads
+    assert(metric_count(c, 0) == THREADS * ADDS);
+    metric_histogram(h, 0, &count, &sum, buckets);
+    assert(count == THREADS * ADDS);
+    for (i = 0; i < ADDS; ++i)
+        sum -= THREADS * (i & 63);
+    assert(sum == 0);
+
+    metrics_free();
+    printf("[PASS] test_concurrent\n");
+}
+
+static void test_prometheus(void) {
+    static const char *const reasons[] = { "a", "b" };
+    char *buf = NULL;
+    size_t len = 0;
+    metric_t *l, *h;
+    FILE *f;
+
+    l = metric_register("l", "labelled", METRIC_COUNTER, "reason", reasons, 2);
+    metric_register("g", "a gauge", METRIC_GAUGE, NULL, NULL, 1);
+    h = metric_register_channels("h", "per channel", METRIC_HISTOGRAM, 2402, 1);
+    metric_add(l, 1, 3);
+    metric_observe(h, 0, 1);
+    metric_observe(h, 0, 5);
+
+    f = open_memstream(&buf, &len);
+    metrics_write_prometheus(f);
+    fclose(f);
+
+    assert(strstr(buf, "# HELP ice9_l_total labelled\n# TYPE ice9_l_total counter\n") != NULL);
+    assert(strstr(buf, "ice9_l_total{reason=\"a\"} 0\nice9_l_total{reason=\"b\"} 3\n") != NULL);
+    assert(strstr(buf, "# TYPE ice9_g gauge\nice9_g 0\n") != NULL);
+    // cumulative, le is inclusive
+    assert(strstr(buf, "ice9_h_bucket{channel=\"2402\",le=\"0\"} 0\n") != NULL);
+    assert(strstr(buf, "ice9_h_bucket{channel=\"2402\",le=\"1\"} 1\n") != NULL);
+    assert(strstr(buf, "ice9_h_bucket{channel=\"2402\",le=\"7\"} 2\n") != NULL);
+    assert(strstr(buf, "ice9_h_bucket{channel=\"2402\",le=\"+Inf\"} 2\n") != NULL);
+    assert(strstr(buf, "ice9_h_sum{channel=\"2402\"} 6\nice9_h_count{channel=\"2402\"} 2\n") != NULL);
+    free(buf);
+
+    metrics_free();
+    printf("[PASS] test_prometheus\n");
+}
+
+// fractional gauges stay valid JSON and Prometheus text under a locale
+// with a decimal comma, when one is installed
+static void test_locale(void) {
+    static const char *const comma_locales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "de_DE" };
+    const char *used = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    metric_t *g;
+    unsigned i;
+    FILE *f;
+
+    g = metric_register("ratio", "a fraction", METRIC_GAUGE, NULL, NULL, 1);
+    metric_set(g, 0, 0.97);
+    for (i = 0; i < sizeof(comma_locales) / sizeof(comma_locales[0]) && used == NULL; ++i)
+        used = setlocale(LC_NUMERIC, comma_locales[i]);
+
+    buf = snapshot_json();
+    assert(strstr(buf, "\"ratio\":0.97}") != NULL);
+    free(buf);
+
+    f = open_memstream(&buf, &len);
+    metrics_write_prometheus(f);
+    fclose(f);
+    assert(strstr(buf, "ice9_ratio 0.97\n") != NULL);
+    free(buf);
+
+    // and the caller's locale is left as it was
+    if (used != NULL) {
+        char s[16];
+        snprintf(s, sizeof(s), "%g", 0.5);
+        assert(strcmp(s, "0,5") == 0);
+    }
+    setlocale(LC_NUMERIC, "C");
+
+    metrics_free();
+    printf("[PASS] test_locale%s\n", used ? "" : " (no decimal comma locale installed)");
+}
+
+static int updates = 0;
+static void update(void) {
+    __atomic_add_fetch(&updates, 1, __ATOMIC_RELAXED);
+}
+
+static void test_exporter(void) {
+    char path[64], file[64], buf[4096];
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    metric_t *c;
+    FILE *f;
+    ssize_t n, len = 0;
+    int fd, lines = 0;
+
+    snprintf(path, sizeof(path), "/tmp/test_metrics_%d.sock", (int)getpid());
+    snprintf(file, sizeof(file), "/tmp/test_metrics_%d.json", (int)getpid());
+    unlink(file);
+
+    c = metric_register("c", "a counter", METRIC_COUNTER, NULL, NULL, 1);
+    metric_add(c, 0, 42);
+    assert(metrics_start_exporter(file, path, 0, 20, update) == 0);
+
+    // one snapshot per connection
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    while ((n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+        len += n;
+    buf[len] = '\0';
+    close(fd);
+    assert(strstr(buf, "\"c\":42}\n") != NULL);
+
+    usleep(100000);
+    metrics_stop_exporter();
+    assert(access(path, F_OK) != 0);
+    assert(__atomic_load_n(&updates, __ATOMIC_RELAXED) >= 2);
+
+    // a line per interval, and one at the end
+    f = fopen(file, "r");
+    assert(f != NULL);
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        assert(strncmp(buf, "{\"time\":", 8) == 0 && strstr(buf, "\"c\":42}") != NULL);
+        ++lines;
+    }
+    fclose(f);
+    unlink(file);
+    assert(lines >= 2);
+
+    metrics_free();
+    printf("[PASS] test_exporter\n");
+}
+
+static void http_get(unsigned port, const char *req, char *buf, size_t size) {
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    ssize_t n, len = 0;
+    int fd;
+
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(write(fd, req, strlen(req)) == (ssize_t)strlen(req));
+    while ((n = read(fd, buf + len, size - 1 - len)) > 0)
+        len += n;
+    buf[len] = '\0';
+    close(fd);
+}
+
+static void test_http(void) {
+    char buf[4096];
+    unsigned port = 20000 + getpid() % 20000;
+    metric_t *c;
+
+    c = metric_register("c", "a counter", METRIC_COUNTER, NULL, NULL, 1);
+    metric_add(c, 0, 42);
+    while (metrics_start_exporter(NULL, NULL, port, 1000, NULL) != 0)
+        ++port;
+
+    http_get(port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", buf, sizeof(buf));
+    assert(strncmp(buf, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    assert(strstr(buf, "Content-Type: text/plain; version=0.0.4\r\n") != NULL);
+    assert(strstr(buf, "\r\n\r\n# HELP ice9_c_total a counter\n") != NULL);
+    assert(strstr(buf, "\nice9_c_total 42\n") != NULL);
+
+    http_get(port, "GET /other HTTP/1.1\r\n\r\n", buf, sizeof(buf));
+    assert(strncmp(buf, "HTTP/1.0 404", 12) == 0);
+
+    metrics_stop_exporter();
+    metrics_free();
+    printf("[PASS] test_http\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running metrics.c Unit Tests              \n");
+    printf("===========================================\n");
+    test_registry();
+    test_histogram();
+    test_concurrent();
+    test_prometheus();
+    test_locale();
+    test_exporter();
+    test_http();
+    printf("===========================================\n");
+    printf(" All metrics tests passed successfully!    \n");
+    printf("===========================================\n");
+    return 0;
+}
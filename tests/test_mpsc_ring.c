@@ -0,0 +1,242 @@
+/*
+ * Unit and Multithreaded Stress Tests for mpsc_ring.c / mpsc_ring.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "mpsc_ring.h"
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+    uint8_t pad[24]; // elements are copied by value, make them non-trivial
+} item_t;
+
+static void test_single_thread_fifo(void) {
+    mpsc_ring_t r;
+    item_t in = { 0 }, out;
+    unsigned i;
+
+    assert(mpsc_ring_init(&r, 3, sizeof(item_t)) == 0);
+    // capacity rounds up to a power of two
+    assert(r.mask == 3);
+
+    assert(mpsc_ring_pop(&r, &out) == -1);
+
+    for (i = 0; i < 4; ++i) {
+        in.seq = i;
+        assert(mpsc_ring_push(&r, &in) == 0);
+    }
+    assert(mpsc_ring_size(&r) == 4);
+    assert(mpsc_ring_push(&r, &in) == -1);
+
+    for (i = 0; i < 4; ++i) {
+        assert(mpsc_ring_pop(&r, &out) == 0);
+        assert(out.seq == i);
+    }
+    assert(mpsc_ring_pop(&r, &out) == -1);
+
+    // wrap around several laps
+    for (i = 0; i < 100; ++i) {
+        in.seq = i;
+        assert(mpsc_ring_push(&r, &in) == 0);
+        assert(mpsc_ring_pop(&r, &out) == 0);
+        assert(out.seq == i);
+    }
+
+    mpsc_ring_destroy(&r);
+    printf("[PASS] test_single_thread_fifo\n");
+}
+
+#define NUM_PRODUCERS 4
+#define ITEMS_PER_PRODUCER 10000
+
+typedef struct {
+    mpsc_ring_t *r;
+    uint32_t id;
+    int evict; // drop the oldest entry instead of spinning when full
+} producer_arg_t;
+
+static int finished = 0;
+
+static void *producer_worker(void *arg) {
+    producer_arg_t *p = (producer_arg_t *)arg;
+    item_t it = { .producer = p->id }, junk;
+    uint32_t i;
+
+    for (i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        it.seq = i;
+        while (mpsc_ring_push(p->r, &it) != 0) {
+            if (p->evict)
+                mpsc_ring_pop(p->r, &junk);
+            else
+                sched_yield();
+        }
+    }
+    __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void run_producers(int evict) {
+    mpsc_ring_t r;
+    pthread_t threads[NUM_PRODUCERS];
+    producer_arg_t args[NUM_PRODUCERS];
+    int64_t last[NUM_PRODUCERS];
+    unsigned received = 0;
+    item_t it;
+    int i;
+
+    assert(mpsc_ring_init(&r, 64, sizeof(item_t)) == 0);
+    finished = 0;
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        last[i] = -1;
+        args[i].r = &r;
+        args[i].id = i;
+        args[i].evict = evict;
+        pthread_create(&threads[i], NULL, producer_worker, &args[i]);
+    }
+
+    for (;;) {
+        if (mpsc_ring_pop(&r, &it) != 0) {
+            if (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) == NUM_PRODUCERS && mpsc_ring_size(&r) == 0)
+                break;
+            sched_yield();
+            continue;
+        }
+        assert(it.producer < NUM_PRODUCERS);
+        // per-producer order is preserved, gaps only when evicting
+        if (evict)
+            assert((int64_t)it.seq > last[it.producer]);
+        else
+            assert((int64_t)it.seq == last[it.producer] + 1);
+        last[it.producer] = it.seq;
+        ++received;
+    }
+
+    for (i = 0; i < NUM_PRODUCERS; ++i)
+        pthread_join(threads[i], NULL);
+
+    if (!evict)
+        assert(received == NUM_PRODUCERS * ITEMS_PER_PRODUCER);
+    else
+        assert(received <= NUM_PRODUCERS * ITEMS_PER_PRODUCER);
+
+    mpsc_ring_destroy(&r);
+}
+
+static void test_multithreaded_producers(void) {
+    run_producers(0);
+    printf("[PASS] test_multithreaded_producers (%d items across %d P)\n",
+           NUM_PRODUCERS * ITEMS_PER_PRODUCER, NUM_PRODUCERS);
+}
+
+static void test_multithreaded_drop_oldest(void) {
+    run_producers(1);
+    printf("[PASS] test_multithreaded_drop_oldest\n");
+}
+
+static void test_pop_batch(void) {
+    mpsc_ring_t r;
+    item_t in = { 0 }, out[8];
+    unsigned i;
+
+    assert(mpsc_ring_init(&r, 8, sizeof(item_t)) == 0);
+    assert(mpsc_ring_pop_batch(&r, out, 8) == 0);
+
+    for (i = 0; i < 6; ++i) {
+        in.seq = i;
+        assert(mpsc_ring_push(&r, &in) == 0);
+    }
+    // no more than asked for, no more than there is
+    assert(mpsc_ring_pop_batch(&r, out, 4) == 4);
+    for (i = 0; i < 4; ++i)
+        assert(out[i].seq == i);
+    assert(mpsc_ring_pop_batch(&r, out, 8) == 2);
+    assert(out[0].seq == 4 && out[1].seq == 5);
+
+    // across the wrap
+    for (i = 0; i < 8; ++i) {
+        in.seq = 10 + i;
+        assert(mpsc_ring_push(&r, &in) == 0);
+    }
+    assert(mpsc_ring_pop_batch(&r, out, 8) == 8);
+    for (i = 0; i < 8; ++i)
+        assert(out[i].seq == 10 + i);
+
+    mpsc_ring_destroy(&r);
+    printf("[PASS] test_pop_batch\n");
+}
+
+static void *put_worker(void *arg) {
+    producer_arg_t *p = (producer_arg_t *)arg;
+    item_t it = { .producer = p->id };
+    uint32_t i;
+
+    for (i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        it.seq = i;
+        assert(mpsc_ring_put(p->r, &it) == 0);
+    }
+    return NULL;
+}
+
+// a small ring keeps producers and consumer falling asleep on each other
+static void test_blocking_put_take(void) {
+    mpsc_ring_t r;
+    pthread_t threads[NUM_PRODUCERS];
+    producer_arg_t args[NUM_PRODUCERS];
+    int64_t last[NUM_PRODUCERS];
+    unsigned received = 0;
+    item_t out[8];
+    int i, n;
+
+    assert(mpsc_ring_init(&r, 4, sizeof(item_t)) == 0);
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        last[i] = -1;
+        args[i].r = &r;
+        args[i].id = i;
+        args[i].evict = 0;
+        pthread_create(&threads[i], NULL, put_worker, &args[i]);
+    }
+
+    while (received < NUM_PRODUCERS * ITEMS_PER_PRODUCER) {
+        n = mpsc_ring_take(&r, out, 8);
+        assert(n > 0 && n <= 4);
+        for (i = 0; i < n; ++i) {
+            assert((int64_t)out[i].seq == last[out[i].producer] + 1);
+            last[out[i].producer] = out[i].seq;
+        }
+        received += n;
+    }
+
+    for (i = 0; i < NUM_PRODUCERS; ++i)
+        pthread_join(threads[i], NULL);
+
+    // close fails take on an empty ring rather than sleeping forever
+    mpsc_ring_close(&r);
+    assert(mpsc_ring_take(&r, out, 8) == -1);
+    assert(mpsc_ring_put(&r, &out[0]) == -1);
+
+    mpsc_ring_destroy(&r);
+    printf("[PASS] test_blocking_put_take\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running mpsc_ring.c Unit Tests            \n");
+    printf("===========================================\n");
+    test_single_thread_fifo();
+    test_multithreaded_producers();
+    test_multithreaded_drop_oldest();
+    test_pop_batch();
+    test_blocking_put_take();
+    printf("===========================================\n");
+    printf(" All mpsc_ring tests passed successfully!  \n");
+    printf("===========================================\n");
+    return 0;
+}
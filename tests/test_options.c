@@ -6,9 +6,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 
 #include "options.h"
+#include "realtime.h"
 
 // stub functions
 void usage(int exitcode) { (void)exitcode; }
@@ -138,6 +140,307 @@ static void test_dump_options_invalid(void) {
     printf("[PASS] test_dump_options_invalid\n");
 }
 
+static void test_pcap_policy(void) {
+    sniffer_config_t cfg;
+    char *argv1[] = { "ice9-bluetooth", "-a", "--capture", NULL };
+    int res = parse_options(3, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_policy == PCAP_POLICY_BLOCK);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "-a", "--pcap-policy", "drop-oldest", "--capture", NULL };
+    res = parse_options(5, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_policy == PCAP_POLICY_DROP_OLDEST);
+    config_free(&cfg);
+
+    char *argv3[] = { "ice9-bluetooth", "-a", "--pcap-policy", "sometimes", "--capture", NULL };
+    res = parse_options(5, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+    printf("[PASS] test_pcap_policy\n");
+}
+
+static void test_pcap_format(void) {
+    sniffer_config_t cfg;
+    char *argv1[] = { "ice9-bluetooth", "-a", "-w", "test_options.pcap", "--capture", NULL };
+    int res = parse_options(5, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap != NULL);
+    assert(cfg.pcap_format == PCAP_FORMAT_PCAP);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "-a", "-w", "test_options.pcap", "--pcapng", "--capture", NULL };
+    res = parse_options(6, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_format == PCAP_FORMAT_PCAPNG);
+    config_free(&cfg);
+    remove("test_options.pcap");
+
+    char *argv3[] = { "ice9-bluetooth", "-a", "-w", "test_options.pcapng", "--capture", NULL };
+    res = parse_options(5, argv3, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_format == PCAP_FORMAT_PCAPNG);
+    config_free(&cfg);
+    remove("test_options.pcapng");
+
+    // the policy is independent of the format, either order
+    char *argv4[] = { "ice9-bluetooth", "-a", "-w", "test_options.pcap", "--pcapng", "--pcap-policy=block", "--capture", NULL };
+    res = parse_options(7, argv4, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_format == PCAP_FORMAT_PCAPNG && cfg.pcap_policy == PCAP_POLICY_BLOCK);
+    config_free(&cfg);
+
+    char *argv5[] = { "ice9-bluetooth", "-a", "-w", "test_options.pcap", "--pcap-policy=block", "--pcapng", "--capture", NULL };
+    res = parse_options(7, argv5, &cfg);
+    assert(res == 0);
+    assert(cfg.pcap_format == PCAP_FORMAT_PCAPNG);
+    config_free(&cfg);
+    remove("test_options.pcap");
+    printf("[PASS] test_pcap_format\n");
+}
+
+static void test_sigmf_input(void) {
+    sniffer_config_t cfg;
+    int8_t samples[8] = { 0 };
+    sigmf_writer_t *w = sigmf_open("test_options.sigmf-data", 20e6, 2427e6);
+    assert(w != NULL);
+    sigmf_write(w, samples, 4, 2, NULL);
+    sigmf_close(w);
+
+    // rate and frequency come from the metadata
+    char *argv1[] = { "ice9-bluetooth", "-f", "test_options.sigmf-meta", NULL };
+    int res = parse_options(3, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.in != NULL);
+    assert(cfg.center_freq == 2427);
+    assert(cfg.channels == 20);
+    config_free(&cfg);
+
+    // unless given on the command line
+    char *argv2[] = { "ice9-bluetooth", "-f", "test_options.sigmf-data", "-c", "2440", NULL };
+    res = parse_options(5, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.center_freq == 2440);
+    assert(cfg.channels == 20);
+    assert(cfg.in_format == SAMPLE_FORMAT_CI8);
+    config_free(&cfg);
+
+    // the sample format comes along too
+    w = sigmf_open("test_options.sigmf-data", 20e6, 2427e6);
+    assert(w != NULL);
+    sigmf_write(w, samples, 1, 8, NULL);
+    sigmf_close(w);
+    res = parse_options(3, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.in_format == SAMPLE_FORMAT_CF32);
+    config_free(&cfg);
+
+    remove("test_options.sigmf-data");
+    remove("test_options.sigmf-meta");
+    printf("[PASS] test_sigmf_input\n");
+}
+
+// bursts are timed from the recording only when it says when it started,
+// anything else is stamped with real time, never from 1970
+static void test_input_epoch(void) {
+    sniffer_config_t cfg;
+    int8_t samples[8] = { 0 };
+    struct timespec recorded = { 1700000000, 500000000 };
+    time_t now = time(NULL);
+
+    char *argv1[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", NULL };
+    int res = parse_options(7, argv1, &cfg);
+    assert(res == 0);
+    assert(!cfg.in_epoch_known);
+    assert(cfg.in_epoch.tv_sec >= now && cfg.in_epoch.tv_sec <= now + 5);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "--synth", "-C", "4", "-c", "2426", NULL };
+    res = parse_options(6, argv2, &cfg);
+    assert(res == 0);
+    assert(!cfg.in_epoch_known && cfg.in_epoch.tv_sec >= now);
+    config_free(&cfg);
+
+    // SigMF without core:datetime
+    sigmf_writer_t *w = sigmf_open("test_options.sigmf-data", 20e6, 2427e6);
+    assert(w != NULL);
+    sigmf_write(w, samples, 4, 2, NULL);
+    sigmf_close(w);
+    char *argv3[] = { "ice9-bluetooth", "-f", "test_options.sigmf-meta", NULL };
+    res = parse_options(3, argv3, &cfg);
+    assert(res == 0);
+    assert(!cfg.in_epoch_known && cfg.in_epoch.tv_sec >= now);
+    config_free(&cfg);
+
+    // and with it
+    w = sigmf_open("test_options.sigmf-data", 20e6, 2427e6);
+    assert(w != NULL);
+    sigmf_write(w, samples, 4, 2, &recorded);
+    sigmf_close(w);
+    res = parse_options(3, argv3, &cfg);
+    assert(res == 0);
+    assert(cfg.in_epoch_known);
+    // stamped at the end of the buffer, 4 samples at 20 MHz
+    assert(cfg.in_epoch.tv_sec == recorded.tv_sec && cfg.in_epoch.tv_nsec == recorded.tv_nsec - 200);
+    config_free(&cfg);
+
+    remove("test_options.sigmf-data");
+    remove("test_options.sigmf-meta");
+    printf("[PASS] test_input_epoch\n");
+}
+
+static void test_input_format(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--format=ci16", NULL };
+    int res = parse_options(8, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.in_format == SAMPLE_FORMAT_CI16);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--format=cu8", NULL };
+    res = parse_options(8, argv2, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    // only means something for files
+    char *argv3[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--format=cf32", NULL };
+    res = parse_options(7, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    printf("[PASS] test_input_format\n");
+}
+
+static void test_cpus(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--cpus=2-4,7", NULL };
+    int res = parse_options(8, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.placement == PLACEMENT_LIST);
+    assert(cfg.num_cpus == 4);
+    assert(cfg.cpus[0] == 2 && cfg.cpus[2] == 4 && cfg.cpus[3] == 7);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--cpus=auto", NULL };
+    res = parse_options(8, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.placement == PLACEMENT_AUTO);
+    config_free(&cfg);
+
+    char *argv3[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--cpus=3-1", NULL };
+    res = parse_options(8, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    // every shard would pile onto the same cpus
+    char *argv4[] = { "ice9-bluetooth", "-f", "/dev/null", "-C", "4", "-c", "2426", "--cpus=auto", "--jobs=2", NULL };
+    res = parse_options(9, argv4, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    printf("[PASS] test_cpus\n");
+}
+
+static void test_rt(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--rt", NULL };
+    int res = parse_options(7, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.rt_priority == RT_DEFAULT_PRIORITY);
+    config_free(&cfg);
+
+    char *argv2[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--rt=80", NULL };
+    res = parse_options(7, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.rt_priority == 80);
+    config_free(&cfg);
+
+    // no room below it for the channelizer
+    char *argv3[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--rt=1", NULL };
+    res = parse_options(7, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    printf("[PASS] test_rt\n");
+}
+
+static void test_metrics(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--metrics=-", "--metrics-socket=/tmp/m.sock", NULL };
+    int res = parse_options(8, argv1, &cfg);
+    assert(res == 0);
+    assert(strcmp(cfg.metrics_path, "-") == 0);
+    assert(strcmp(cfg.metrics_socket_path, "/tmp/m.sock") == 0);
+    config_free(&cfg);
+    assert(cfg.metrics_path == NULL && cfg.metrics_socket_path == NULL);
+
+    char *argv2[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--metrics-port=9100", NULL };
+    res = parse_options(7, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.metrics_port == 9100);
+    config_free(&cfg);
+
+    char *argv3[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--metrics-port=70000", NULL };
+    res = parse_options(7, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    printf("[PASS] test_metrics\n");
+}
+
+static void test_trace(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "-l", "-C", "4", "-c", "2426", "--trace=/tmp/t.json", NULL };
+    int res = parse_options(7, argv1, &cfg);
+#ifdef USE_TRACE
+    assert(res == 0);
+    assert(strcmp(cfg.trace_path, "/tmp/t.json") == 0);
+#else
+    assert(res == -1);
+#endif
+    config_free(&cfg);
+    assert(cfg.trace_path == NULL);
+
+    printf("[PASS] test_trace\n");
+}
+
+static void test_synth(void) {
+    sniffer_config_t cfg;
+
+    char *argv1[] = { "ice9-bluetooth", "--synth", "-C", "20", "-c", "2426", NULL };
+    int res = parse_options(6, argv1, &cfg);
+    assert(res == 0);
+    assert(cfg.synth != NULL && cfg.synth->rate == 100.0f);
+    assert(cfg.in == NULL && !cfg.live);
+    config_free(&cfg);
+    assert(cfg.synth == NULL);
+
+    char *argv2[] = { "ice9-bluetooth", "--synth=rate=500,mix=adv", "--replay=2", "-C", "20", "-c", "2426", NULL };
+    res = parse_options(7, argv2, &cfg);
+    assert(res == 0);
+    assert(cfg.synth->rate == 500.0f && cfg.synth->mix == SYNTH_MIX_ADV && cfg.replay == 2.0f);
+    config_free(&cfg);
+
+    // one input at a time
+    char *argv3[] = { "ice9-bluetooth", "--synth", "-l", "-C", "20", "-c", "2426", NULL };
+    res = parse_options(7, argv3, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    char *argv4[] = { "ice9-bluetooth", "--synth=rate=-1", "-C", "20", "-c", "2426", NULL };
+    res = parse_options(6, argv4, &cfg);
+    assert(res == -1);
+    config_free(&cfg);
+
+    printf("[PASS] test_synth\n");
+}
+
 int main(void) {
     printf("===========================================\n");
     printf(" Running options.c Unit Tests              \n");
@@ -150,6 +453,16 @@ int main(void) {
     test_dump_options_valid();
     test_dump_options_invalid();
     test_extcap_interfaces_flag();
+    test_pcap_policy();
+    test_pcap_format();
+    test_sigmf_input();
+    test_input_epoch();
+    test_input_format();
+    test_cpus();
+    test_rt();
+    test_metrics();
+    test_trace();
+    test_synth();
     printf("===========================================\n");
     printf(" All options tests passed successfully!    \n");
     printf("===========================================\n");
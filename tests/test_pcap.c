@@ -8,6 +8,9 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "pcap.h"
 
@@ -39,7 +42,7 @@ typedef struct __attribute__((packed)) {
 
 static void test_pcap_write_and_parse(void) {
     const char *test_file = "test_output.pcap";
-    pcap_t *p = pcap_open((char*)test_file);
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
     assert(p != NULL);
 
     ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 4);
@@ -93,11 +96,516 @@ static void test_pcap_write_and_parse(void) {
     printf("[PASS] test_pcap_write_and_parse\n");
 }
 
+static void test_pcap_many_packets(void) {
+    const char *test_file = "test_output_many.pcap";
+    const unsigned num_packets = 50000; // enough to wrap the write buffer
+    unsigned i;
+
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
+    assert(p != NULL);
+
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 8);
+    memset(pkt, 0, sizeof(*pkt) + 8);
+    pkt->freq = 2426;
+    pkt->len = 8;
+    for (i = 0; i < num_packets; ++i) {
+        pkt->timestamp.tv_sec = i;
+        memcpy(pkt->data, &i, sizeof(i));
+        pcap_write_ble(p, pkt);
+    }
+
+    // flushing makes everything so far visible without closing
+    pcap_flush(p);
+    FILE *f = fopen(test_file, "rb");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long expected = sizeof(expected_pcap_hdr_t) +
+        num_packets * (sizeof(expected_pcaprec_hdr_t) + sizeof(expected_pcap_le_header_t) + 8);
+    assert(ftell(f) == expected);
+    fclose(f);
+
+    free(pkt);
+    pcap_close(p);
+
+    // every record is intact and in order
+    f = fopen(test_file, "rb");
+    assert(f != NULL);
+    expected_pcap_hdr_t hdr;
+    assert(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    for (i = 0; i < num_packets; ++i) {
+        expected_pcaprec_hdr_t rechdr;
+        expected_pcap_le_header_t le_hdr;
+        unsigned seq = 0;
+        uint8_t payload[8];
+        assert(fread(&rechdr, sizeof(rechdr), 1, f) == 1);
+        assert(rechdr.ts_sec == i);
+        assert(rechdr.incl_len == 8 + sizeof(le_hdr));
+        assert(fread(&le_hdr, sizeof(le_hdr), 1, f) == 1);
+        assert(le_hdr.rf_channel == 12);
+        assert(fread(payload, 1, 8, f) == 8);
+        memcpy(&seq, payload, sizeof(seq));
+        assert(seq == i);
+    }
+    assert(fgetc(f) == EOF);
+
+    fclose(f);
+    remove(test_file);
+    printf("[PASS] test_pcap_many_packets\n");
+}
+
+static unsigned count_records(const char *path) {
+    FILE *f = fopen(path, "rb");
+    expected_pcap_hdr_t hdr;
+    expected_pcaprec_hdr_t rechdr;
+    unsigned n = 0;
+
+    assert(f != NULL);
+    assert(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    while (fread(&rechdr, sizeof(rechdr), 1, f) == 1) {
+        assert(fseek(f, rechdr.incl_len, SEEK_CUR) == 0);
+        ++n;
+    }
+    fclose(f);
+    return n;
+}
+
+static void test_pcap_async_writer(pcap_policy_t policy, unsigned ring_size) {
+    const char *test_file = "test_output_async.pcap";
+    const unsigned num_packets = 20000;
+    pcap_stats_t stats;
+    unsigned i, accepted = 0;
+
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
+    assert(p != NULL);
+    assert(pcap_start_writer(p, policy, ring_size) == 0);
+
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 8);
+    memset(pkt, 0, sizeof(*pkt) + 8);
+    pkt->freq = 2480;
+    pkt->len = 8;
+    for (i = 0; i < num_packets; ++i) {
+        pkt->timestamp.tv_sec = i;
+        if (pcap_write_ble(p, pkt) == 0)
+            ++accepted;
+    }
+    free(pkt);
+
+    pcap_get_stats(p, &stats);
+    assert(stats.dropped_newest == num_packets - accepted);
+    pcap_close(p);
+
+    unsigned written = count_records(test_file);
+    switch (policy) {
+        case PCAP_POLICY_BLOCK:
+            assert(accepted == num_packets);
+            assert(written == num_packets);
+            break;
+        case PCAP_POLICY_DROP_NEWEST:
+            assert(written == accepted);
+            break;
+        case PCAP_POLICY_DROP_OLDEST:
+            assert(accepted == num_packets);
+            // only producers evict, so this count is final already
+            assert(written + stats.dropped_oldest == num_packets);
+            break;
+    }
+
+    remove(test_file);
+}
+
+static void test_pcap_async_policies(void) {
+    test_pcap_async_writer(PCAP_POLICY_BLOCK, 4);
+    test_pcap_async_writer(PCAP_POLICY_DROP_NEWEST, 4);
+    test_pcap_async_writer(PCAP_POLICY_DROP_OLDEST, 4);
+    test_pcap_async_writer(PCAP_POLICY_BLOCK, 4096);
+    printf("[PASS] test_pcap_async_policies\n");
+}
+
+static uint8_t *read_file(const char *path, long *len) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(*len);
+    assert(fread(buf, 1, *len, f) == (size_t)*len);
+    fclose(f);
+    return buf;
+}
+
+// find an option in a block's option area, returns NULL if not present
+static const uint8_t *find_option(const uint8_t *opts, const uint8_t *end, uint16_t code) {
+    while (opts + 4 <= end) {
+        uint16_t c, l;
+        memcpy(&c, opts, 2);
+        memcpy(&l, opts + 2, 2);
+        if (c == 0)
+            return NULL;
+        if (c == code)
+            return opts + 4;
+        opts += 4 + ((l + 3) & ~3);
+    }
+    return NULL;
+}
+
+static void test_pcapng_write_and_parse(void) {
+    const char *test_file = "test_output.pcapng";
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAPNG);
+    assert(p != NULL);
+
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 4);
+    memset(pkt, 0, sizeof(*pkt) + 4);
+    pkt->len = 4;
+    pkt->rssi_db = -40;
+    pkt->noise_db = -80;
+    pkt->cfo = -12500.4f;
+    pkt->deviation = 249999.6f;
+    pkt->timestamp.tv_sec = 1600000000;
+    pkt->timestamp.tv_nsec = 123456789;
+
+    // two packets on one channel share an interface, a third adds one
+    pkt->freq = 2402;
+    pcap_write_ble(p, pkt);
+    pcap_write_ble(p, pkt);
+    pkt->freq = 2426;
+    pcap_write_ble(p, pkt);
+    free(pkt);
+
+    br_packet_t br = {
+        .lap = 0x9e8b33,
+        .rssi_db = -60,
+        .noise_db = -85,
+        .freq = 2402,
+        .timestamp = { .tv_sec = 1600000001, .tv_nsec = 1 },
+    };
+    pcap_write_br(p, &br);
+    pcap_close(p);
+
+    long len;
+    uint8_t *buf = read_file(test_file, &len);
+    long off = 0;
+    unsigned blocks = 0, idbs = 0, epbs = 0;
+    uint16_t linktypes[8];
+    uint32_t ifaces[8];
+
+    while (off < len) {
+        uint32_t type, total, trailer;
+        memcpy(&type, buf + off, 4);
+        memcpy(&total, buf + off + 4, 4);
+        assert(total % 4 == 0 && off + total <= len);
+        memcpy(&trailer, buf + off + total - 4, 4);
+        assert(trailer == total);
+
+        const uint8_t *body = buf + off + 8, *end = buf + off + total - 4;
+        if (blocks == 0) {
+            uint32_t magic;
+            assert(type == 0x0a0d0d0a);
+            memcpy(&magic, body, 4);
+            assert(magic == 0x1a2b3c4d);
+        } else if (type == 1) {
+            assert(idbs < 8);
+            memcpy(&linktypes[idbs], body, 2);
+            const uint8_t *tsresol = find_option(body + 8, end, 9);
+            assert(tsresol != NULL && *tsresol == 9);
+            assert(find_option(body + 8, end, 2) != NULL);
+            ++idbs;
+        } else {
+            uint32_t hdr[5];
+            assert(type == 6);
+            assert(epbs < 8);
+            memcpy(hdr, body, sizeof(hdr));
+            assert(hdr[0] < idbs); // IDB precedes first use
+            ifaces[epbs] = hdr[0];
+
+            uint64_t ts = ((uint64_t)hdr[1] << 32) | hdr[2];
+            if (linktypes[hdr[0]] == 256) {
+                assert(ts == 1600000000123456789ull);
+                assert(hdr[3] == 4 + sizeof(expected_pcap_le_header_t));
+                const char *comment = (const char *)find_option(body + 20 + ((hdr[3] + 3) & ~3), end, 1);
+                assert(comment != NULL && strncmp(comment, "cfo_hz=-12500 deviation_hz=250000", 33) == 0);
+            } else {
+                uint32_t lap;
+                assert(linktypes[hdr[0]] == 255);
+                assert(ts == 1600000001000000001ull);
+                assert(body[20] == 0); // rf_channel
+                assert((int8_t)body[21] == -60);
+                memcpy(&lap, body + 20 + 8, 4);
+                assert(lap == 0x9e8b33);
+            }
+            ++epbs;
+        }
+        ++blocks;
+        off += total;
+    }
+
+    assert(idbs == 3);
+    assert(epbs == 4);
+    assert(ifaces[0] == ifaces[1]);
+    assert(ifaces[2] != ifaces[0]);
+    assert(ifaces[3] != ifaces[0] && ifaces[3] != ifaces[2]);
+
+    free(buf);
+    remove(test_file);
+
+    // classic pcap cannot carry BR/EDR, those are skipped
+    p = pcap_open((char*)"test_output_br.pcap", PCAP_FORMAT_PCAP);
+    assert(p != NULL);
+    assert(pcap_write_br(p, &br) == 0);
+    pcap_close(p);
+    assert(count_records("test_output_br.pcap") == 0);
+    remove("test_output_br.pcap");
+
+    printf("[PASS] test_pcapng_write_and_parse\n");
+}
+
+static void test_pcap_rotation(void) {
+    char dir[] = "/tmp/test_pcap_rotateXXXXXX";
+    char path[64], name[320];
+    pcap_rotate_t rotate = { .max_packets = 3, .max_files = 2 };
+    unsigned i, files = 0, total = 0;
+    struct dirent *de;
+    DIR *d;
+
+    assert(mkdtemp(dir) != NULL);
+    snprintf(path, sizeof(path), "%s/cap.pcap", dir);
+    pcap_t *p = pcap_open_rotating(path, PCAP_FORMAT_PCAP, &rotate);
+    assert(p != NULL);
+    assert(pcap_start_writer(p, PCAP_POLICY_BLOCK, 16) == 0);
+
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 8);
+    memset(pkt, 0, sizeof(*pkt) + 8);
+    pkt->freq = 2402;
+    pkt->len = 8;
+    for (i = 0; i < 10; ++i)
+        assert(pcap_write_ble(p, pkt) == 0);
+    free(pkt);
+    pcap_close(p);
+
+    // 3 + 3 + 3 + 1 packets, only the newest two files are kept
+    d = opendir(dir);
+    assert(d != NULL);
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        assert(strncmp(de->d_name, "cap_0000", 8) == 0);
+        assert(strcmp(de->d_name + strlen(de->d_name) - 5, ".pcap") == 0);
+        assert(de->d_name[8] == '3' || de->d_name[8] == '4');
+        snprintf(name, sizeof(name), "%s/%s", dir, de->d_name);
+        total += count_records(name);
+        remove(name);
+        ++files;
+    }
+    closedir(d);
+    assert(files == 2);
+    assert(total == 4);
+
+    // preallocated space is given back on close
+    struct stat st;
+    rotate = (pcap_rotate_t){ .max_bytes = 1000000 };
+    p = pcap_open_rotating(path, PCAP_FORMAT_PCAP, &rotate);
+    assert(p != NULL);
+    pcap_close(p);
+    d = opendir(dir);
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(name, sizeof(name), "%s/%s", dir, de->d_name);
+        assert(stat(name, &st) == 0);
+        assert(st.st_size == sizeof(expected_pcap_hdr_t));
+        assert(st.st_blocks * 512 < 1000000);
+        remove(name);
+    }
+    closedir(d);
+    rmdir(dir);
+
+    printf("[PASS] test_pcap_rotation\n");
+}
+
+static void write_spool(const char *path, const unsigned *secs, unsigned n) {
+    pcap_t *p = pcap_open((char*)path, PCAP_FORMAT_SPOOL);
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 4);
+    unsigned i;
+
+    assert(p != NULL);
+    memset(pkt, 0, sizeof(*pkt) + 4);
+    pkt->freq = 2402;
+    pkt->len = 4;
+    for (i = 0; i < n; ++i) {
+        pkt->timestamp.tv_sec = secs[i];
+        memcpy(pkt->data, &secs[i], sizeof(secs[i]));
+        pcap_write_ble(p, pkt);
+    }
+    free(pkt);
+    pcap_close(p);
+}
+
+static void test_pcap_merge(void) {
+    // two overlapping shards, both decoded the packets at 5 and 6
+    const unsigned a[] = { 1, 3, 5, 6 }, b[] = { 5, 6, 7, 9, 10 };
+    const unsigned expected[] = { 1, 3, 5, 6, 7, 9, 10 };
+    char *spools[] = { "test_spool_0.bin", "test_spool_1.bin" };
+    const char *test_file = "test_output_merged.pcap";
+    unsigned i;
+
+    write_spool(spools[0], a, sizeof(a) / sizeof(a[0]));
+    write_spool(spools[1], b, sizeof(b) / sizeof(b[0]));
+
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
+    assert(p != NULL);
+    assert(pcap_merge(p, spools, 2) == 0);
+    pcap_close(p);
+
+    FILE *f = fopen(test_file, "rb");
+    assert(f != NULL);
+    expected_pcap_hdr_t hdr;
+    assert(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        expected_pcaprec_hdr_t rechdr;
+        expected_pcap_le_header_t le_hdr;
+        unsigned seq;
+        assert(fread(&rechdr, sizeof(rechdr), 1, f) == 1);
+        assert(rechdr.ts_sec == expected[i]);
+        assert(fread(&le_hdr, sizeof(le_hdr), 1, f) == 1);
+        assert(fread(&seq, sizeof(seq), 1, f) == 1);
+        assert(seq == expected[i]);
+    }
+    assert(fgetc(f) == EOF);
+    fclose(f);
+
+    // a shard that never wrote its spool fails the merge
+    char *missing[] = { "no_such_spool.bin" };
+    p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
+    assert(pcap_merge(p, missing, 1) == -1);
+    pcap_close(p);
+
+    remove(spools[0]);
+    remove(spools[1]);
+    remove(test_file);
+    printf("[PASS] test_pcap_merge\n");
+}
+
+// at a seam the two shards time the same burst a sample or two apart, and
+// other channels' packets can land between the copies
+typedef struct {
+    unsigned usec;
+    unsigned freq;
+    unsigned id;
+} seam_packet_t;
+
+static void write_seam_spool(const char *path, const seam_packet_t *pkts, unsigned n) {
+    pcap_t *p = pcap_open((char*)path, PCAP_FORMAT_SPOOL);
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 4);
+    unsigned i;
+
+    assert(p != NULL);
+    memset(pkt, 0, sizeof(*pkt) + 4);
+    pkt->len = 4;
+    for (i = 0; i < n; ++i) {
+        pkt->freq = pkts[i].freq;
+        pkt->timestamp.tv_sec = 100;
+        pkt->timestamp.tv_nsec = pkts[i].usec * 1000;
+        memcpy(pkt->data, &pkts[i].id, sizeof(pkts[i].id));
+        pcap_write_ble(p, pkt);
+    }
+    free(pkt);
+    pcap_close(p);
+}
+
+static void test_pcap_merge_seam(void) {
+    const seam_packet_t a[] = {
+        { 10, 2402, 1 },
+        { 500, 2402, 2 },   // b has it 2 us later
+        { 501, 2426, 3 },   // b has it too, after 4
+        { 503, 2480, 4 },   // only in a
+        { 900, 2402, 5 },   // b has it 50 us later: a different packet
+    };
+    const seam_packet_t b[] = {
+        { 501, 2426, 3 },
+        { 502, 2402, 2 },
+        { 950, 2402, 5 },
+        { 2000, 2440, 6 },
+    };
+    const unsigned expected[] = { 1, 2, 3, 4, 5, 5, 6 };
+    char *spools[] = { "test_seam_0.bin", "test_seam_1.bin" };
+    const char *test_file = "test_output_seam.pcap";
+    unsigned i;
+
+    write_seam_spool(spools[0], a, sizeof(a) / sizeof(a[0]));
+    write_seam_spool(spools[1], b, sizeof(b) / sizeof(b[0]));
+
+    pcap_t *p = pcap_open((char*)test_file, PCAP_FORMAT_PCAP);
+    assert(p != NULL);
+    assert(pcap_merge(p, spools, 2) == 0);
+    pcap_close(p);
+
+    FILE *f = fopen(test_file, "rb");
+    assert(f != NULL);
+    expected_pcap_hdr_t hdr;
+    assert(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        expected_pcaprec_hdr_t rechdr;
+        expected_pcap_le_header_t le_hdr;
+        unsigned id;
+        assert(fread(&rechdr, sizeof(rechdr), 1, f) == 1);
+        assert(fread(&le_hdr, sizeof(le_hdr), 1, f) == 1);
+        assert(fread(&id, sizeof(id), 1, f) == 1);
+        assert(id == expected[i]);
+    }
+    assert(fgetc(f) == EOF);
+    fclose(f);
+
+    remove(spools[0]);
+    remove(spools[1]);
+    remove(test_file);
+    printf("[PASS] test_pcap_merge_seam\n");
+}
+
+static void test_pcap_write_error(void) {
+    const unsigned num_packets = 50000;
+    pcap_stats_t stats;
+    unsigned i;
+
+    // every write to /dev/full fails with ENOSPC
+    pcap_t *p = pcap_open((char*)"/dev/full", PCAP_FORMAT_PCAP);
+    if (p == NULL) {
+        printf("[SKIP] test_pcap_write_error (no /dev/full)\n");
+        return;
+    }
+
+    ble_packet_t *pkt = malloc(sizeof(ble_packet_t) + 8);
+    memset(pkt, 0, sizeof(*pkt) + 8);
+    pkt->freq = 2426;
+    pkt->len = 8;
+    for (i = 0; i < num_packets; ++i) {
+        pkt->timestamp.tv_sec = i;
+        pcap_write_ble(p, pkt);
+    }
+    pcap_flush(p);
+
+    // nothing is written after the first failure, and all of it is counted
+    pcap_get_stats(p, &stats);
+    assert(stats.lost_bytes == sizeof(expected_pcap_hdr_t) +
+        num_packets * (sizeof(expected_pcaprec_hdr_t) + sizeof(expected_pcap_le_header_t) + 8));
+
+    free(pkt);
+    pcap_close(p);
+    printf("[PASS] test_pcap_write_error\n");
+}
+
 int main(void) {
     printf("===========================================\n");
     printf(" Running pcap.c Unit Tests                 \n");
     printf("===========================================\n");
     test_pcap_write_and_parse();
+    test_pcap_many_packets();
+    test_pcap_async_policies();
+    test_pcapng_write_and_parse();
+    test_pcap_rotation();
+    test_pcap_merge();
+    test_pcap_merge_seam();
+    test_pcap_write_error();
     printf("===========================================\n");
     printf(" All pcap tests passed successfully!       \n");
     printf("===========================================\n");
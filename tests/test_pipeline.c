@@ -0,0 +1,200 @@
+/*
+ * Unit and Multithreaded Stress Tests for pipeline.c / pipeline.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+
+static void test_single_thread_fifo(void) {
+    pipe_t p;
+    pipe_stats_t ps;
+    unsigned *slot;
+    unsigned i;
+
+    assert(pipe_init(&p, 3, sizeof(unsigned), 1) == 0);
+    // slots are padded out to a cache line
+    assert(p.slot_size == PIPE_CACHE_LINE);
+
+    for (i = 0; i < 3; ++i) {
+        slot = pipe_acquire(&p);
+        assert(((uintptr_t)slot & (PIPE_CACHE_LINE - 1)) == 0);
+        *slot = i;
+        pipe_publish(&p);
+    }
+
+    for (i = 0; i < 3; ++i) {
+        slot = pipe_next(&p, 0);
+        assert(slot != NULL && *slot == i);
+        pipe_release(&p, 0);
+    }
+
+    // wrap around several laps
+    for (i = 0; i < 100; ++i) {
+        slot = pipe_acquire(&p);
+        *slot = i;
+        pipe_publish(&p);
+        slot = pipe_next(&p, 0);
+        assert(*slot == i);
+        pipe_release(&p, 0);
+    }
+
+    pipe_finish(&p);
+    assert(pipe_next(&p, 0) == NULL);
+
+    pipe_get_stats(&p, &ps);
+    assert(ps.depth == 3 && ps.high_water == 3);
+    assert(ps.producer_waits == 0 && ps.consumer_waits == 0);
+
+    pipe_destroy(&p);
+    printf("[PASS] test_single_thread_fifo\n");
+}
+
+// buffers published before finish are still delivered
+static void test_finish_drains(void) {
+    pipe_t p;
+    unsigned *slot;
+    unsigned c;
+
+    assert(pipe_init(&p, 4, sizeof(unsigned), 2) == 0);
+    slot = pipe_acquire(&p);
+    *slot = 42;
+    pipe_publish(&p);
+    pipe_finish(&p);
+
+    for (c = 0; c < 2; ++c) {
+        slot = pipe_next(&p, c);
+        assert(slot != NULL && *slot == 42);
+        pipe_release(&p, c);
+        assert(pipe_next(&p, c) == NULL);
+    }
+
+    pipe_destroy(&p);
+    printf("[PASS] test_finish_drains\n");
+}
+
+#define CONSUMERS 4
+#define ITEMS 50000
+
+typedef struct {
+    pipe_t *p;
+    unsigned id;
+    unsigned long sum;
+    unsigned count;
+} consumer_arg_t;
+
+static void *consumer_worker(void *arg) {
+    consumer_arg_t *c = (consumer_arg_t *)arg;
+    unsigned *slot;
+    unsigned expect = 1;
+
+    while ((slot = pipe_next(c->p, c->id)) != NULL) {
+        // in order, nothing skipped
+        assert(*slot == expect);
+        ++expect;
+        c->sum += *slot;
+        ++c->count;
+        if ((c->count & 0xfff) == c->id)
+            usleep(100); // make the producer wait on the slow one now and then
+        pipe_release(c->p, c->id);
+    }
+    return NULL;
+}
+
+// every consumer sees every buffer, and none is reused before all of them
+// are done with it
+static void test_broadcast(void) {
+    pipe_t p;
+    pipe_stats_t ps;
+    pthread_t threads[CONSUMERS];
+    consumer_arg_t args[CONSUMERS];
+    unsigned long expect = (unsigned long)ITEMS * (ITEMS + 1) / 2;
+    unsigned i;
+
+    assert(pipe_init(&p, 2, sizeof(unsigned), CONSUMERS) == 0);
+    for (i = 0; i < CONSUMERS; ++i) {
+        args[i] = (consumer_arg_t){ &p, i, 0, 0 };
+        pthread_create(&threads[i], NULL, consumer_worker, &args[i]);
+    }
+
+    for (i = 1; i <= ITEMS; ++i) {
+        unsigned *slot = pipe_acquire(&p);
+        assert(slot != NULL);
+        *slot = i;
+        pipe_publish(&p);
+    }
+    pipe_finish(&p);
+
+    for (i = 0; i < CONSUMERS; ++i) {
+        pthread_join(threads[i], NULL);
+        assert(args[i].count == ITEMS);
+        assert(args[i].sum == expect);
+    }
+
+    pipe_get_stats(&p, &ps);
+    assert(ps.high_water <= 2);
+    printf("  producer stalled %lu times, consumers idle %lu times\n", ps.producer_waits, ps.consumer_waits);
+
+    pipe_destroy(&p);
+    printf("[PASS] test_broadcast\n");
+}
+
+static void *acquire_worker(void *arg) {
+    pipe_t *p = (pipe_t *)arg;
+    void *slot;
+
+    while ((slot = pipe_acquire(p)) != NULL)
+        pipe_publish(p);
+    return NULL;
+}
+
+static void *next_worker(void *arg) {
+    pipe_t *p = (pipe_t *)arg;
+    assert(pipe_next(p, 0) == NULL);
+    return NULL;
+}
+
+// shutdown wakes a producer stuck on a full pipe and a consumer on an
+// empty one
+static void test_shutdown(void) {
+    pipe_t full, empty;
+    pthread_t producer, consumer;
+
+    assert(pipe_init(&full, 2, 16, 1) == 0);
+    assert(pipe_init(&empty, 2, 16, 1) == 0);
+    pthread_create(&producer, NULL, acquire_worker, &full);
+    pthread_create(&consumer, NULL, next_worker, &empty);
+
+    usleep(10000);
+    pipe_shutdown(&full);
+    pipe_shutdown(&empty);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    assert(pipe_acquire(&full) == NULL);
+    assert(pipe_next(&full, 0) == NULL);
+
+    pipe_destroy(&full);
+    pipe_destroy(&empty);
+    printf("[PASS] test_shutdown\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running pipeline.c Unit Tests             \n");
+    printf("===========================================\n");
+    test_single_thread_fifo();
+    test_finish_drains();
+    test_broadcast();
+    test_shutdown();
+    printf("===========================================\n");
+    printf(" All pipeline tests passed successfully!   \n");
+    printf("===========================================\n");
+    return 0;
+}
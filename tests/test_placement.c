@@ -0,0 +1,114 @@
+/*
+ * Unit tests for placement.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "placement.h"
+
+static void test_parse_cpu_list(void) {
+    unsigned cpus[8];
+
+    assert(parse_cpu_list("0-3,8,10-11", cpus, 8) == 7);
+    assert(cpus[0] == 0 && cpus[3] == 3 && cpus[4] == 8 && cpus[6] == 11);
+
+    // as sysfs writes it
+    assert(parse_cpu_list("5\n", cpus, 8) == 1);
+    assert(cpus[0] == 5);
+
+    assert(parse_cpu_list("", cpus, 8) == -1);
+    assert(parse_cpu_list("a", cpus, 8) == -1);
+    assert(parse_cpu_list("1-", cpus, 8) == -1);
+    assert(parse_cpu_list("4-2", cpus, 8) == -1);
+    assert(parse_cpu_list("1,,2", cpus, 8) == -1);
+    assert(parse_cpu_list("0-8", cpus, 8) == -1); // too many
+    printf("[PASS] test_parse_cpu_list\n");
+}
+
+static void *idle(void *arg) {
+    return arg;
+}
+
+#ifdef __linux__
+static unsigned first_allowed(void) {
+    cpu_set_t set;
+    unsigned i;
+    assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+    for (i = 0; !CPU_ISSET(i, &set); ++i)
+        ;
+    return i;
+}
+
+static void test_list(void) {
+    placement_t pl;
+    unsigned cpu = first_allowed();
+    unsigned bogus = PLACEMENT_MAX_CPUS - 1;
+    pthread_t t;
+
+    assert(placement_init(&pl, PLACEMENT_LIST, &cpu, 1) == 0);
+    assert(pl.num_cpus == 1 && pl.cpus[0] == cpu);
+
+    // round robin over the list
+    pthread_create(&t, NULL, idle, NULL);
+    assert(placement_pin(&pl, t, "one") == (int)cpu);
+    assert(placement_pin(&pl, t, "two") == (int)cpu);
+    pthread_join(t, NULL);
+    assert(pl.num_threads == 2);
+    assert(strcmp(pl.threads[1].name, "two") == 0);
+    placement_free(&pl);
+
+    // not one we may run on
+    assert(placement_init(&pl, PLACEMENT_LIST, &bogus, 1) == -1);
+    placement_free(&pl);
+    printf("[PASS] test_list\n");
+}
+
+static void test_auto(void) {
+    placement_t pl;
+    cpu_set_t set;
+    unsigned i;
+
+    assert(placement_init(&pl, PLACEMENT_AUTO, NULL, 0) == 0);
+    assert(pl.num_cpus > 0);
+    assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+    for (i = 0; i < pl.num_cpus; ++i)
+        assert(CPU_ISSET(pl.cpus[i], &set));
+    placement_free(&pl);
+    printf("[PASS] test_auto\n");
+}
+#endif
+
+static void test_none(void) {
+    placement_t pl;
+    pthread_t t;
+
+    assert(placement_init(&pl, PLACEMENT_NONE, NULL, 0) == 0);
+    pthread_create(&t, NULL, idle, NULL);
+    assert(placement_pin(&pl, t, "unpinned") == -1);
+    pthread_join(t, NULL);
+    assert(pl.num_threads == 0);
+    placement_free(&pl);
+    printf("[PASS] test_none\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running placement.c Unit Tests            \n");
+    printf("===========================================\n");
+    test_parse_cpu_list();
+#ifdef __linux__
+    test_list();
+    test_auto();
+#endif
+    test_none();
+    printf("===========================================\n");
+    printf(" All placement tests passed successfully!  \n");
+    printf("===========================================\n");
+    return 0;
+}
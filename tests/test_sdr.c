@@ -10,6 +10,7 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <pthread.h>
 
 #include "sdr.h"
 #include "options.h"
@@ -139,6 +140,101 @@ static void test_sdr_driver_selection_usrp(void) {
 }
 #endif
 
+static void test_sample_pool(void) {
+    sample_pool_stats_t st;
+    sample_buf_t *bufs[4], *b;
+    unsigned i;
+
+    assert(sample_pool_init(1000, 4) == 0);
+    assert(sample_pool_init(1000, 4) == -1);
+
+    for (i = 0; i < 4; ++i) {
+        bufs[i] = sample_pool_get(1000);
+        assert(bufs[i] != NULL);
+        assert(bufs[i]->samples == bufs[i]->data);
+        assert(((uintptr_t)bufs[i] & 63) == 0);
+        memset(bufs[i]->samples, i, 1000);
+    }
+    // all in use, and too big never fits
+    assert(sample_pool_get(1000) == NULL);
+    assert(sample_pool_get(10) == NULL);
+    sample_buf_free(bufs[2]);
+    assert(sample_pool_get(1001) == NULL);
+
+    // too big is a sizing bug, not overload
+    sample_pool_get_stats(&st);
+    assert(st.count == 4);
+    assert(st.bytes == 1000);
+    assert(st.in_use == 3);
+    assert(st.high_water == 4);
+    assert(st.exhausted == 2);
+    assert(st.oversized == 1);
+
+    // the freed one comes back, the others were left alone
+    b = sample_pool_get(500);
+    assert(b == bufs[2]);
+    assert(bufs[3]->samples[999] == 3);
+    for (i = 0; i < 4; ++i)
+        sample_buf_free(bufs[i]);
+
+    // plain buffers are freed the ordinary way
+    b = sample_buf_alloc(16);
+    assert(b != NULL && b->pool_index == 0);
+    sample_buf_free(b);
+
+    sample_pool_get_stats(&st);
+    assert(st.in_use == 0);
+    sample_pool_destroy();
+    printf("[PASS] test_sample_pool\n");
+}
+
+static void test_sample_pool_count(void) {
+    // one second of ci8 at 20 Msps in 256 KiB buffers
+    assert(sample_pool_count(262144, 20e6) == 153);
+    // slow rates still get a few
+    assert(sample_pool_count(262144, 1e3) == 4);
+    // never more than SAMPLE_POOL_MEMORY
+    assert(sample_pool_count(4096, 1e9) * 4096 <= SAMPLE_POOL_MEMORY);
+    assert(sample_pool_count(SAMPLE_POOL_MEMORY, 20e6) == 1);
+    printf("[PASS] test_sample_pool_count\n");
+}
+
+#define POOL_THREADS 4
+#define POOL_ROUNDS 100000
+
+static void *pool_worker(void *arg) {
+    unsigned i, id = (unsigned)(uintptr_t)arg;
+    for (i = 0; i < POOL_ROUNDS; ++i) {
+        sample_buf_t *b = sample_pool_get(64);
+        if (b == NULL)
+            continue;
+        // nobody else may hold it at the same time
+        b->num = id;
+        b->samples[0] = (int8_t)i;
+        assert(b->num == id);
+        sample_buf_free(b);
+    }
+    return NULL;
+}
+
+static void test_sample_pool_threads(void) {
+    pthread_t threads[POOL_THREADS];
+    sample_pool_stats_t st;
+    uintptr_t i;
+
+    assert(sample_pool_init(64, 2) == 0);
+    for (i = 0; i < POOL_THREADS; ++i)
+        assert(pthread_create(&threads[i], NULL, pool_worker, (void *)i) == 0);
+    for (i = 0; i < POOL_THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    sample_pool_get_stats(&st);
+    assert(st.in_use == 0);
+    assert(st.high_water <= 2);
+    sample_pool_destroy();
+    printf("[PASS] test_sample_pool_threads\n");
+}
+
 int main(void) {
     printf("===========================================\n");
     printf(" Running SDR HAL Unit Tests                \n");
@@ -152,6 +248,9 @@ int main(void) {
 #ifdef HAVE_UHD
     test_sdr_driver_selection_usrp();
 #endif
+    test_sample_pool();
+    test_sample_pool_count();
+    test_sample_pool_threads();
     printf("===========================================\n");
     printf(" All SDR HAL tests passed successfully!    \n");
     printf("===========================================\n");
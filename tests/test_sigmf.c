@@ -0,0 +1,214 @@
+/*
+ * Unit tests for sigmf.c / sigmf.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sigmf.h"
+
+static char *slurp(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *buf;
+    long len;
+
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len + 1);
+    assert(fread(buf, 1, len, f) == (size_t)len);
+    buf[len] = '\0';
+    fclose(f);
+    return buf;
+}
+
+static void test_sigmf_meta_path(void) {
+    char *p = sigmf_meta_path("dir/rec.sigmf-data");
+    assert(strcmp(p, "dir/rec.sigmf-meta") == 0);
+    free(p);
+    p = sigmf_meta_path("capture.raw");
+    assert(strcmp(p, "capture.raw.sigmf-meta") == 0);
+    free(p);
+    assert(strcmp(sigmf_datatype(2), "ci8") == 0);
+    assert(strcmp(sigmf_datatype(4), "ci16_le") == 0);
+    assert(strcmp(sigmf_datatype(8), "cf32_le") == 0);
+    assert(sigmf_datatype(3) == NULL);
+    printf("[PASS] test_sigmf_meta_path\n");
+}
+
+static void test_sigmf_write_and_read(void) {
+    const char *data = "test_rec.sigmf-data", *meta = "test_rec.sigmf-meta";
+    int8_t samples[2 * 1000];
+    struct timespec ts = { .tv_sec = 1700000000, .tv_nsec = 500000000 };
+    sigmf_info_t info;
+    char *data_path, *json;
+    unsigned i;
+
+    for (i = 0; i < sizeof(samples); ++i)
+        samples[i] = (int8_t)i;
+
+    sigmf_writer_t *w = sigmf_open(data, 20e6, 2427e6);
+    assert(w != NULL);
+    assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    sigmf_dropped(w, 4000);
+    assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    sigmf_close(w);
+
+    json = slurp(meta);
+    assert(strstr(json, "\"core:datatype\": \"ci8\"") != NULL);
+    assert(strstr(json, "\"core:sample_rate\": 20000000") != NULL);
+    assert(strstr(json, "\"core:frequency\": 2427000000") != NULL);
+    // first buffer of 1000 samples at 20 Msps ends at .5 s, so began 50 us earlier
+    assert(strstr(json, "\"core:datetime\": \"2023-11-14T22:13:20.499950000Z\"") != NULL);
+    // drop annotation and a fresh capture segment where the gap is
+    assert(strstr(json, "4000 samples dropped") != NULL);
+    assert(strstr(json, "\"core:sample_start\": 1000") != NULL);
+    assert(strstr(json, "core:dataset") == NULL);
+    free(json);
+
+    // either half of the pair finds the recording
+    assert(sigmf_read(meta, &info, &data_path) == 0);
+    assert(strcmp(info.datatype, "ci8") == 0);
+    assert(info.sample_rate == 20e6);
+    assert(info.frequency == 2427e6);
+    assert(strcmp(data_path, data) == 0);
+    free(data_path);
+
+    assert(sigmf_read(data, &info, &data_path) == 0);
+    assert(strcmp(data_path, data) == 0);
+    free(data_path);
+
+    json = slurp(data);
+    assert(memcmp(json, samples, 16) == 0);
+    free(json);
+
+    remove(data);
+    remove(meta);
+    printf("[PASS] test_sigmf_write_and_read\n");
+}
+
+static unsigned count(const char *haystack, const char *needle) {
+    unsigned n = 0;
+    while ((haystack = strstr(haystack, needle)) != NULL) {
+        ++n;
+        ++haystack;
+    }
+    return n;
+}
+
+// a burst of drops is one annotation spanning them, timing restarts after
+// the last, and nothing touches the metadata until close
+static void test_sigmf_merged_drops(void) {
+    const char *data = "test_drops.sigmf-data", *meta = "test_drops.sigmf-meta";
+    int8_t samples[2 * 1000] = { 0 };
+    struct timespec ts = { .tv_sec = 1700000000, .tv_nsec = 0 };
+    char *json;
+    unsigned i;
+
+    remove(meta);
+    sigmf_writer_t *w = sigmf_open(data, 1e6, 2427e6);
+    assert(w != NULL);
+    assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    for (i = 0; i < 10; ++i) {
+        sigmf_dropped(w, 100);
+        assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    }
+    assert(fopen(meta, "r") == NULL);
+
+    // a second later, a separate event
+    for (i = 0; i < 1000; ++i)
+        assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    sigmf_dropped(w, 7);
+    assert(sigmf_write(w, samples, 1000, 2, &ts) == 0);
+    sigmf_close(w);
+
+    json = slurp(meta);
+    assert(count(json, "\"core:label\": \"dropped\"") == 2);
+    assert(strstr(json, "1000 samples dropped within this span") != NULL);
+    assert(strstr(json, "\"core:sample_count\": 9000") != NULL);
+    assert(strstr(json, "7 samples dropped before this point") != NULL);
+    // the first capture, one after the last of the burst, one after the 7
+    assert(count(json, "\"core:frequency\"") == 3);
+    assert(strstr(json, "\"core:sample_start\": 10000") != NULL);
+    assert(strstr(json, "\"core:sample_start\": 1011000") != NULL);
+    free(json);
+
+    remove(data);
+    remove(meta);
+    printf("[PASS] test_sigmf_merged_drops\n");
+}
+
+static void test_sigmf_dataset_name(void) {
+    const char *data = "test_capture.raw", *meta = "test_capture.raw.sigmf-meta";
+    int8_t samples[8] = { 0 };
+    sigmf_info_t info;
+    char *data_path, *json;
+
+    sigmf_writer_t *w = sigmf_open(data, 4e6, 2402e6);
+    assert(w != NULL);
+    assert(sigmf_write(w, samples, 2, 4, NULL) == 0);
+    sigmf_close(w);
+
+    json = slurp(meta);
+    assert(strstr(json, "\"core:dataset\": \"test_capture.raw\"") != NULL);
+    assert(strstr(json, "\"core:datatype\": \"ci16_le\"") != NULL);
+    assert(strstr(json, "core:datetime") == NULL);
+    free(json);
+
+    assert(sigmf_read(meta, &info, &data_path) == 0);
+    assert(strcmp(data_path, data) == 0);
+    assert(strcmp(info.datatype, "ci16_le") == 0);
+    free(data_path);
+
+    remove(data);
+    remove(meta);
+
+    // no metadata: not a SigMF recording
+    assert(sigmf_read("no_such_file.raw", &info, &data_path) == 1);
+    assert(sigmf_read("no_such_file.sigmf-meta", &info, &data_path) == -1);
+    printf("[PASS] test_sigmf_dataset_name\n");
+}
+
+static void test_sigmf_dataset_escaped(void) {
+    const char *data = "test \"odd\\name\t.raw", *meta = "test \"odd\\name\t.raw.sigmf-meta";
+    int8_t samples[4] = { 0 };
+    sigmf_info_t info;
+    char *data_path, *json;
+
+    sigmf_writer_t *w = sigmf_open(data, 4e6, 2402e6);
+    assert(w != NULL);
+    assert(sigmf_write(w, samples, 2, 2, NULL) == 0);
+    sigmf_close(w);
+
+    json = slurp(meta);
+    assert(strstr(json, "\"core:dataset\": \"test \\\"odd\\\\name\\t.raw\"") != NULL);
+    free(json);
+
+    // the name comes back whole, not cut at the first quote
+    assert(sigmf_read(meta, &info, &data_path) == 0);
+    assert(strcmp(data_path, data) == 0);
+    free(data_path);
+
+    remove(data);
+    remove(meta);
+    printf("[PASS] test_sigmf_dataset_escaped\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running sigmf.c Unit Tests                \n");
+    printf("===========================================\n");
+    test_sigmf_meta_path();
+    test_sigmf_write_and_read();
+    test_sigmf_merged_drops();
+    test_sigmf_dataset_name();
+    test_sigmf_dataset_escaped();
+    printf("===========================================\n");
+    printf(" All sigmf tests passed successfully!      \n");
+    printf("===========================================\n");
+    return 0;
+}
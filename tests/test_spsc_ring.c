@@ -0,0 +1,130 @@
+/*
+ * Unit and Multithreaded Stress Tests for spsc_ring.c / spsc_ring.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "spsc_ring.h"
+
+static void test_single_thread_fifo(void) {
+    spsc_ring_t r;
+    void *out;
+    uintptr_t i;
+
+    assert(spsc_ring_init(&r, 3) == 0);
+    // capacity rounds up to a power of two
+    assert(r.mask == 3);
+
+    assert(spsc_ring_pop(&r, &out) == -1);
+
+    for (i = 0; i < 4; ++i)
+        assert(spsc_ring_push(&r, (void *)(i + 1)) == 0);
+    assert(spsc_ring_size(&r) == 4);
+    assert(spsc_ring_push(&r, (void *)5) == -1);
+
+    for (i = 0; i < 4; ++i) {
+        assert(spsc_ring_pop(&r, &out) == 0);
+        assert(out == (void *)(i + 1));
+    }
+    assert(spsc_ring_pop(&r, &out) == -1);
+
+    // wrap around several laps
+    for (i = 0; i < 100; ++i) {
+        assert(spsc_ring_push(&r, (void *)i) == 0);
+        assert(spsc_ring_pop(&r, &out) == 0);
+        assert(out == (void *)i);
+    }
+
+    spsc_ring_destroy(&r);
+    printf("[PASS] test_single_thread_fifo\n");
+}
+
+#define ITEMS 200000
+
+static void *producer_worker(void *arg) {
+    spsc_ring_t *r = (spsc_ring_t *)arg;
+    uintptr_t i;
+
+    for (i = 1; i <= ITEMS; ++i)
+        assert(spsc_ring_put(r, (void *)i) == 0);
+    return NULL;
+}
+
+// a small ring keeps both sides falling asleep on each other
+static void test_blocking_producer_consumer(void) {
+    spsc_ring_t r;
+    pthread_t producer;
+    uintptr_t i;
+    void *out;
+
+    assert(spsc_ring_init(&r, 4) == 0);
+    pthread_create(&producer, NULL, producer_worker, &r);
+    for (i = 1; i <= ITEMS; ++i) {
+        assert(spsc_ring_take(&r, &out) == 0);
+        assert(out == (void *)i);
+    }
+    pthread_join(producer, NULL);
+    assert(spsc_ring_size(&r) == 0);
+
+    spsc_ring_destroy(&r);
+    printf("[PASS] test_blocking_producer_consumer (%d items)\n", ITEMS);
+}
+
+static void *take_worker(void *arg) {
+    spsc_ring_t *r = (spsc_ring_t *)arg;
+    void *out;
+    return (void *)(intptr_t)spsc_ring_take(r, &out);
+}
+
+static void *put_worker(void *arg) {
+    spsc_ring_t *r = (spsc_ring_t *)arg;
+    return (void *)(intptr_t)spsc_ring_put(r, (void *)3);
+}
+
+static void test_close_wakes(void) {
+    spsc_ring_t r;
+    pthread_t t;
+    void *ret;
+
+    // consumer asleep on an empty ring
+    assert(spsc_ring_init(&r, 2) == 0);
+    pthread_create(&t, NULL, take_worker, &r);
+    usleep(10000);
+    spsc_ring_close(&r);
+    pthread_join(t, &ret);
+    assert((intptr_t)ret == -1);
+    assert(spsc_ring_put(&r, (void *)1) == -1);
+    spsc_ring_destroy(&r);
+
+    // producer asleep on a full one
+    assert(spsc_ring_init(&r, 2) == 0);
+    assert(spsc_ring_push(&r, (void *)1) == 0);
+    assert(spsc_ring_push(&r, (void *)2) == 0);
+    pthread_create(&t, NULL, put_worker, &r);
+    usleep(10000);
+    spsc_ring_close(&r);
+    pthread_join(t, &ret);
+    assert((intptr_t)ret == -1);
+    spsc_ring_destroy(&r);
+
+    printf("[PASS] test_close_wakes\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running spsc_ring.c Unit Tests            \n");
+    printf("===========================================\n");
+    test_single_thread_fifo();
+    test_blocking_producer_consumer();
+    test_close_wakes();
+    printf("===========================================\n");
+    printf(" All spsc_ring tests passed successfully!  \n");
+    printf("===========================================\n");
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Unit tests for synth.c / synth.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <assert.h>
+
+#include "bluetooth.h"
+#include "btbb.h"
+#include "options.h"
+#include "synth.h"
+
+// bluetooth.c writes packets to config.pcap, left NULL here
+sniffer_config_t config;
+
+extern ble_packet_t *ble_burst(uint8_t *bits, unsigned bits_len, unsigned freq, struct timespec timestamp);
+
+static void test_parse(void) {
+    synth_params_t p;
+
+    synth_defaults(&p);
+    assert(synth_parse(&p, "") == 0);
+    assert(p.seconds == 1.0f && p.mix == SYNTH_MIX_ALL && p.seed == 1);
+
+    assert(synth_parse(&p, "rate=500,br=0.2,mix=adv,snr=15,cfo=100,seconds=5,seed=7") == 0);
+    assert(p.rate == 500.0f && p.br == 0.2f && p.mix == SYNTH_MIX_ADV);
+    assert(p.snr_db == 15.0f && p.cfo_khz == 100.0f && p.seconds == 5.0f && p.seed == 7);
+
+    synth_defaults(&p);
+    assert(synth_parse(&p, "speed=2") == -1);
+    assert(synth_parse(&p, "rate") == -1);
+    assert(synth_parse(&p, "rate=fast") == -1);
+    assert(synth_parse(&p, "br=1.5") == -1);
+    assert(synth_parse(&p, "mix=data") == -1);
+    assert(synth_parse(&p, "seconds=0") == -1);
+    printf("[PASS] test_parse\n");
+}
+
+// what the detector makes of the bits, on an advertising channel and a
+// data channel
+static void test_ble_bits(void) {
+    static const unsigned freqs[] = { 2402, 2426, 2440 };
+    uint8_t pdu[37], bits[400];
+    struct timespec ts = { 0 };
+    unsigned f, i, n;
+
+    for (i = 0; i < sizeof(pdu); ++i)
+        pdu[i] = i * 7 + 3;
+
+    for (f = 0; f < sizeof(freqs) / sizeof(freqs[0]); ++f) {
+        n = synth_ble_bits(bits, freqs[f], pdu, 20);
+        assert(n == 8 + 32 + 16 + 20 * 8 + 24);
+        // the demodulator hands over a few bits past the end
+        memset(bits + n, 0, 4);
+        ble_packet_t *p = ble_burst(bits, n + 4, freqs[f], ts);
+        assert(p != NULL);
+        assert(p->aa == SYNTH_BLE_AA);
+        assert(p->len == 4 + 2 + 20 + 3);
+        assert(p->data[4] == 0x42 && p->data[5] == 20);
+        assert(memcmp(&p->data[6], pdu, 20) == 0);
+        free(p);
+    }
+    printf("[PASS] test_ble_bits\n");
+}
+
+static void test_br_bits(void) {
+    static const uint32_t laps[] = { SYNTH_BR_LAP, 0x123456, 0xabcdef, 0 };
+    uint8_t bits[400];
+    uint32_t rng = 1;
+    unsigned i;
+
+    for (i = 0; i < sizeof(laps) / sizeof(laps[0]); ++i) {
+        assert(synth_br_bits(bits, laps[i], 366, &rng) == 366);
+        // alternating into the sync word
+        assert(bits[3] != bits[4]);
+        assert(btbb_find_ac((char *)bits, 366, 0) == laps[i]);
+    }
+    printf("[PASS] test_br_bits\n");
+}
+
+static void test_render(void) {
+    synth_params_t p;
+    synth_t a, b;
+    size_t busy[40] = { 0 };
+    unsigned i;
+
+    // 2422 to 2429 MHz, four channels decoded
+    synth_defaults(&p);
+    p.rate = 1000.0f;
+    assert(synth_render(&a, &p, 8, 2426, 400000) == 0);
+    assert(a.num == 400000);
+    assert(a.num_packets > 0 && a.injected[SYNTH_BLE] > 0 && a.injected[SYNTH_BR] > 0);
+    assert(a.injected[SYNTH_BLE] + a.injected[SYNTH_BR] == a.num_packets);
+    for (i = 0; i < a.num_packets; ++i) {
+        synth_packet_t *pkt = &a.packets[i];
+        unsigned ch = (pkt->freq - 2402) / 2;
+        assert(pkt->freq >= 2422 && pkt->freq <= 2428 && (pkt->freq & 1) == 0);
+        assert(pkt->start + pkt->len <= a.num);
+        assert(pkt->start >= busy[ch]);
+        assert(fabsf(pkt->cfo) <= 50e3f);
+        busy[ch] = pkt->start + pkt->len;
+    }
+
+    // same seed, same stream
+    assert(synth_render(&b, &p, 8, 2426, 400000) == 0);
+    assert(b.num_packets == a.num_packets);
+    assert(memcmp(a.samples, b.samples, 2 * a.num) == 0);
+    synth_free(&b);
+
+    p.seed = 2;
+    assert(synth_render(&b, &p, 8, 2426, 400000) == 0);
+    assert(memcmp(a.samples, b.samples, 2 * a.num) != 0);
+    synth_free(&b);
+    synth_free(&a);
+    assert(a.samples == NULL && a.num_packets == 0);
+
+    // BLE only where it advertises
+    p.mix = SYNTH_MIX_ADV;
+    p.br = 0.0f;
+    assert(synth_render(&a, &p, 8, 2426, 400000) == 0);
+    assert(a.num_packets > 0 && a.injected[SYNTH_BR] == 0);
+    for (i = 0; i < a.num_packets; ++i)
+        assert(a.packets[i].freq == 2426);
+    synth_free(&a);
+
+    // only 2402 MHz is in the band, then nothing is
+    p.mix = SYNTH_MIX_ALL;
+    assert(synth_render(&a, &p, 8, 2400, 400000) == 0);
+    assert(a.num_packets > 0);
+    for (i = 0; i < a.num_packets; ++i)
+        assert(a.packets[i].freq == 2402);
+    synth_free(&a);
+    assert(synth_render(&a, &p, 4, 2400, 200000) == 0);
+    assert(a.num_packets == 0);
+    synth_free(&a);
+    printf("[PASS] test_render\n");
+}
+
+// the preamble and access address come back out of an FM discriminator
+// tuned to the packet, when nothing else is on the air
+static void test_modulation(void) {
+    unsigned channels = 8, sps = 8, checked = 0, i, j, k;
+    uint8_t bits[40];
+    synth_params_t p;
+    synth_t s;
+
+    synth_defaults(&p);
+    p.rate = 50.0f;
+    p.br = 0.0f;
+    p.snr_db = 40.0f;
+    assert(synth_render(&s, &p, channels, 2426, 800000) == 0);
+    assert(s.num_packets > 0);
+
+    for (i = 0; i < 40; ++i)
+        bits[i] = i < 8 ? (i ^ SYNTH_BLE_AA) & 1 : (SYNTH_BLE_AA >> (i - 8)) & 1;
+
+    for (i = 0; i < s.num_packets; ++i) {
+        synth_packet_t *pkt = &s.packets[i];
+        float offset = 2.0f * (float)M_PI * (((int)pkt->freq - 2426) * 1e6f + pkt->cfo) / (channels * 1e6f);
+
+        for (j = 0; j < s.num_packets; ++j)
+            if (j != i && s.packets[j].start < pkt->start + pkt->len && pkt->start < s.packets[j].start + s.packets[j].len)
+                break;
+        if (j < s.num_packets)
+            continue;
+        ++checked;
+
+        for (k = 0; k < 40; ++k) {
+            // the middle of symbol k, the pulse is delayed a symbol
+            size_t n = pkt->start + (k + 1) * sps + sps / 4, end = n + sps / 2;
+            float f = 0.0f;
+            for (; n < end; ++n) {
+                float complex cur = s.samples[2 * n] + s.samples[2 * n + 1] * I;
+                float complex prev = s.samples[2 * n - 2] + s.samples[2 * n - 1] * I;
+                float d = cargf(cur * conjf(prev)) - offset;
+                while (d > (float)M_PI) d -= 2.0f * (float)M_PI;
+                while (d < -(float)M_PI) d += 2.0f * (float)M_PI;
+                f += d;
+            }
+            assert((f > 0.0f) == bits[k]);
+        }
+    }
+    assert(checked > 0);
+    synth_free(&s);
+    printf("[PASS] test_modulation (%u packets)\n", checked);
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running synth.c Unit Tests                \n");
+    printf("===========================================\n");
+    test_parse();
+    test_ble_bits();
+    test_br_bits();
+    test_render();
+    test_modulation();
+    printf("===========================================\n");
+    printf(" All synth tests passed successfully!      \n");
+    printf("===========================================\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Unit and Multithreaded Tests for trace.c / trace.h
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *buf;
+    long len;
+
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    rewind(f);
+    buf = malloc(len + 1);
+    assert(fread(buf, 1, len, f) == (size_t)len);
+    buf[len] = '\0';
+    fclose(f);
+    return buf;
+}
+
+static unsigned count(const char *haystack, const char *needle) {
+    unsigned n = 0;
+    while ((haystack = strstr(haystack, needle)) != NULL) {
+        ++n;
+        ++haystack;
+    }
+    return n;
+}
+
+static void test_span(void) {
+    char path[64], *json;
+
+    snprintf(path, sizeof(path), "/tmp/test_trace_%d.json", (int)getpid());
+
+    TRACE_BEGIN(outer);
+    TRACE_BEGIN(inner);
+    usleep(1000);
+    TRACE_END(inner, "inner");
+    TRACE_END(outer, "outer");
+
+    assert(trace_dump(path) == 0);
+    json = read_file(path);
+    assert(strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", 40) == 0);
+    assert(strstr(json, "\"name\":\"process_name\",\"ph\":\"M\"") != NULL);
+    assert(count(json, "\"name\":\"thread_name\"") == 1);
+    assert(strstr(json, "{\"name\":\"inner\",\"ph\":\"X\"") != NULL);
+    assert(strstr(json, "{\"name\":\"outer\",\"ph\":\"X\"") != NULL);
+    // in order, closed off
+    assert(strstr(json, "\"inner\"") < strstr(json, "\"outer\""));
+    assert(strcmp(json + strlen(json) - 4, "\n]}\n") == 0);
+    free(json);
+
+    unlink(path);
+    trace_free();
+    printf("[PASS] test_span\n");
+}
+
+static void test_unwritable(void) {
+    assert(trace_dump("/nonexistent/trace.json") == -1);
+    printf("[PASS] test_unwritable\n");
+}
+
+#define THREADS 4
+#define SPANS (TRACE_RING_EVENTS + 100)
+
+static void *tracer(void *arg) {
+    char name[16];
+    unsigned i;
+
+    snprintf(name, sizeof(name), "tracer-%u", (unsigned)(uintptr_t)arg);
+    pthread_setname_np(pthread_self(), name);
+    for (i = 0; i < SPANS; ++i) {
+        TRACE_BEGIN(work);
+        TRACE_END(work, "work");
+    }
+    return NULL;
+}
+
+// a ring per thread, each holding its newest TRACE_RING_EVENTS, dumped
+// while the threads are still going
+static void test_threads(void) {
+    pthread_t threads[THREADS];
+    char path[64], *json;
+    unsigned i;
+
+    snprintf(path, sizeof(path), "/tmp/test_trace_%d.json", (int)getpid());
+
+    for (i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, tracer, (void *)(uintptr_t)i);
+    assert(trace_dump(path) == 0);
+    for (i = 0; i < THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    assert(trace_dump(path) == 0);
+    json = read_file(path);
+    assert(count(json, "\"name\":\"thread_name\"") == THREADS);
+    assert(count(json, "\"name\":\"work\"") == THREADS * TRACE_RING_EVENTS);
+    // the threads are gone, so the names are the ones the rings kept
+    assert(strstr(json, "\"args\":{\"name\":\"tracer-0\"}") != NULL);
+    assert(strstr(json, "\"args\":{\"name\":\"tracer-3\"}") != NULL);
+    free(json);
+
+    unlink(path);
+    trace_free();
+    printf("[PASS] test_threads\n");
+}
+
+int main(void) {
+    printf("===========================================\n");
+    printf(" Running trace.c Unit Tests                \n");
+    printf("===========================================\n");
+    test_span();
+    test_unwritable();
+    test_threads();
+    printf("===========================================\n");
+    printf(" All trace tests passed successfully!      \n");
+    printf("===========================================\n");
+    return 0;
+}
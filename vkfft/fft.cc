@@ -401,6 +401,26 @@ void release_buffer(void *fft_in) {
     pthread_mutex_unlock(&f->mutex);
 }
 
+void fft_drain(void) {
+    for (unsigned i = 0; i < NUM_FFT; ++i) {
+        fft_t *f = &fft[i];
+        pthread_mutex_lock(&f->mutex);
+        while (running && (f->buffer_state == fft_t::BUFFER_STATE_EXECUTING ||
+                           f->buffer_state == fft_t::BUFFER_STATE_DONE))
+            pthread_cond_wait(&f->buffer_state_cond, &f->mutex);
+        pthread_mutex_unlock(&f->mutex);
+    }
+}
+
+void fft_shutdown(void) {
+    for (unsigned i = 0; i < NUM_FFT; ++i) {
+        fft_t *f = &fft[i];
+        pthread_mutex_lock(&f->mutex);
+        pthread_cond_broadcast(&f->buffer_state_cond);
+        pthread_mutex_unlock(&f->mutex);
+    }
+}
+
 void deinit_vkfft(void) {
     for (unsigned i = 0; i < NUM_FFT; ++i) {
         deleteVkFFT(&fft[i].app);
@@ -108,6 +108,10 @@ void deinit_vkfft(void);
 void release_buffer(void *buf_in);
 
 void *get_next_buffer(void);
+// wait until fft_done has handed on every submitted batch
+void fft_drain(void);
+// wake anyone waiting on a buffer once running has been cleared
+void fft_shutdown(void);
 
 #ifdef __cplusplus
 }